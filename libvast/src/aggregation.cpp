@@ -0,0 +1,214 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+#include "vast/aggregation.hpp"
+
+#include "vast/bitmap_algorithms.hpp"
+#include "vast/detail/assert.hpp"
+#include "vast/detail/overload.hpp"
+#include "vast/error.hpp"
+#include "vast/table_slice.hpp"
+#include "vast/view.hpp"
+
+#include <caf/variant.hpp>
+
+#include <utility>
+
+namespace vast {
+
+namespace {
+
+// Folds a value into the accumulated result of an aggregate function. A `nil`
+// accumulator stands for an empty set of values.
+void fold(aggregate_function f, data& acc, const data& x) {
+  if (caf::holds_alternative<caf::none_t>(x))
+    return;
+  if (caf::holds_alternative<caf::none_t>(acc)) {
+    acc = x;
+    return;
+  }
+  switch (f) {
+    case aggregate_function::count:
+    case aggregate_function::sum: {
+      auto add = detail::overload(
+        [](auto&, const auto&) {
+          // Values of different types cannot occur in the same column.
+        },
+        [](count& lhs, count rhs) { lhs += rhs; },
+        [](integer& lhs, integer rhs) { lhs += rhs; },
+        [](real& lhs, real rhs) { lhs += rhs; },
+        [](duration& lhs, duration rhs) { lhs += rhs; });
+      caf::visit(add, acc, x);
+      break;
+    }
+    case aggregate_function::min:
+      if (x < acc)
+        acc = x;
+      break;
+    case aggregate_function::max:
+      if (acc < x)
+        acc = x;
+      break;
+  }
+}
+
+bool is_summable(const type& t) {
+  return caf::holds_alternative<integer_type>(t)
+         || caf::holds_alternative<count_type>(t)
+         || caf::holds_alternative<real_type>(t)
+         || caf::holds_alternative<duration_type>(t);
+}
+
+} // namespace
+
+const char* to_string(aggregate_function x) {
+  switch (x) {
+    case aggregate_function::count:
+      return "count";
+    case aggregate_function::sum:
+      return "sum";
+    case aggregate_function::min:
+      return "min";
+    case aggregate_function::max:
+      return "max";
+  }
+  return "<invalid>";
+}
+
+bool operator==(const aggregate& x, const aggregate& y) {
+  return x.function == y.function && x.field == y.field;
+}
+
+std::string to_string(const aggregate& x) {
+  std::string result = to_string(x.function);
+  if (!x.field.empty()) {
+    result += '(';
+    result += x.field;
+    result += ')';
+  }
+  return result;
+}
+
+caf::expected<aggregate> make_aggregate(std::string_view str) {
+  aggregate result;
+  auto name = str;
+  if (auto open = str.find('('); open != std::string_view::npos) {
+    if (str.back() != ')' || open + 2 >= str.size())
+      return make_error(ec::parse_error, "invalid aggregate", std::string{str});
+    name = str.substr(0, open);
+    result.field = std::string{str.substr(open + 1, str.size() - open - 2)};
+  }
+  if (name == "count")
+    result.function = aggregate_function::count;
+  else if (name == "sum")
+    result.function = aggregate_function::sum;
+  else if (name == "min")
+    result.function = aggregate_function::min;
+  else if (name == "max")
+    result.function = aggregate_function::max;
+  else
+    return make_error(ec::parse_error, "unknown aggregate function",
+                      std::string{name});
+  if (result.field.empty() && result.function != aggregate_function::count)
+    return make_error(ec::parse_error, "missing field for aggregate",
+                      std::string{str});
+  return result;
+}
+
+aggregation::aggregation(std::vector<std::string> group_by,
+                         std::vector<aggregate> aggregates)
+  : group_by_{std::move(group_by)}, aggregates_{std::move(aggregates)} {
+  // nop
+}
+
+void aggregation::add(const table_slice& slice) {
+  auto& cols = resolve(slice.layout());
+  for (size_t row = 0; row < slice.rows(); ++row)
+    add_row(slice, cols, row);
+}
+
+void aggregation::add(const table_slice& slice, const ids& selection) {
+  auto& cols = resolve(slice.layout());
+  auto first = slice.offset();
+  auto last = slice.offset() + slice.rows();
+  for (auto id : select(selection)) {
+    if (id < first)
+      continue;
+    if (id >= last)
+      break;
+    add_row(slice, cols, id - first);
+  }
+}
+
+void aggregation::merge(const aggregation& other) {
+  VAST_ASSERT(group_by_ == other.group_by_);
+  VAST_ASSERT(aggregates_ == other.aggregates_);
+  for (auto& [key, values] : other.groups_) {
+    auto [i, inserted] = groups_.emplace(key, values);
+    if (inserted)
+      continue;
+    for (size_t j = 0; j < aggregates_.size(); ++j)
+      fold(aggregates_[j].function, i->second[j], values[j]);
+  }
+}
+
+const aggregation::columns& aggregation::resolve(const record_type& layout) {
+  auto i = columns_.find(layout);
+  if (i != columns_.end())
+    return i->second;
+  auto column_of = [&](const std::string& key) -> caf::optional<size_t> {
+    auto xs = resolve_columns(layout, {key});
+    if (xs.empty())
+      return caf::none;
+    return xs.front();
+  };
+  columns cols;
+  for (auto& key : group_by_)
+    cols.keys.push_back(column_of(key));
+  for (auto& x : aggregates_) {
+    caf::optional<size_t> col;
+    if (!x.field.empty())
+      col = column_of(x.field);
+    // Sums over non-arithmetic fields have no result.
+    if (col && x.function == aggregate_function::sum
+        && !is_summable(layout.fields[*col].type))
+      col = caf::none;
+    cols.values.push_back(col);
+  }
+  return columns_.emplace(layout, std::move(cols)).first->second;
+}
+
+void aggregation::add_row(const table_slice& slice, const columns& cols,
+                          size_t row) {
+  key_type key;
+  key.reserve(cols.keys.size());
+  for (auto& col : cols.keys)
+    key.push_back(col ? materialize(slice.at(row, *col)) : data{});
+  auto i = groups_.find(key);
+  if (i == groups_.end())
+    i = groups_.emplace(std::move(key), value_type(aggregates_.size())).first;
+  for (size_t j = 0; j < aggregates_.size(); ++j) {
+    auto f = aggregates_[j].function;
+    auto& col = cols.values[j];
+    if (f == aggregate_function::count) {
+      // Count rows, or the rows with a value for the given field.
+      if (aggregates_[j].field.empty()
+          || (col && !caf::holds_alternative<caf::none_t>(slice.at(row, *col))))
+        fold(f, i->second[j], count{1});
+    } else if (col) {
+      fold(f, i->second[j], materialize(slice.at(row, *col)));
+    }
+  }
+}
+
+} // namespace vast
@@ -14,9 +14,11 @@
 #include "vast/arrow_table_slice.hpp"
 
 #include "vast/arrow_table_slice_builder.hpp"
+#include "vast/detail/column_predicate.hpp"
 #include "vast/detail/narrow.hpp"
 #include "vast/detail/overload.hpp"
 #include "vast/error.hpp"
+#include "vast/ewah_bitmap.hpp"
 #include "vast/logger.hpp"
 #include "vast/value_index.hpp"
 
@@ -666,6 +668,110 @@ private:
   value_index& idx_;
 };
 
+class column_evaluator {
+public:
+  column_evaluator(relational_operator op, const data_view& rhs,
+                   ewah_bitmap& result)
+    : op_(op), rhs_(rhs), result_(result) {
+    // nop
+  }
+
+  template <class Array, class Getter>
+  void apply(const Array& arr, Getter f) {
+    using value_type = std::decay_t<decltype(f(arr, int64_t{0}))>;
+    auto null_result = evaluate_view(caf::none, op_, rhs_);
+    detail::with_column_predicate<value_type>(op_, rhs_, [&](auto pred) {
+      for (int64_t row = 0; row < arr.length(); ++row)
+        result_.append_bit(arr.IsNull(row) ? null_result
+                                           : pred(f(arr, row)));
+    });
+  }
+
+  void operator()(const arrow::BooleanArray& arr, const bool_type&) {
+    apply(arr, boolean_at);
+  }
+
+  template <class T>
+  void operator()(const arrow::NumericArray<T>& arr, const real_type&) {
+    apply(arr, real_at);
+  }
+
+  template <class T>
+  void operator()(const arrow::NumericArray<T>& arr, const integer_type&) {
+    apply(arr, integer_at);
+  }
+
+  template <class T>
+  void operator()(const arrow::NumericArray<T>& arr, const count_type&) {
+    apply(arr, count_at);
+  }
+
+  template <class T>
+  void operator()(const arrow::NumericArray<T>& arr,
+                  const enumeration_type& t) {
+    // Compare the canonical string form of the enumeration.
+    auto f = [&](const auto& arr, int64_t row) {
+      return to_canonical(t, enumeration_at(arr, row));
+    };
+    apply(arr, f);
+  }
+
+  template <class T>
+  void operator()(const arrow::NumericArray<T>& arr, const duration_type&) {
+    apply(arr, duration_at);
+  }
+
+  void operator()(const arrow::FixedSizeBinaryArray& arr, const address_type&) {
+    apply(arr, address_at);
+  }
+
+  void operator()(const arrow::FixedSizeBinaryArray& arr, const subnet_type&) {
+    apply(arr, subnet_at);
+  }
+
+  void operator()(const arrow::FixedSizeBinaryArray& arr, const port_type&) {
+    apply(arr, port_at);
+  }
+
+  void operator()(const arrow::StringArray& arr, const string_type&) {
+    apply(arr, string_at);
+  }
+
+  void operator()(const arrow::StringArray& arr, const pattern_type&) {
+    apply(arr, pattern_at);
+  }
+
+  void operator()(const arrow::TimestampArray& arr, const time_type&) {
+    apply(arr, timestamp_at);
+  }
+
+  template <class T>
+  void operator()(const arrow::ListArray& arr, const T& t) {
+    if constexpr (std::is_same_v<T, vector_type>) {
+      auto f = [&](const auto& arr, int64_t row) {
+        return data_view{vector_at(t.value_type, arr, row)};
+      };
+      apply(arr, f);
+    } else if constexpr (std::is_same_v<T, set_type>) {
+      auto f = [&](const auto& arr, int64_t row) {
+        return data_view{set_at(t.value_type, arr, row)};
+      };
+      apply(arr, f);
+    } else {
+      static_assert(std::is_same_v<T, map_type>);
+      auto f = [&](const auto& arr, int64_t row) {
+        return data_view{map_at(t.key_type, t.value_type, arr, row)};
+      };
+      apply(arr, f);
+    }
+  }
+
+private:
+  relational_operator op_;
+  const data_view& rhs_;
+  ewah_bitmap& result_;
+};
+
 } // namespace
 
 // -- remaining implementation of arrow_table_slice ----------------------------
@@ -684,4 +790,20 @@ void arrow_table_slice::append_column_to_index(size_type col,
   decode(layout().fields[col].type, *arr, f);
 }
 
+ids arrow_table_slice::evaluate_column(size_type col, relational_operator op,
+                                       const data_view& rhs) const {
+  VAST_ASSERT(col < columns());
+  ewah_bitmap result;
+  result.append_bits(false, offset());
+  if (rows() == 0)
+    return result;
+  column_evaluator f{op, rhs, result};
+  auto arr = batch_->column(detail::narrow_cast<int>(col));
+  decode(layout().fields[col].type, *arr, f);
+  // Fall back to row-wise evaluation if the column didn't decode.
+  if (result.size() != offset() + rows())
+    return super::evaluate_column(col, op, rhs);
+  return result;
+}
+
 } // namespace vast
@@ -547,8 +547,10 @@ table_slice_ptr arrow_table_slice_builder::finish() {
   auto batch = arrow::RecordBatch::Make(schema, rows_, columns);
   table_slice_header hdr{layout(), rows_, 0};
   rows_ = 0;
-  return caf::make_copy_on_write<arrow_table_slice>(std::move(hdr),
-                                                    std::move(batch));
+  auto result = caf::make_copy_on_write<arrow_table_slice>(std::move(hdr),
+                                                           std::move(batch));
+  result.unshared().interned_layout(interned_layout());
+  return result;
 }
 
 size_t arrow_table_slice_builder::rows() const noexcept {
@@ -14,6 +14,7 @@
 #include "vast/chunk.hpp"
 
 #include "vast/detail/narrow.hpp"
+#include "vast/detail/system.hpp"
 #include "vast/error.hpp"
 #include "vast/filesystem.hpp"
 
@@ -21,6 +22,7 @@
 #include <caf/make_counted.hpp>
 #include <caf/serializer.hpp>
 
+#include <cstdint>
 #include <fcntl.h>
 #include <tuple>
 #include <unistd.h>
@@ -97,6 +99,21 @@ chunk_ptr chunk::slice(size_type start, size_type length) const {
   return make(length, data_ + start, deleter);
 }
 
+void chunk::prefetch(size_type start, size_type length) const {
+  VAST_ASSERT(start + length <= size());
+  if (length == 0)
+    length = size() - start;
+  if (length == 0)
+    return;
+  // madvise(2) requires a page-aligned address.
+  auto page_size = static_cast<uintptr_t>(detail::page_size());
+  auto first = reinterpret_cast<uintptr_t>(data_ + start);
+  auto aligned = first & ~(page_size - 1);
+  // Failing to give a hint is not an error, so we ignore the result.
+  ::madvise(reinterpret_cast<void*>(aligned), first - aligned + length,
+            MADV_WILLNEED);
+}
+
 chunk::chunk(void* ptr, size_type size, deleter_type deleter)
   : data_{reinterpret_cast<value_type*>(ptr)},
     size_{size},
@@ -13,13 +13,15 @@
 
 #include "vast/column_index.hpp"
 
+#include "vast/chunk.hpp"
 #include "vast/expression_visitors.hpp"
-#include "vast/load.hpp"
 #include "vast/logger.hpp"
 #include "vast/save.hpp"
 #include "vast/table_slice.hpp"
 #include "vast/value_index_factory.hpp"
 
+#include <caf/binary_deserializer.hpp>
+
 namespace vast {
 
 // -- free functions -----------------------------------------------------------
@@ -59,12 +61,26 @@ caf::error column_index::init() {
   VAST_TRACE("");
   // Materialize the index when encountering persistent state.
   if (exists(filename_)) {
-    if (auto err = load(nullptr, filename_, last_flush_, idx_)) {
+    // Map the file into memory so that the value index can reference its
+    // data in place instead of copying it.
+    auto chk = chunk::mmap(filename_);
+    if (chk == nullptr) {
+      VAST_ERROR(this, "failed to mmap value index from disk");
+      return make_error(ec::filesystem_error, "failed to mmap", filename_);
+    }
+    caf::binary_deserializer source{nullptr, chk->data(), chk->size()};
+    if (auto err = source(last_flush_)) {
       VAST_ERROR(this, "failed to load value index from disk", sys_.render(err));
       return err;
-    } else {
-      VAST_DEBUG(this, "loaded value index with offset", idx_->offset());
     }
+    auto bytes_read = chk->size() - source.remaining();
+    idx_ = factory<value_index>::traits::make(chk->slice(bytes_read));
+    if (idx_ == nullptr) {
+      VAST_ERROR(this, "failed to load value index from disk");
+      return make_error(ec::format_error, "failed to load value index",
+                        filename_);
+    }
+    VAST_DEBUG(this, "loaded value index with offset", idx_->offset());
     return caf::none;
   }
   // Otherwise construct a new one.
@@ -109,6 +125,19 @@ caf::expected<bitmap> column_index::lookup(relational_operator op,
   return result;
 }
 
+caf::expected<value_counts> column_index::distinct(const ids& selection) {
+  VAST_TRACE(VAST_ARG(selection));
+  VAST_ASSERT(idx_ != nullptr);
+  auto xs = idx_->distinct(selection);
+  if (!xs)
+    return xs.error();
+  // Convert the values back from their internal representation.
+  value_counts result;
+  for (auto& [x, n] : *xs)
+    result[materialize(to_canonical(index_type_, make_view(x)))] += n;
+  return result;
+}
+
 bool column_index::dirty() const noexcept {
   VAST_ASSERT(idx_ != nullptr);
   return idx_->offset() != last_flush_;
@@ -0,0 +1,394 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+#include "vast/compiled_expression.hpp"
+
+#include "vast/bitmap_algorithms.hpp"
+#include "vast/detail/assert.hpp"
+#include "vast/die.hpp"
+#include "vast/error.hpp"
+#include "vast/ewah_bitmap.hpp"
+#include "vast/system/atoms.hpp"
+#include "vast/table_slice.hpp"
+#include "vast/value_index.hpp"
+#include "vast/value_index_factory.hpp"
+
+#include <caf/error.hpp>
+#include <caf/none.hpp>
+#include <caf/settings.hpp>
+#include <caf/sum_type.hpp>
+
+#include <algorithm>
+#include <regex>
+
+namespace vast {
+
+namespace {
+
+using instruction = compiled_expression::instruction;
+using opcode = compiled_expression::opcode;
+
+ids make_constant(const table_slice& slice, bool x) {
+  ids result;
+  result.append_bits(false, slice.offset());
+  result.append_bits(x, slice.rows());
+  return result;
+}
+
+// Builds the test of a predicate, choosing a specialized closure where
+// pre-building the RHS saves work on every value. The closures may hold views
+// into the RHS, which the instruction keeps alive.
+void make_test(instruction& x) {
+  auto rhs = x.rhs;
+  auto op = x.op;
+  auto negate = op == not_match || op == not_in;
+  // Compile regular expressions once instead of once per value.
+  if (auto p = caf::get_if<pattern>(rhs.get())) {
+    if (op == match || op == not_match || op == in || op == not_in) {
+      auto re = std::make_shared<const std::regex>(p->string());
+      auto search = op == in || op == not_in;
+      x.test = [=](const data_view& lhs) {
+        auto str = caf::get_if<view<std::string>>(&lhs);
+        auto result = false;
+        if (str)
+          result = search ? std::regex_search(str->begin(), str->end(), *re)
+                          : std::regex_match(str->begin(), str->end(), *re);
+        return result != negate;
+      };
+      x.specialized = true;
+      return;
+    }
+  }
+  // Replace linear scans over a set of basic values with a binary search.
+  if (op == in || op == not_in) {
+    auto is_basic = [](const data& y) {
+      return !caf::holds_alternative<vector>(y)
+             && !caf::holds_alternative<set>(y)
+             && !caf::holds_alternative<map>(y)
+             && !caf::holds_alternative<pattern>(y);
+    };
+    auto sorted = [&](const auto& xs) {
+      auto result = std::make_shared<std::vector<data_view>>();
+      if (!std::all_of(xs.begin(), xs.end(), is_basic))
+        return decltype(result){};
+      result->reserve(xs.size());
+      for (auto& y : xs)
+        result->push_back(make_view(y));
+      std::sort(result->begin(), result->end());
+      return result;
+    };
+    std::shared_ptr<std::vector<data_view>> xs;
+    if (auto v = caf::get_if<vector>(rhs.get()))
+      xs = sorted(*v);
+    else if (auto s = caf::get_if<set>(rhs.get()))
+      xs = sorted(*s);
+    if (xs) {
+      x.test = [=](const data_view& lhs) {
+        return std::binary_search(xs->begin(), xs->end(), lhs) != negate;
+      };
+      x.specialized = true;
+      return;
+    }
+  }
+  x.test = [=, y = make_view(*rhs)](const data_view& lhs) {
+    return evaluate_view(lhs, op, y);
+  };
+}
+
+// Checks whether the value index for a column of type *t* answers a predicate
+// without false positives. Rather than second-guessing the index from the
+// type, we ask an index that the value index factory creates with the same
+// options as the INDEX, so that attributes such as `#index=hash` and options
+// such as adaptive binning make a predicate inexact.
+bool is_exact(const type& t, const caf::settings& index_opts,
+              relational_operator op, const data& d) {
+  auto idx = factory<value_index>::make(t, index_opts);
+  return idx != nullptr && idx->exact(op, make_view(d));
+}
+
+struct compiler {
+  caf::error operator()(caf::none_t) {
+    return constant(false);
+  }
+
+  caf::error operator()(const conjunction& c) {
+    return connective(opcode::conjunction, c);
+  }
+
+  caf::error operator()(const disjunction& d) {
+    return connective(opcode::disjunction, d);
+  }
+
+  caf::error operator()(const negation& n) {
+    auto pos = program.size();
+    // A negation turns false negatives of the index into false positives.
+    program.push_back({opcode::negation});
+    program[pos].arity = 1;
+    if (auto err = caf::visit(*this, n.expr()))
+      return err;
+    program[pos].size = program.size() - pos;
+    return caf::none;
+  }
+
+  caf::error operator()(const predicate& p) {
+    op = p.op;
+    return caf::visit(*this, p.lhs, p.rhs);
+  }
+
+  caf::error operator()(const attribute_extractor& e, const data& d) {
+    if (e.attr == system::type_atom::get_value())
+      return constant(evaluate(layout.name(), op, d));
+    if (e.attr == system::timestamp_atom::get_value()) {
+      auto pred = [](auto& x) {
+        return caf::holds_alternative<time_type>(x.type)
+               && has_attribute(x.type, "timestamp");
+      };
+      auto& fs = layout.fields;
+      auto i = std::find_if(fs.begin(), fs.end(), pred);
+      if (i == fs.end())
+        return constant(false);
+      return column(static_cast<size_t>(std::distance(fs.begin(), i)), d);
+    }
+    return constant(false);
+  }
+
+  caf::error operator()(const type_extractor&, const data&) {
+    return make_error(ec::invalid_query, "unresolved type extractor");
+  }
+
+  caf::error operator()(const key_extractor&, const data&) {
+    return make_error(ec::invalid_query, "unresolved key extractor");
+  }
+
+  caf::error operator()(const data_extractor& e, const data& d) {
+    if (e.type != layout)
+      return constant(false);
+    if (e.offset.size() != 1)
+      return make_error(ec::invalid_query, "data extractor for nested field");
+    return column(e.offset[0], d);
+  }
+
+  template <class T>
+  caf::error operator()(const data& d, const T& x) {
+    return (*this)(x, d);
+  }
+
+  template <class T, class U>
+  caf::error operator()(const T&, const U&) {
+    return constant(false);
+  }
+
+  caf::error constant(bool x) {
+    program.push_back({opcode::constant});
+    program.back().value = x;
+    program.back().exact = x;
+    return caf::none;
+  }
+
+  caf::error column(size_t col, const data& d) {
+    instruction x{opcode::predicate};
+    x.column = col;
+    x.op = op;
+    x.rhs = std::make_shared<const data>(d);
+    x.exact = is_exact(layout.fields[col].type, index_opts, op, d);
+    make_test(x);
+    program.push_back(std::move(x));
+    return caf::none;
+  }
+
+  caf::error connective(opcode code, const std::vector<expression>& xs) {
+    auto pos = program.size();
+    program.push_back({code});
+    program[pos].arity = xs.size();
+    program[pos].exact = true;
+    for (auto& x : xs) {
+      auto child = program.size();
+      if (auto err = caf::visit(*this, x))
+        return err;
+      program[pos].exact &= program[child].exact;
+    }
+    program[pos].size = program.size() - pos;
+    return caf::none;
+  }
+
+  const record_type& layout;
+  const caf::settings& index_opts;
+  std::vector<instruction>& program;
+  relational_operator op = equal;
+};
+
+} // namespace
+
+caf::expected<compiled_expression>
+compiled_expression::make(const expression& expr, const record_type& layout,
+                          const caf::settings& index_opts) {
+  auto tailored = tailor(expr, layout);
+  if (!tailored)
+    return tailored.error();
+  compiled_expression result;
+  result.expr_ = std::move(*tailored);
+  result.layout_ = layout;
+  compiler f{result.layout_, index_opts, result.program_};
+  if (auto err = caf::visit(f, result.expr_))
+    return err;
+  return result;
+}
+
+ids compiled_expression::operator()(const table_slice& slice) const {
+  if (program_.empty())
+    return make_constant(slice, false);
+  VAST_ASSERT(slice.layout() == layout_);
+  return run(slice, 0);
+}
+
+ids compiled_expression::operator()(const table_slice& slice,
+                                    const ids& selection) const {
+  // Evaluating a single row costs roughly as much as evaluating this many
+  // rows of a column, because of the per-row dispatch on the instructions.
+  constexpr size_t row_cost = 16;
+  auto candidates = make_constant(slice, true) & selection;
+  if (program_.size() == 1 && program_[0].code == opcode::constant)
+    return program_[0].value ? candidates : make_constant(slice, false);
+  auto n = rank(candidates);
+  if (n == 0)
+    return candidates;
+  if (n * row_cost >= slice.rows())
+    return (*this)(slice) & candidates;
+  ids result;
+  for (auto id : select(candidates)) {
+    result.append_bits(false, id - result.size());
+    result.append_bit((*this)(slice, id - slice.offset()));
+  }
+  result.append_bits(false, slice.offset() + slice.rows() - result.size());
+  return result;
+}
+
+bool compiled_expression::operator()(const table_slice& slice,
+                                     size_t row) const {
+  VAST_ASSERT(row < slice.rows());
+  if (program_.empty())
+    return false;
+  VAST_ASSERT(slice.layout() == layout_);
+  return run(slice, row, 0);
+}
+
+bool compiled_expression::exact() const {
+  return !program_.empty() && program_[0].exact;
+}
+
+compiled_expression compiled_expression::residual() const {
+  if (program_.empty())
+    return *this;
+  if (!exact() && program_[0].code != opcode::conjunction)
+    return *this;
+  compiled_expression result;
+  result.layout_ = layout_;
+  if (exact()) {
+    result.program_.push_back({opcode::constant});
+    result.program_.back().value = true;
+    result.program_.back().exact = true;
+    return result;
+  }
+  // Keep the inexact operands of the top-level conjunction only. The operands
+  // of the tailored conjunction correspond to the subtrees of the program.
+  auto& operands = caf::get<conjunction>(expr_);
+  VAST_ASSERT(operands.size() == program_[0].arity);
+  conjunction residual;
+  std::vector<instruction> program;
+  program.push_back(program_[0]);
+  for (size_t i = 0, child = 1; i < program_[0].arity;
+       ++i, child += program_[child].size) {
+    if (program_[child].exact)
+      continue;
+    residual.push_back(operands[i]);
+    auto first = program_.begin() + child;
+    program.insert(program.end(), first, first + program_[child].size);
+  }
+  VAST_ASSERT(!residual.empty());
+  if (residual.size() == 1) {
+    result.expr_ = std::move(residual[0]);
+    result.program_.assign(program.begin() + 1, program.end());
+  } else {
+    program[0].arity = residual.size();
+    program[0].size = program.size();
+    result.expr_ = std::move(residual);
+    result.program_ = std::move(program);
+  }
+  return result;
+}
+
+bool compiled_expression::run(const table_slice& slice, size_t row,
+                              size_t pc) const {
+  auto& x = program_[pc];
+  switch (x.code) {
+    case opcode::constant:
+      return x.value;
+    case opcode::predicate: {
+      auto& t = layout_.fields[x.column].type;
+      return x.test(to_canonical(t, slice.at(row, x.column)));
+    }
+    case opcode::negation:
+      return !run(slice, row, pc + 1);
+    case opcode::conjunction:
+      for (size_t i = 0, child = pc + 1; i < x.arity;
+           ++i, child += program_[child].size)
+        if (!run(slice, row, child))
+          return false;
+      return true;
+    case opcode::disjunction:
+      for (size_t i = 0, child = pc + 1; i < x.arity;
+           ++i, child += program_[child].size)
+        if (run(slice, row, child))
+          return true;
+      return false;
+  }
+  die("unhandled opcode");
+}
+
+ids compiled_expression::run(const table_slice& slice, size_t pc) const {
+  auto& x = program_[pc];
+  switch (x.code) {
+    case opcode::constant:
+      return make_constant(slice, x.value);
+    case opcode::predicate: {
+      if (!x.specialized)
+        return slice.evaluate_column(x.column, x.op, make_view(*x.rhs));
+      auto& t = layout_.fields[x.column].type;
+      ewah_bitmap result;
+      result.append_bits(false, slice.offset());
+      for (size_t row = 0; row < slice.rows(); ++row)
+        result.append_bit(x.test(to_canonical(t, slice.at(row, x.column))));
+      return result;
+    }
+    case opcode::negation:
+      return make_constant(slice, true) - run(slice, pc + 1);
+    case opcode::conjunction: {
+      auto result = make_constant(slice, true);
+      for (size_t i = 0, child = pc + 1; i < x.arity && any(result);
+           ++i, child += program_[child].size)
+        result &= run(slice, child);
+      return result;
+    }
+    case opcode::disjunction: {
+      auto result = make_constant(slice, false);
+      for (size_t i = 0, child = pc + 1;
+           i < x.arity && rank(result) < slice.rows();
+           ++i, child += program_[child].size)
+        result |= run(slice, child);
+      return result;
+    }
+  }
+  die("unhandled opcode");
+}
+
+} // namespace vast
@@ -13,37 +13,146 @@
 
 #include "vast/default_table_slice.hpp"
 
+#include <caf/binary_deserializer.hpp>
 #include <caf/deserializer.hpp>
 #include <caf/serializer.hpp>
 
+#include "vast/concept/printable/vast/error.hpp"
 #include "vast/default_table_slice_builder.hpp"
+#include "vast/detail/column_predicate.hpp"
+#include "vast/detail/type_traits.hpp"
+#include "vast/error.hpp"
+#include "vast/ewah_bitmap.hpp"
+#include "vast/logger.hpp"
 #include "vast/value_index.hpp"
 
 namespace vast {
 
+default_table_slice::default_table_slice(const default_table_slice& other)
+  : table_slice{other}, xs_{other.container()}, error_{other.error_} {
+  // nop
+}
+
 default_table_slice* default_table_slice::copy() const {
   return new default_table_slice(*this);
 }
 
 caf::error default_table_slice::serialize(caf::serializer& sink) const {
-  return sink(xs_);
+  return sink(container());
 }
 
 caf::error default_table_slice::deserialize(caf::deserializer& source) {
+  chunk_ = nullptr;
   return source(xs_);
 }
 
+caf::error default_table_slice::load(chunk_ptr chunk) {
+  VAST_ASSERT(chunk != nullptr);
+  // Check only the number of rows up front. Deserializing the rows touches
+  // every page of the chunk, which may reference a segment.
+  caf::binary_deserializer source{nullptr, chunk->data(), chunk->size()};
+  size_t n = 0;
+  if (auto err = source.begin_sequence(n))
+    return err;
+  if (n != rows())
+    return make_error(ec::format_error, "got a wrong number of rows:", n,
+                      "instead of", rows());
+  xs_.clear();
+  chunk_ = std::move(chunk);
+  return caf::none;
+}
+
+caf::error default_table_slice::decode() const {
+  container();
+  return error_;
+}
+
+const vector& default_table_slice::container() const {
+  std::call_once(decoded_, [this] { decode_rows(); });
+  return xs_;
+}
+
+void default_table_slice::decode_rows() const {
+  if (chunk_ == nullptr)
+    return;
+  caf::binary_deserializer source{nullptr, chunk_->data(), chunk_->size()};
+  vector xs;
+  error_ = source(xs);
+  // Reject rows that do not fit the layout, because the accessors assume that
+  // every row holds one value per column.
+  if (!error_ && xs.size() != rows())
+    error_ = make_error(ec::format_error, "got a wrong number of rows:",
+                        xs.size(), "instead of", rows());
+  for (size_t row = 0; !error_ && row < xs.size(); ++row) {
+    auto values = caf::get_if<vector>(&xs[row]);
+    if (values == nullptr || values->size() != columns())
+      error_ = make_error(ec::format_error, "got a row of wrong size");
+  }
+  if (error_) {
+    VAST_ERROR(this, "failed to deserialize rows from chunk:", error_);
+    // Fall back to nil values to keep the slice dimensions intact.
+    xs_.assign(rows(), vector(columns()));
+  } else {
+    xs_ = std::move(xs);
+  }
+  chunk_ = nullptr;
+}
+
 void default_table_slice::append_column_to_index(size_type col,
                                                  value_index& idx) const {
+  auto& xs = container();
   for (size_type row = 0; row < rows(); ++row)
-    idx.append(make_view(caf::get<vector>(xs_[row])[col]), offset() + row);
+    idx.append(make_view(caf::get<vector>(xs[row])[col]), offset() + row);
+}
+
+ids default_table_slice::evaluate_column(size_type col, relational_operator op,
+                                         const data_view& rhs) const {
+  VAST_ASSERT(col < columns());
+  auto& t = layout().fields[col].type;
+  ewah_bitmap result;
+  result.append_bits(false, offset());
+  auto& xs = container();
+  auto cell = [&](size_type row) -> const data& {
+    return caf::get<vector>(xs[row])[col];
+  };
+  // Enumerations require a conversion to their canonical string form.
+  if (caf::holds_alternative<enumeration_type>(t)) {
+    for (size_type row = 0; row < rows(); ++row)
+      result.append_bit(
+        evaluate_view(to_canonical(t, make_view(cell(row))), op, rhs));
+    return result;
+  }
+  // Dispatch on the type of the RHS once, such that all cells of the same
+  // type take the typed fast path, and all others the generic one.
+  auto f = [&](const auto& y) {
+    using view_type = std::decay_t<decltype(y)>;
+    using data_type = std::conditional_t<
+      std::is_same_v<view_type, std::string_view>, std::string, view_type>;
+    detail::with_column_predicate<view_type>(op, rhs, [&](auto pred) {
+      for (size_type row = 0; row < rows(); ++row) {
+        auto& x = cell(row);
+        if constexpr (detail::is_any_v<view_type, bool, integer, count, real,
+                                       duration, time, std::string_view,
+                                       address, subnet, port>) {
+          if (auto ptr = caf::get_if<data_type>(&x)) {
+            result.append_bit(pred(make_view(*ptr)));
+            continue;
+          }
+        }
+        result.append_bit(evaluate_view(make_view(x), op, rhs));
+      }
+    });
+  };
+  caf::visit(f, rhs);
+  return result;
 }
 
 data_view default_table_slice::at(size_type row, size_type col) const {
   VAST_ASSERT(row < rows());
-  VAST_ASSERT(row < xs_.size());
   VAST_ASSERT(col < columns());
-  auto& x = caf::get<vector>(xs_[row]);
+  auto& xs = container();
+  VAST_ASSERT(row < xs.size());
+  auto& x = caf::get<vector>(xs[row]);
   VAST_ASSERT(col < x.size());
   return make_view(x[col]);
 }
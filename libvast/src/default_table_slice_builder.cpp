@@ -81,6 +81,7 @@ void default_table_slice_builder::lazy_init() {
     table_slice_header header;
     header.layout = layout();
     slice_.reset(new default_table_slice{std::move(header)});
+    slice_->interned_layout(interned_layout());
     row_ = vector(slice_->columns());
     col_ = 0;
   }
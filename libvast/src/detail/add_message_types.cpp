@@ -13,6 +13,7 @@
 
 #include "vast/detail/add_message_types.hpp"
 
+#include "vast/aggregation.hpp"
 #include "vast/bitmap.hpp"
 #include "vast/command.hpp"
 #include "vast/config.hpp"
@@ -37,6 +38,7 @@
 namespace vast::detail {
 
 void add_message_types(caf::actor_system_config& cfg) {
+  cfg.add_message_type<aggregation>("vast::aggregation");
   cfg.add_message_type<bitmap>("vast::bitmap");
   cfg.add_message_type<command::invocation>("vast::command::invocation");
   cfg.add_message_type<data>("vast::data");
@@ -59,6 +61,7 @@ void add_message_types(caf::actor_system_config& cfg) {
   cfg.add_message_type<expression>("vast::expression");
   // Containers
   cfg.add_message_type<std::vector<event>>("std::vector<vast::event>");
+  cfg.add_message_type<value_counts>("vast::value_counts");
   // Actor-specific messages
   cfg.add_message_type<system::component_map>("vast::system::component_map");
   cfg.add_message_type<system::component_map_entry>(
@@ -0,0 +1,61 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+#include "vast/detail/frequency_sketch.hpp"
+
+#include "vast/detail/assert.hpp"
+
+#include <algorithm>
+
+namespace vast::detail {
+
+frequency_sketch::frequency_sketch(size_t width) : width_{1} {
+  VAST_ASSERT(width > 0);
+  while (width_ < width)
+    width_ <<= 1;
+  counters_.resize(depth * width_);
+}
+
+void frequency_sketch::add(size_t digest) {
+  for (size_t row = 0; row < depth; ++row) {
+    auto& counter = counters_[index(digest, row)];
+    if (counter < max_count)
+      ++counter;
+  }
+  if (++samples_ == 10 * width_)
+    age();
+}
+
+uint8_t frequency_sketch::estimate(size_t digest) const {
+  auto result = max_count;
+  for (size_t row = 0; row < depth; ++row)
+    result = std::min(result, counters_[index(digest, row)]);
+  return result;
+}
+
+size_t frequency_sketch::index(size_t digest, size_t row) const {
+  // Derive the hash functions via double hashing from the digest and a
+  // rotation of it.
+  constexpr size_t bits = sizeof(size_t) * 8;
+  auto h1 = digest;
+  auto h2 = ((digest >> 17) | (digest << (bits - 17))) | 1;
+  return row * width_ + ((h1 + row * h2) & (width_ - 1));
+}
+
+void frequency_sketch::age() {
+  for (auto& counter : counters_)
+    counter >>= 1;
+  samples_ /= 2;
+}
+
+} // namespace vast::detail
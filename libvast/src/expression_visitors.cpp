@@ -13,6 +13,7 @@
 
 #include "vast/expression_visitors.hpp"
 
+#include "vast/bitmap_algorithms.hpp"
 #include "vast/concept/parseable/to.hpp"
 #include "vast/concept/parseable/vast/data.hpp"
 #include "vast/concept/parseable/vast/type.hpp"
@@ -629,11 +630,107 @@ bool evaluate_at(const table_slice& slice, size_t row, const expression& expr) {
   return caf::visit(table_slice_row_evaluator{slice, row}, expr);
 }
 
+table_slice_evaluator::table_slice_evaluator(const table_slice& slice)
+  : slice_(slice) {
+  // nop
+}
+
+ids table_slice_evaluator::operator()(caf::none_t) {
+  return constant(false);
+}
+
+ids table_slice_evaluator::operator()(const conjunction& c) {
+  auto result = constant(true);
+  for (auto& op : c) {
+    result &= caf::visit(*this, op);
+    if (!any(result))
+      break;
+  }
+  return result;
+}
+
+ids table_slice_evaluator::operator()(const disjunction& d) {
+  auto result = constant(false);
+  for (auto& op : d) {
+    result |= caf::visit(*this, op);
+    if (rank(result) == slice_.rows())
+      break;
+  }
+  return result;
+}
+
+ids table_slice_evaluator::operator()(const negation& n) {
+  return constant(true) - caf::visit(*this, n.expr());
+}
+
+ids table_slice_evaluator::operator()(const predicate& p) {
+  op_ = p.op;
+  return caf::visit(*this, p.lhs, p.rhs);
+}
+
+ids table_slice_evaluator::operator()(const attribute_extractor& e,
+                                      const data& d) {
+  if (e.attr == system::type_atom::get_value())
+    return constant(evaluate(slice_.layout().name(), op_, d));
+  if (e.attr == system::timestamp_atom::get_value()) {
+    auto pred = [](auto& x) {
+      return caf::holds_alternative<time_type>(x.type)
+             && has_attribute(x.type, "timestamp");
+    };
+    auto& fs = slice_.layout().fields;
+    auto i = std::find_if(fs.begin(), fs.end(), pred);
+    if (i == fs.end())
+      return constant(false);
+    auto pos = static_cast<size_t>(std::distance(fs.begin(), i));
+    return slice_.evaluate_column(pos, op_, make_view(d));
+  }
+  return constant(false);
+}
+
+ids table_slice_evaluator::operator()(const type_extractor&, const data&) {
+  die("type extractor should have been resolved at this point");
+}
+
+ids table_slice_evaluator::operator()(const key_extractor&, const data&) {
+  die("key extractor should have been resolved at this point");
+}
+
+ids table_slice_evaluator::operator()(const data_extractor& e,
+                                      const data& d) {
+  if (e.type != slice_.layout())
+    return constant(false);
+  VAST_ASSERT(e.offset.size() == 1);
+  return slice_.evaluate_column(e.offset[0], op_, make_data_view(d));
+}
+
+ids table_slice_evaluator::constant(bool x) const {
+  ids result;
+  result.append_bits(false, slice_.offset());
+  result.append_bits(x, slice_.rows());
+  return result;
+}
+
 ids evaluate(const table_slice& slice, const expression& expr) {
+  return caf::visit(table_slice_evaluator{slice}, expr);
+}
+
+ids evaluate(const table_slice& slice, const expression& expr,
+             const ids& selection) {
+  // Evaluating a single row costs roughly as much as evaluating this many
+  // rows of a column, because each row walks the entire expression tree.
+  constexpr size_t row_cost = 16;
+  auto candidates = table_slice_evaluator{slice}.constant(true) & selection;
+  auto n = rank(candidates);
+  if (n == 0)
+    return candidates;
+  if (n * row_cost >= slice.rows())
+    return evaluate(slice, expr) & candidates;
   ids result;
-  result.append(false, slice.offset());
-  for (size_t row = 0; row != slice.rows(); ++row)
-    result.append_bit(evaluate_at(slice, row, expr));
+  for (auto id : select(candidates)) {
+    result.append_bits(false, id - result.size());
+    result.append_bit(evaluate_at(slice, id - slice.offset(), expr));
+  }
+  result.append_bits(false, slice.offset() + slice.rows() - result.size());
   return result;
 }
 
@@ -23,21 +23,23 @@
 #include "vast/system/atoms.hpp"
 #include "vast/table_slice.hpp"
 #include "vast/time.hpp"
+#include "vast/time_synopsis.hpp"
 
 namespace vast {
 
 void meta_index::add(const uuid& partition, const table_slice& slice) {
   auto& part_synopsis = partition_synopses_[partition];
-  auto& layout = slice.layout();
-  if (blacklisted_layouts_.count(layout) == 1)
+  auto& key = slice.interned_layout();
+  if (blacklisted_layouts_.count(key) == 1)
     return;
-  auto i = part_synopsis.find(layout);
+  auto& layout = slice.layout();
+  auto i = part_synopsis.find(key);
   table_synopsis* table_syn;
   if (i != part_synopsis.end()) {
     table_syn = &i->second;
   } else {
     // Create new synopses for a layout we haven't seen before.
-    i = part_synopsis.emplace(layout, table_synopsis{}).first;
+    i = part_synopsis.emplace(key, table_synopsis{}).first;
     table_syn = &i->second;
     for (auto& field : layout.fields) {
       auto syn = has_skip_attribute(field.type)
@@ -51,7 +53,7 @@ void meta_index::add(const uuid& partition, const table_slice& slice) {
     auto is_nullptr = [](auto& x) { return x == nullptr; };
     if (std::all_of(table_syn->begin(), table_syn->end(), is_nullptr)) {
       VAST_DEBUG(this, "could not create a synopsis for layout:", layout);
-      blacklisted_layouts_.insert(layout);
+      blacklisted_layouts_.insert(key);
     }
   }
   VAST_ASSERT(table_syn->size() == slice.columns());
@@ -64,6 +66,10 @@ void meta_index::add(const uuid& partition, const table_slice& slice) {
       }
 }
 
+void meta_index::erase(const uuid& partition) {
+  partition_synopses_.erase(partition);
+}
+
 std::vector<uuid> meta_index::lookup(const expression& expr) const {
   VAST_ASSERT(!caf::holds_alternative<caf::none_t>(expr));
   // TODO: we could consider a flat_set<uuid> here, which would then have
@@ -123,9 +129,10 @@ std::vector<uuid> meta_index::lookup(const expression& expr) const {
         // We factor the nested loop into a lambda so that we can abort
         // the iteration more easily with a return statement.
         auto lookup = [&](auto& part_id, auto& part_syn) {
-          for (auto& [layout, table_syn] : part_syn)
+          for (auto& [layout, table_syn] : part_syn) {
+            auto& fields = caf::get<record_type>(layout).fields;
             for (size_t i = 0; i < table_syn.size(); ++i)
-              if (table_syn[i] && match(layout.fields[i])) {
+              if (table_syn[i] && match(fields[i])) {
                 found_matching_synopsis = true;
                 auto opt = table_syn[i]->lookup(x.op, make_view(rhs));
                 if (!opt || *opt) {
@@ -133,6 +140,7 @@ std::vector<uuid> meta_index::lookup(const expression& expr) const {
                   return;
                 }
               }
+          }
         };
         for (auto& [part_id, part_syn] : partition_synopses_)
           lookup(part_id, part_syn);
@@ -183,18 +191,87 @@ std::vector<uuid> meta_index::lookup(const expression& expr) const {
   return caf::visit(f, expr);
 }
 
+caf::optional<time> meta_index::upper_bound(const uuid& partition,
+                                            std::string_view key) const {
+  auto i = partition_synopses_.find(partition);
+  if (i == partition_synopses_.end())
+    return caf::none;
+  caf::optional<time> result;
+  for (auto& [layout, table_syn] : i->second)
+    for (size_t j = 0; j < table_syn.size(); ++j)
+      if (detail::ends_with(caf::get<record_type>(layout).fields[j].name,
+                            key))
+        if (auto syn = dynamic_cast<const time_synopsis*>(table_syn[j].get()))
+          if (!result || syn->max() > *result)
+            result = syn->max();
+  return result;
+}
+
+caf::optional<time> meta_index::upper_bound(const uuid& partition) const {
+  auto i = partition_synopses_.find(partition);
+  if (i == partition_synopses_.end())
+    return caf::none;
+  caf::optional<time> result;
+  for (auto& [layout, table_syn] : i->second) {
+    auto& fields = caf::get<record_type>(layout).fields;
+    caf::optional<time> layout_max;
+    for (size_t j = 0; j < table_syn.size(); ++j)
+      if (has_attribute(fields[j].type, "timestamp"))
+        if (auto syn = dynamic_cast<const time_synopsis*>(table_syn[j].get()))
+          if (!layout_max || syn->max() > *layout_max)
+            layout_max = syn->max();
+    // Without a timestamp we cannot bound the events of this layout.
+    if (!layout_max)
+      return caf::none;
+    if (!result || *layout_max > *result)
+      result = layout_max;
+  }
+  return result;
+}
+
 caf::settings& meta_index::factory_options() {
   return synopsis_options_;
 }
 
+namespace {
+
+// The serialized meta index keys its synopses by plain record types.
+using serialized_partition_synopsis
+  = std::unordered_map<record_type, std::vector<synopsis_ptr>>;
+
+using serialized_partition_synopses
+  = std::unordered_map<uuid, serialized_partition_synopsis>;
+
+} // namespace
+
 caf::error inspect(caf::serializer& sink, const meta_index& x) {
-  return sink(x.synopsis_options_, x.partition_synopses_,
-              x.blacklisted_layouts_);
+  serialized_partition_synopses synopses;
+  for (auto& [part_id, part_syn] : x.partition_synopses_) {
+    auto& y = synopses[part_id];
+    for (auto& [layout, table_syn] : part_syn)
+      y.emplace(caf::get<record_type>(layout), table_syn);
+  }
+  std::unordered_set<record_type> blacklisted_layouts;
+  for (auto& layout : x.blacklisted_layouts_)
+    blacklisted_layouts.insert(caf::get<record_type>(layout));
+  return sink(x.synopsis_options_, synopses, blacklisted_layouts);
 }
 
 caf::error inspect(caf::deserializer& source, meta_index& x) {
-  return source(x.synopsis_options_, x.partition_synopses_,
-                x.blacklisted_layouts_);
+  serialized_partition_synopses synopses;
+  std::unordered_set<record_type> blacklisted_layouts;
+  if (auto err = source(x.synopsis_options_, synopses, blacklisted_layouts))
+    return err;
+  x.partition_synopses_.clear();
+  for (auto& [part_id, part_syn] : synopses) {
+    auto& y = x.partition_synopses_[part_id];
+    for (auto& [layout, table_syn] : part_syn)
+      y.emplace(intern(layout), std::move(table_syn));
+  }
+  x.blacklisted_layouts_.clear();
+  for (auto& layout : blacklisted_layouts)
+    x.blacklisted_layouts_.insert(intern(layout));
+  return caf::none;
 }
 
 // Perform a deep equality comparison for meta indices. This is slow and we only
@@ -232,7 +309,7 @@ bool deep_equals(const meta_index& lhs, const meta_index& rhs) {
              && std::equal(lhs_ts_sorted.begin(), lhs_ts_sorted.end(),
                            rhs_ts_sorted.begin(), rhs_ts_sorted.end(),
                            [&](const auto& lhs, const auto& rhs) {
-                             // first is record_type, second is table_synopsis
+                             // first is the layout, second is table_synopsis
                              return lhs.first == rhs.first
                                     && std::equal(lhs.second.begin(),
                                                   lhs.second.end(),
@@ -17,25 +17,175 @@
 
 #include "vast/bitmap.hpp"
 #include "vast/bitmap_algorithms.hpp"
+#include "vast/compression.hpp"
 #include "vast/detail/assert.hpp"
 #include "vast/detail/byte_swap.hpp"
 #include "vast/detail/narrow.hpp"
+#include "vast/error.hpp"
+#include "vast/expression.hpp"
 #include "vast/ids.hpp"
 #include "vast/logger.hpp"
 #include "vast/si_literals.hpp"
 #include "vast/table_slice.hpp"
+#include "vast/table_slice_builder.hpp"
+#include "vast/table_slice_builder_factory.hpp"
+#include "vast/table_slice_factory.hpp"
+#include "vast/table_slice_header.hpp"
+#include "vast/view.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <numeric>
 
 namespace vast {
 
 using namespace binary_byte_literals;
 
+namespace {
+
+// The per-slice meta data of version 1 segments, which predate compression.
+struct legacy_table_slice_synopsis {
+  int64_t start;
+  int64_t end;
+  id offset;
+  uint64_t size;
+};
+
+template <class Inspector>
+auto inspect(Inspector& f, legacy_table_slice_synopsis& x) {
+  return f(x.start, x.end, x.offset, x.size);
+}
+
+// The per-slice meta data of version 2 segments, which predate columnar table
+// slices.
+struct v2_table_slice_synopsis {
+  int64_t start;
+  int64_t end;
+  id offset;
+  uint64_t size;
+  compression method;
+  uint64_t bytes;
+};
+
+template <class Inspector>
+auto inspect(Inspector& f, v2_table_slice_synopsis& x) {
+  return f(x.start, x.end, x.offset, x.size, x.method, x.bytes);
+}
+
+// Reads the segment meta data in the format of the given segment version.
+caf::error read_meta_data(caf::deserializer& source,
+                          segment_version_type version,
+                          segment::meta_data& x) {
+  if (version >= 3)
+    return source(x);
+  x = {};
+  if (version == 2) {
+    std::vector<v2_table_slice_synopsis> slices;
+    if (auto error = source(slices))
+      return error;
+    x.slices.reserve(slices.size());
+    for (auto& slice : slices)
+      x.slices.push_back({slice.start, slice.end, slice.offset, slice.size,
+                          slice.method, slice.bytes});
+    return caf::none;
+  }
+  std::vector<legacy_table_slice_synopsis> slices;
+  if (auto error = source(slices))
+    return error;
+  x.slices.reserve(slices.size());
+  for (auto& slice : slices) {
+    auto bytes = detail::narrow_cast<uint64_t>(slice.end - slice.start);
+    x.slices.push_back({slice.start, slice.end, slice.offset, slice.size,
+                        compression::null, bytes});
+  }
+  return caf::none;
+}
+
+// Checks whether a value in [min, max] may satisfy `x op rhs`.
+bool may_satisfy(const data& min, const data& max, relational_operator op,
+                 const data& rhs) {
+  // Without statistics or with values of another type we cannot tell.
+  if (caf::holds_alternative<caf::none_t>(min)
+      || min.get_data().index() != rhs.get_data().index())
+    return true;
+  switch (op) {
+    default:
+      return true;
+    case equal:
+      return !(rhs < min) && !(max < rhs);
+    case less:
+      return min < rhs;
+    case less_equal:
+      return !(rhs < min);
+    case greater:
+      return rhs < max;
+    case greater_equal:
+      return !(max < rhs);
+  }
+}
+
+// Checks whether the statistics of a columnar table slice allow a row to
+// match an expression. This check is conservative: it only returns `false` if
+// no row can possibly match.
+struct stats_checker {
+  bool operator()(caf::none_t) const {
+    return true;
+  }
+
+  bool operator()(const conjunction& xs) const {
+    return std::all_of(xs.begin(), xs.end(),
+                       [&](auto& x) { return caf::visit(*this, x); });
+  }
+
+  bool operator()(const disjunction& xs) const {
+    return std::any_of(xs.begin(), xs.end(),
+                       [&](auto& x) { return caf::visit(*this, x); });
+  }
+
+  bool operator()(const negation&) const {
+    return true;
+  }
+
+  bool operator()(const predicate& x) const {
+    auto rhs = caf::get_if<data>(&x.rhs);
+    if (rhs == nullptr)
+      return true;
+    std::vector<size_t> columns;
+    if (auto ex = caf::get_if<key_extractor>(&x.lhs)) {
+      columns = resolve_columns(layout, {ex->key});
+    } else if (auto ex = caf::get_if<attribute_extractor>(&x.lhs)) {
+      if (ex->attr != caf::atom("timestamp"))
+        return true;
+      for (size_t i = 0; i < layout.fields.size(); ++i)
+        if (has_attribute(layout.fields[i].type, "timestamp"))
+          columns.push_back(i);
+    } else if (auto ex = caf::get_if<data_extractor>(&x.lhs)) {
+      if (ex->type != layout)
+        return true;
+      if (auto i = layout.flat_index_at(ex->offset))
+        columns.push_back(*i);
+    }
+    if (columns.empty())
+      return true;
+    return std::any_of(columns.begin(), columns.end(), [&](size_t i) {
+      auto& col = slice.columns[i];
+      return may_satisfy(col.min, col.max, x.op, *rhs);
+    });
+  }
+
+  const record_type& layout;
+  const segment::table_slice_synopsis& slice;
+};
+
+} // namespace
+
 segment_ptr segment::make(chunk_ptr chunk) {
   VAST_ASSERT(chunk != nullptr);
   // Setup a CAF deserializer
   caf::binary_deserializer source{nullptr, chunk->data(), chunk->size()};
   auto result = segment_ptr{new segment, false};
-  if (auto error = source(result->header_, result->meta_)) {
-    VAST_ERROR_ANON(__func__, "failed to deserialize segment meta data");
+  if (auto error = source(result->header_)) {
+    VAST_ERROR_ANON(__func__, "failed to deserialize segment header");
     return nullptr;
   }
   if (result->header_.magic != magic) {
@@ -48,6 +198,11 @@ segment_ptr segment::make(chunk_ptr chunk) {
                     result->header_.version, "instead of", version);
     return nullptr;
   }
+  if (auto error = read_meta_data(source, result->header_.version,
+                                  result->meta_)) {
+    VAST_ERROR_ANON(__func__, "failed to deserialize segment meta data");
+    return nullptr;
+  }
   // Skip meta data. Since the buffer following the chunk meta data was
   // previously serialized as chunk pointer (uint32_t size + data), we have
   // to add add sizeof(uint32_t) bytes to directly jump to the table slice
@@ -56,6 +211,7 @@ segment_ptr segment::make(chunk_ptr chunk) {
   auto bytes_read = chunk->size() - source.remaining();
   VAST_ASSERT(bytes_read < chunk->size());
   result->chunk_ = chunk->slice(bytes_read + sizeof(uint32_t));
+  result->intern_layouts();
   return result;
 }
 
@@ -73,35 +229,194 @@ size_t segment::num_slices() const {
 
 caf::expected<std::vector<table_slice_ptr>>
 segment::lookup(const ids& xs) const {
+  return lookup(xs, expression{}, {});
+}
+
+caf::expected<std::vector<table_slice_ptr>>
+segment::lookup(const ids& xs, const expression& expr,
+                const std::vector<std::string>& keys) const {
   std::vector<table_slice_ptr> result;
+  for (auto slice : locate(xs, expr)) {
+    auto x = extract(slice, keys, tombstones_);
+    if (!x)
+      return x.error();
+    std::move(x->begin(), x->end(), std::back_inserter(result));
+  }
+  return result;
+}
+
+std::vector<size_t> segment::locate(const ids& xs,
+                                    const expression& expr) const {
+  std::vector<size_t> result;
   auto f = [](auto& slice) {
     return std::pair{slice.offset, slice.offset + slice.size};
   };
   auto g = [&](auto& slice) -> caf::error {
-    auto x = make_slice(slice);
-    if (!x)
-      return x.error();
-    result.push_back(*x);
+    if (slice.columns.empty()
+        || caf::visit(stats_checker{meta_.layouts[slice.layout], slice}, expr))
+      result.push_back(static_cast<size_t>(&slice - meta_.slices.data()));
     return caf::none;
   };
-  auto begin = meta_.slices.begin();
-  auto end = meta_.slices.end();
-  if (auto error = select_with(xs, begin, end, f, g))
-    return error;
+  select_with(xs, meta_.slices.begin(), meta_.slices.end(), f, g);
   return result;
 }
 
+caf::expected<std::vector<table_slice_ptr>>
+segment::extract(size_t slice, const std::vector<std::string>& keys,
+                 const ids& tombstones) const {
+  VAST_ASSERT(slice < meta_.slices.size());
+  auto& synopsis = meta_.slices[slice];
+  auto x = make_slice(synopsis, keys);
+  if (!x)
+    return x.error();
+  std::vector<table_slice_ptr> result;
+  if (*x == nullptr)
+    return result;
+  // Select only rows that have not been erased.
+  ids rows;
+  rows.append_bits(false, synopsis.offset);
+  rows.append_bits(true, synopsis.size);
+  if (any(rows & tombstones))
+    select(result, *x, rows - tombstones);
+  else
+    result.push_back(std::move(*x));
+  return result;
+}
+
+void segment::erase(const ids& xs) {
+  tombstones_ |= xs & flat_slice_ids(meta_);
+}
+
+void segment::prefetch(const ids& xs) const {
+  auto f = [](auto& slice) {
+    return std::pair{slice.offset, slice.offset + slice.size};
+  };
+  auto g = [&](auto& slice) -> caf::error {
+    chunk_->prefetch(detail::narrow_cast<size_t>(slice.start),
+                     detail::narrow_cast<size_t>(slice.end - slice.start));
+    return caf::none;
+  };
+  select_with(xs, meta_.slices.begin(), meta_.slices.end(), f, g);
+}
+
+caf::expected<chunk_ptr> segment::read(int64_t start, int64_t end,
+                                       compression method,
+                                       uint64_t bytes) const {
+  auto result = chunk_->slice(detail::narrow_cast<size_t>(start),
+                              detail::narrow_cast<size_t>(end - start));
+  switch (method) {
+    case compression::null:
+      // The result references the segment chunk directly.
+      return result;
+    case compression::lz4: {
+      std::vector<char> buffer(bytes);
+      auto n = lz4::uncompress(result->data(), result->size(), buffer.data(),
+                               buffer.size());
+      if (n != buffer.size())
+        return make_error(ec::format_error, "failed to decompress chunk");
+      return chunk::make(std::move(buffer));
+    }
+    default:
+      return make_error(ec::format_error, "unknown chunk compression");
+  }
+}
+
 caf::expected<table_slice_ptr>
 segment::make_slice(const table_slice_synopsis& slice) const {
-  auto slice_size = detail::narrow_cast<size_t>(slice.end - slice.start);
-  caf::binary_deserializer source{nullptr, chunk_->data() + slice.start,
-                                  slice_size};
-  table_slice_ptr result;
-  if (auto error = source(result))
+  auto bytes = read(slice.start, slice.end, slice.method, slice.bytes);
+  if (!bytes)
+    return bytes.error();
+  // Prior to version 4, every table slice carried its own header.
+  if (header_.version < 4) {
+    auto result = factory<table_slice>::traits::make(std::move(*bytes));
+    if (result == nullptr)
+      return make_error(ec::format_error, "failed to load table slice");
+    return result;
+  }
+  if (slice.layout >= meta_.layouts.size())
+    return make_error(ec::format_error, "got an invalid layout index");
+  table_slice_header header{meta_.layouts[slice.layout], slice.size,
+                            slice.offset};
+  auto result = factory<table_slice>::make(slice.implementation,
+                                           std::move(header));
+  if (result == nullptr)
+    return make_error(ec::format_error, "failed to make table slice",
+                      slice.implementation);
+  auto& mutable_slice = result.unshared();
+  mutable_slice.interned_layout(interned_layouts_[slice.layout]);
+  if (auto error = mutable_slice.load(std::move(*bytes)))
     return error;
   return result;
 }
 
+caf::expected<table_slice_ptr>
+segment::make_slice(const table_slice_synopsis& slice,
+                    const std::vector<std::string>& keys) const {
+  if (slice.columns.empty()) {
+    // With the layout in the dictionary, we can skip table slices without a
+    // matching column before touching their bytes.
+    if (!keys.empty() && header_.version >= 4
+        && slice.layout < meta_.layouts.size()
+        && resolve_columns(meta_.layouts[slice.layout], keys).empty())
+      return table_slice_ptr{nullptr};
+    auto result = make_slice(slice);
+    if (!result || keys.empty())
+      return result;
+    return project(*result, resolve_columns((*result)->layout(), keys));
+  }
+  // Read only the requested columns of a columnar table slice.
+  auto& layout = meta_.layouts[slice.layout];
+  std::vector<size_t> columns;
+  if (keys.empty()) {
+    columns.resize(layout.fields.size());
+    std::iota(columns.begin(), columns.end(), size_t{0});
+  } else {
+    columns = resolve_columns(layout, keys);
+    if (columns.empty())
+      return table_slice_ptr{nullptr};
+  }
+  std::vector<std::vector<data>> values(columns.size());
+  std::vector<record_field> fields;
+  fields.reserve(columns.size());
+  for (size_t i = 0; i < columns.size(); ++i) {
+    auto& col = slice.columns[columns[i]];
+    auto bytes = read(col.start, col.end, col.method, col.bytes);
+    if (!bytes)
+      return bytes.error();
+    caf::binary_deserializer source{nullptr, (*bytes)->data(),
+                                    (*bytes)->size()};
+    if (auto error = source(values[i]))
+      return error;
+    if (values[i].size() != slice.size)
+      return make_error(ec::format_error, "got a column of wrong size");
+    fields.push_back(layout.fields[columns[i]]);
+  }
+  auto projected = record_type{std::move(fields)};
+  projected.name(layout.name());
+  auto builder = factory<table_slice_builder>::make(slice.implementation,
+                                                    std::move(projected));
+  if (builder == nullptr)
+    return make_error(ec::format_error, "failed to get a table slice builder",
+                      slice.implementation);
+  builder->reserve(slice.size);
+  for (size_t row = 0; row < slice.size; ++row)
+    for (auto& column : values)
+      if (!builder->add(make_view(column[row])))
+        return make_error(ec::format_error, "failed to rebuild table slice");
+  auto result = builder->finish();
+  if (result == nullptr)
+    return make_error(ec::format_error, "failed to rebuild table slice");
+  result.unshared().offset(slice.offset);
+  return result;
+}
+
+void segment::intern_layouts() {
+  interned_layouts_.clear();
+  interned_layouts_.reserve(meta_.layouts.size());
+  for (auto& layout : meta_.layouts)
+    interned_layouts_.push_back(intern(type{layout}));
+}
+
 caf::error inspect(caf::serializer& sink, const segment_ptr& x) {
   VAST_ASSERT(x != nullptr);
   return sink(x->header_, x->meta_, x->chunk_);
@@ -109,7 +424,12 @@ caf::error inspect(caf::serializer& sink, const segment_ptr& x) {
 
 caf::error inspect(caf::deserializer& source, segment_ptr& x) {
   x.reset(new segment, false);
-  return source(x->header_, x->meta_, x->chunk_);
+  if (auto error = source(x->header_))
+    return error;
+  if (auto error = read_meta_data(source, x->header_.version, x->meta_))
+    return error;
+  x->intern_layouts();
+  return source(x->chunk_);
 }
 
 ids flat_slice_ids(const segment::meta_data& x) {
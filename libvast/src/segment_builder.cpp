@@ -14,43 +14,158 @@
 #include "vast/segment_builder.hpp"
 
 #include <caf/binary_serializer.hpp>
+#include <caf/serializer.hpp>
 
+#include "vast/compression.hpp"
 #include "vast/error.hpp"
 #include "vast/ids.hpp"
 #include "vast/logger.hpp"
 #include "vast/segment.hpp"
 #include "vast/table_slice.hpp"
+#include "vast/type.hpp"
+#include "vast/view.hpp"
 
 #include "vast/detail/assert.hpp"
 #include "vast/detail/byte_swap.hpp"
 #include "vast/detail/narrow.hpp"
 
+#include <tuple>
+
 namespace vast {
 
-segment_builder::segment_builder() {
+segment_builder::segment_builder(compression method, bool columnar)
+  : method_{method}, columnar_{columnar} {
   reset();
 }
 
+template <class F>
+caf::expected<std::pair<compression, uint64_t>>
+segment_builder::append(F f) {
+  auto before = table_slice_buffer_.size();
+  if (method_ == compression::null) {
+    caf::binary_serializer sink{nullptr, table_slice_buffer_};
+    if (auto error = f(sink)) {
+      table_slice_buffer_.resize(before);
+      return error;
+    }
+    uint64_t bytes = table_slice_buffer_.size() - before;
+    return std::pair{compression::null, bytes};
+  }
+  // Serialize into a scratch buffer first and then compress into the segment.
+  compression_buffer_.clear();
+  caf::binary_serializer sink{nullptr, compression_buffer_};
+  if (auto error = f(sink))
+    return error;
+  uint64_t bytes = compression_buffer_.size();
+  VAST_ASSERT(method_ == compression::lz4);
+  auto bound = lz4::compress_bound(compression_buffer_.size());
+  table_slice_buffer_.resize(before + bound);
+  auto n = lz4::compress(compression_buffer_.data(),
+                         compression_buffer_.size(),
+                         table_slice_buffer_.data() + before, bound);
+  if (n == 0 || n >= compression_buffer_.size()) {
+    // Store incompressible data as is.
+    table_slice_buffer_.resize(before);
+    table_slice_buffer_.insert(table_slice_buffer_.end(),
+                               compression_buffer_.begin(),
+                               compression_buffer_.end());
+    return std::pair{compression::null, bytes};
+  }
+  table_slice_buffer_.resize(before + n);
+  return std::pair{method_, bytes};
+}
+
 caf::error segment_builder::add(table_slice_ptr x) {
   if (x->offset() < min_table_slice_offset_)
     return make_error(ec::unspecified, "slice offsets not increasing");
-  auto before = table_slice_buffer_.size();
-  caf::binary_serializer sink{nullptr, table_slice_buffer_};
-  if (auto error = sink(x)) {
-    table_slice_buffer_.resize(before);
-    return error;
+  if (columnar_) {
+    if (auto error = add_columns(*x))
+      return error;
+  } else {
+    // The layout, offset, and number of rows live in the meta data, so we
+    // only store the table slice contents.
+    auto before = table_slice_buffer_.size();
+    auto result = append([&](caf::serializer& sink) {
+      return x->serialize(sink);
+    });
+    if (!result)
+      return result.error();
+    auto after = table_slice_buffer_.size();
+    VAST_ASSERT(before < after);
+    segment::table_slice_synopsis synopsis;
+    synopsis.start = detail::narrow_cast<int64_t>(before);
+    synopsis.end = detail::narrow_cast<int64_t>(after);
+    synopsis.offset = x->offset();
+    synopsis.size = x->rows();
+    std::tie(synopsis.method, synopsis.bytes) = *result;
+    synopsis.layout = intern(x->layout());
+    synopsis.implementation = x->implementation_id();
+    meta_.slices.push_back(std::move(synopsis));
   }
-  auto after = table_slice_buffer_.size();
-  VAST_ASSERT(before < after);
-  meta_.slices.push_back({
-    detail::narrow_cast<int64_t>(before),
-    detail::narrow_cast<int64_t>(after),
-    x->offset(), x->rows()});
   min_table_slice_offset_ = x->offset() + x->rows();
   slices_.push_back(x);
   return caf::none;
 }
 
+caf::error segment_builder::add_columns(const table_slice& x) {
+  auto before = table_slice_buffer_.size();
+  segment::table_slice_synopsis synopsis;
+  synopsis.start = detail::narrow_cast<int64_t>(before);
+  synopsis.offset = x.offset();
+  synopsis.size = x.rows();
+  synopsis.implementation = x.implementation_id();
+  synopsis.columns.reserve(x.columns());
+  std::vector<data> values;
+  for (size_t col = 0; col < x.columns(); ++col) {
+    auto basic = is_basic(x.layout().fields[col].type);
+    segment::column_synopsis column;
+    values.clear();
+    values.reserve(x.rows());
+    for (size_t row = 0; row < x.rows(); ++row) {
+      auto& value = values.emplace_back(materialize(x.at(row, col)));
+      if (!basic || caf::holds_alternative<caf::none_t>(value))
+        continue;
+      if (caf::holds_alternative<caf::none_t>(column.min) || value < column.min)
+        column.min = value;
+      if (caf::holds_alternative<caf::none_t>(column.max) || column.max < value)
+        column.max = value;
+    }
+    column.start = detail::narrow_cast<int64_t>(table_slice_buffer_.size());
+    auto result = append([&](caf::serializer& sink) {
+      return sink(values);
+    });
+    if (!result) {
+      table_slice_buffer_.resize(before);
+      return result.error();
+    }
+    column.end = detail::narrow_cast<int64_t>(table_slice_buffer_.size());
+    std::tie(column.method, column.bytes) = *result;
+    synopsis.columns.push_back(std::move(column));
+  }
+  synopsis.end = detail::narrow_cast<int64_t>(table_slice_buffer_.size());
+  synopsis.bytes = detail::narrow_cast<uint64_t>(synopsis.end
+                                                 - synopsis.start);
+  synopsis.layout = intern(x.layout());
+  meta_.slices.push_back(std::move(synopsis));
+  return caf::none;
+}
+
+uint32_t segment_builder::intern(const record_type& layout) {
+  auto& layouts = meta_.layouts;
+  auto digest = uhash<xxhash64>{}(layout);
+  if (auto i = layouts_.find(digest); i != layouts_.end()) {
+    // Guard against digest collisions; they merely cost a duplicate entry.
+    if (layouts[i->second] == layout)
+      return i->second;
+    layouts.push_back(layout);
+    return detail::narrow_cast<uint32_t>(layouts.size() - 1);
+  }
+  layouts.push_back(layout);
+  auto index = detail::narrow_cast<uint32_t>(layouts.size() - 1);
+  layouts_.emplace(digest, index);
+  return index;
+}
+
 segment_ptr segment_builder::finish() {
   if (meta_.slices.empty())
     return nullptr;
@@ -60,6 +175,7 @@ segment_ptr segment_builder::finish() {
   result->header_.magic = segment::magic;
   result->header_.version = segment::version;
   result->header_.id = id_;
+  result->intern_layouts();
   reset();
   return result;
 }
@@ -79,6 +195,14 @@ segment_builder::lookup(const ids& xs) const {
   return result;
 }
 
+compression segment_builder::method() const {
+  return method_;
+}
+
+bool segment_builder::columnar() const {
+  return columnar_;
+}
+
 const uuid& segment_builder::id() const {
   return id_;
 }
@@ -90,6 +214,7 @@ size_t segment_builder::table_slice_bytes() const {
 void segment_builder::reset() {
   min_table_slice_offset_ = 0;
   meta_ = {};
+  layouts_.clear();
   id_ = uuid::random();
   table_slice_buffer_ = {};
   slices_.clear();
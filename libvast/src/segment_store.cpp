@@ -18,15 +18,20 @@
 #include <caf/settings.hpp>
 
 #include "vast/bitmap_algorithms.hpp"
+#include "vast/defaults.hpp"
 #include "vast/error.hpp"
 #include "vast/event.hpp"
+#include "vast/expression.hpp"
 #include "vast/ids.hpp"
 #include "vast/load.hpp"
 #include "vast/logger.hpp"
 #include "vast/save.hpp"
 #include "vast/segment_store.hpp"
 
+#include "vast/concept/parseable/to.hpp"
+#include "vast/concept/parseable/vast/uuid.hpp"
 #include "vast/concept/printable/to_string.hpp"
+#include "vast/concept/printable/vast/compression.hpp"
 #include "vast/concept/printable/vast/error.hpp"
 #include "vast/concept/printable/vast/filesystem.hpp"
 #include "vast/concept/printable/vast/uuid.hpp"
@@ -34,15 +39,23 @@
 #include "vast/table_slice.hpp"
 #include "vast/to_events.hpp"
 
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <unordered_set>
+
 namespace vast {
 
 segment_store_ptr segment_store::make(path dir, size_t max_segment_size,
-                                      size_t in_memory_segments) {
+                                      size_t in_memory_segments,
+                                      compression method, bool columnar) {
   VAST_TRACE(VAST_ARG(dir), VAST_ARG(max_segment_size),
              VAST_ARG(in_memory_segments));
   VAST_ASSERT(max_segment_size > 0);
   auto x = std::make_unique<segment_store>(std::move(dir), max_segment_size,
-                                           in_memory_segments);
+                                           in_memory_segments, method,
+                                           columnar);
   // Materialize meta data of existing segments.
   if (exists(x->meta_path())) {
     VAST_DEBUG_ANON(__func__, "loads segment meta data from", x->meta_path());
@@ -52,6 +65,61 @@ segment_store_ptr segment_store::make(path dir, size_t max_segment_size,
       return nullptr;
     }
   }
+  // Replay changes since the last checkpoint. A crash while appending to the
+  // journal may leave a truncated entry at its end, which we ignore.
+  if (exists(x->journal_path())) {
+    VAST_DEBUG_ANON(__func__, "replays segment meta data changes from",
+                    x->journal_path());
+    std::ifstream fs{x->journal_path().str(), std::ios::binary};
+    if (!fs) {
+      VAST_ERROR_ANON(__func__, "failed to open", x->journal_path());
+      return nullptr;
+    }
+    auto sb = fs.rdbuf();
+    while (sb->sgetc() != std::char_traits<char>::eof()) {
+      journal_entry entry;
+      if (auto err = load(nullptr, *sb, entry)) {
+        VAST_WARNING_ANON(__func__, "ignores truncated entry in",
+                          x->journal_path());
+        break;
+      }
+      x->apply(entry);
+    }
+    fs.close();
+    // Fold the replayed changes into a fresh checkpoint. This also discards
+    // a truncated entry before we append to the journal again.
+    if (auto err = x->checkpoint()) {
+      VAST_ERROR_ANON(__func__, "failed to write a checkpoint to",
+                      x->meta_path());
+      return nullptr;
+    }
+  }
+  // Materialize the deletion bitmaps of existing segments.
+  if (exists(x->tombstone_path())) {
+    VAST_DEBUG_ANON(__func__, "loads tombstones from", x->tombstone_path());
+    std::unordered_set<uuid> segments;
+    for (auto i = x->segments_.begin(); i != x->segments_.end(); ++i)
+      segments.insert(i->value);
+    for (auto& filename : directory{x->tombstone_path()}) {
+      auto id = to<uuid>(filename.basename().str());
+      if (!id) {
+        VAST_WARNING_ANON(__func__, "ignores unexpected file", filename);
+        continue;
+      }
+      // A crash after removing a segment from the meta data may leave its
+      // deletion bitmap behind.
+      if (segments.count(*id) == 0) {
+        VAST_DEBUG_ANON(__func__, "removes stale tombstones", filename);
+        rm(filename);
+        continue;
+      }
+      if (auto err = load(nullptr, filename, x->tombstones_[*id])) {
+        VAST_ERROR_ANON(__func__, "failed to unarchive tombstones from",
+                        filename);
+        return nullptr;
+      }
+    }
+  }
   return x;
 }
 
@@ -64,7 +132,7 @@ caf::error segment_store::put(table_slice_ptr xs) {
   VAST_DEBUG(this, "adds a table slice");
   if (auto error = builder_.add(xs))
     return error;
-  if (!segments_.inject(xs->offset(), xs->offset() + xs->rows(), builder_.id()))
+  if (!inject(xs->offset(), xs->offset() + xs->rows(), builder_.id()))
     return make_error(ec::unspecified, "failed to update range_map");
   if (builder_.table_slice_bytes() < max_segment_size_)
     return caf::none;
@@ -85,73 +153,266 @@ caf::error segment_store::flush() {
   cache_.emplace(x->id(), x);
   VAST_DEBUG(this, "wrote new segment to", filename.trim(-3));
   VAST_DEBUG(this, "saves segment meta data");
-  return save(nullptr, meta_path(), segments_);
+  return sync_meta();
+}
+
+bool segment_store::inject(id first, id last, const uuid& segment) {
+  if (!segments_.inject(first, last, segment))
+    return false;
+  // Consecutive table slices of the same segment share a single entry.
+  if (!unwritten_.empty()) {
+    auto& prev = unwritten_.back();
+    if (prev.op == journal_entry::action::inject && prev.segment == segment
+        && prev.last == first) {
+      prev.last = last;
+      return true;
+    }
+  }
+  unwritten_.push_back({journal_entry::action::inject, first, last, segment});
+  return true;
+}
+
+void segment_store::erase_segment(const uuid& segment) {
+  segments_.erase_value(segment);
+  unwritten_.push_back({journal_entry::action::erase, 0, 0, segment});
+}
+
+void segment_store::apply(const journal_entry& x) {
+  switch (x.op) {
+    case journal_entry::action::inject:
+      // Overwriting the range makes replaying an entry idempotent, which
+      // matters after a crash between writing a checkpoint and truncating
+      // the journal.
+      segments_.erase(x.first, x.last);
+      segments_.inject(x.first, x.last, x.segment);
+      break;
+    case journal_entry::action::erase:
+      segments_.erase_value(x.segment);
+      break;
+  }
+}
+
+caf::error segment_store::sync_meta() {
+  if (auto err = write_meta())
+    return err;
+  // Removing a deletion bitmap before the meta data stops referring to its
+  // segment would resurrect the erased events after a crash.
+  for (auto& id : stale_tombstones_)
+    rm(tombstone_path() / to_string(id));
+  stale_tombstones_.clear();
+  return caf::none;
+}
+
+caf::error segment_store::write_meta() {
+  if (unwritten_.empty())
+    return caf::none;
+  // Rewriting the checkpoint costs time linear in the size of the mapping,
+  // so we only do it once the journal has grown at least as large.
+  auto threshold = std::max(segments_.size(),
+                            defaults::system::min_journal_entries);
+  if (journal_size_ + unwritten_.size() > threshold)
+    return checkpoint();
+  if (auto dir = journal_path().parent(); !exists(dir))
+    if (auto res = mkdir(dir); !res)
+      return res.error();
+  std::ofstream fs{journal_path().str(), std::ios::binary | std::ios::app};
+  if (!fs)
+    return make_error(ec::filesystem_error, "failed to open journal",
+                      journal_path());
+  for (auto& x : unwritten_)
+    if (auto err = save(nullptr, fs, x))
+      return err;
+  if (!fs.flush())
+    return make_error(ec::filesystem_error, "failed to append to journal",
+                      journal_path());
+  journal_size_ += unwritten_.size();
+  unwritten_.clear();
+  return caf::none;
+}
+
+caf::error segment_store::checkpoint() {
+  VAST_DEBUG(this, "writes a checkpoint of the segment meta data");
+  if (auto err = save(nullptr, meta_path(), segments_))
+    return err;
+  if (exists(journal_path()) && !rm(journal_path()))
+    return make_error(ec::filesystem_error, "failed to truncate journal",
+                      journal_path());
+  journal_size_ = 0;
+  unwritten_.clear();
+  return caf::none;
 }
 
 caf::expected<segment_ptr> segment_store::load_segment(uuid id) const {
   auto filename = segment_path() / to_string(id);
   VAST_DEBUG(this, "loads segment from", filename);
-  if (auto chk = chunk::mmap(filename))
-    return segment::make(std::move(chk));
-  return make_error(ec::filesystem_error, "failed to mmap chunk", filename);
+  auto chk = chunk::mmap(filename);
+  if (!chk)
+    return make_error(ec::filesystem_error, "failed to mmap chunk", filename);
+  auto result = segment::make(std::move(chk));
+  if (result != nullptr)
+    if (auto i = tombstones_.find(id); i != tombstones_.end())
+      result->erase(i->second);
+  return result;
+}
+
+segment_ptr segment_store::prefetch_segment(const uuid& id,
+                                            const ids& xs) const {
+  if (id == builder_.id() || cache_.contains(id))
+    return nullptr;
+  // A failure to load the segment surfaces when the lookup gets to it.
+  auto x = load_segment(id);
+  if (!x || *x == nullptr)
+    return nullptr;
+  VAST_DEBUG(this, "prefetches segment", id);
+  (*x)->prefetch(xs);
+  return std::move(*x);
 }
 
-std::unique_ptr<store::lookup> segment_store::extract(const ids& xs) const {
+std::unique_ptr<store::lookup>
+segment_store::extract(const ids& xs, const expression& expr,
+                       const std::vector<std::string>& keys) const {
 
   class lookup : public store::lookup {
   public:
     using uuid_iterator = std::vector<uuid>::iterator;
 
-    lookup(const segment_store& store, ids xs, std::vector<uuid>&& candidates)
-      : store_{store}, xs_{std::move(xs)}, candidates_{std::move(candidates)} {
+    lookup(const segment_store& store, ids xs, expression expr,
+           std::vector<std::string> keys, std::vector<uuid>&& candidates)
+      : store_{store},
+        xs_{std::move(xs)},
+        expr_{std::move(expr)},
+        keys_{std::move(keys)},
+        candidates_{std::move(candidates)} {
       // nop
     }
 
     caf::expected<table_slice_ptr> next() override {
+      // Read the next part of the lookup once the previous one is consumed.
+      while (it_ == slices_.end()) {
+        auto read = next_reader();
+        if (!read)
+          // Either an error occurred, or the list of candidates is exhausted.
+          return read.error();
+        auto slices = (*read)();
+        if (!slices)
+          return slices.error();
+        slices_ = std::move(*slices);
+        it_ = slices_.begin();
+      }
+      return *it_++;
+    }
+
+    caf::expected<reader> next_reader() override {
       // Update the buffer if it has been consumed or the previous
       // refresh return an error.
-      while (!buffer_ || it_ == buffer_->end()) {
+      while (!buffer_ || pos_ == buffer_->end()) {
         buffer_ = handle_segment();
         if (!buffer_)
           // Either an error occurred, or the list of candidates is exhausted.
           return buffer_.error();
-        it_ = buffer_->begin();
+        pos_ = buffer_->begin();
       }
-      return *it_++;
+      return std::move(*pos_++);
     }
 
   private:
-    caf::expected<std::vector<table_slice_ptr>> handle_segment() {
+    caf::expected<std::vector<reader>> handle_segment() {
+      if (auto err = refresh())
+        return err;
       if (first_ == candidates_.end())
         return caf::no_error;
       auto& cand = *first_++;
+      std::vector<reader> result;
       if (cand == store_.builder_.id()) {
         VAST_DEBUG(this, "looks into the active segement", cand);
-        return store_.builder_.lookup(xs_);
+        visited_ |= flat_slice_ids(store_.builder_.meta());
+        prefetch_next();
+        // The active segment changes with every put, so we can only defer
+        // handing out its slices.
+        auto slices = store_.builder_.lookup(xs_);
+        if (!slices)
+          return slices.error();
+        for (auto& slice : *slices)
+          result.emplace_back(
+            [slice]() -> caf::expected<std::vector<table_slice_ptr>> {
+              return std::vector<table_slice_ptr>{slice};
+            });
+        return result;
       }
       segment_ptr seg_ptr = nullptr;
       auto i = store_.cache_.find(cand);
       if (i != store_.cache_.end()) {
         VAST_DEBUG(this, "got cache hit for segment", cand);
         seg_ptr = i->second;
+      } else if (next_ != nullptr && next_->id() == cand) {
+        VAST_DEBUG(this, "got cache miss for prefetched segment", cand);
+        seg_ptr = std::move(next_);
+        store_.cache_.emplace(cand, seg_ptr);
       } else {
         VAST_DEBUG(this, "got cache miss for segment", cand);
         if(auto seg_ptr_ = store_.load_segment(cand))
           seg_ptr = *seg_ptr_;
         else
           return seg_ptr_.error();
-        i = store_.cache_.emplace(cand, seg_ptr).first;
+        seg_ptr->prefetch(xs_);
+        store_.cache_.emplace(cand, seg_ptr);
       }
       VAST_ASSERT(seg_ptr != nullptr);
-      return seg_ptr->lookup(xs_);
+      visited_ |= flat_slice_ids(seg_ptr->meta());
+      prefetch_next();
+      // Erasing modifies the tombstones of the segment, so the readers work
+      // on a copy.
+      auto tombstones = std::make_shared<const ids>(seg_ptr->tombstones());
+      for (auto slice : seg_ptr->locate(xs_, expr_))
+        result.emplace_back([=, keys = keys_] {
+          return seg_ptr->extract(slice, keys, *tombstones);
+        });
+      return result;
+    }
+
+    // Selects the candidates again for all events we have not visited yet if
+    // the store modified segments since the last selection. Erasing and
+    // compacting may drop a candidate or move its events into a new segment.
+    // This also outdates the segment that we read ahead.
+    caf::error refresh() {
+      if (erasures_ == store_.erasures_)
+        return caf::none;
+      VAST_DEBUG(this, "selects candidates again after an erasure");
+      erasures_ = store_.erasures_;
+      next_ = nullptr;
+      std::vector<uuid> candidates;
+      if (auto err = store_.select_segments(xs_ - visited_, candidates))
+        return err;
+      candidates_ = std::move(candidates);
+      first_ = candidates_.begin();
+      if (first_ != candidates_.end())
+        next_ = store_.prefetch_segment(*first_, xs_);
+      return caf::none;
+    }
+
+    // Reads the next candidate ahead while the caller processes the slices
+    // of the current one.
+    void prefetch_next() {
+      next_ = nullptr;
+      if (first_ != candidates_.end())
+        next_ = store_.prefetch_segment(*first_, xs_);
     }
 
     const segment_store& store_;
     ids xs_;
+    expression expr_;
+    std::vector<std::string> keys_;
     std::vector<uuid> candidates_;
     uuid_iterator first_ = candidates_.begin();
-    caf::expected<std::vector<table_slice_ptr>> buffer_{caf::no_error};
-    std::vector<table_slice_ptr>::iterator it_;
+    caf::expected<std::vector<reader>> buffer_{caf::no_error};
+    std::vector<reader>::iterator pos_;
+    std::vector<table_slice_ptr> slices_;
+    std::vector<table_slice_ptr>::iterator it_ = slices_.end();
+    segment_ptr next_;
+    // The IDs of all segments that the lookup has visited.
+    ids visited_;
+    // The erasures of the store at the last selection of candidates.
+    uint64_t erasures_ = store_.erasures_;
   };
 
   VAST_TRACE(VAST_ARG(xs));
@@ -164,9 +425,92 @@ std::unique_ptr<store::lookup> segment_store::extract(const ids& xs) const {
   }
   VAST_DEBUG(this, "processes", candidates.size(), "candidates");
   std::partition(candidates.begin(), candidates.end(), [&](const auto& id) {
-    return id == builder_.id() || cache_.find(id) != cache_.end();
+    return id == builder_.id() || cache_.contains(id);
   });
-  return std::make_unique<lookup>(*this, std::move(xs), std::move(candidates));
+  return std::make_unique<lookup>(*this, std::move(xs), expr, keys,
+                                  std::move(candidates));
+}
+
+template <class Segment>
+uint64_t segment_store::rewrite(Segment& seg, const ids& xs) {
+  auto segment_id = seg.id();
+  uint64_t erased_events = 0;
+  // Get all slices in the segment and generate a new segment that contains
+  // only what's left after dropping the selection.
+  auto segment_ids = flat_slice_ids(seg.meta());
+  // Check whether we can drop the entire segment.
+  if (is_subset(segment_ids, xs))
+    return drop(seg);
+  std::vector<table_slice_ptr> slices;
+  if (auto maybe_slices = seg.lookup(segment_ids)) {
+    slices = std::move(*maybe_slices);
+    if (slices.empty()) {
+      VAST_WARNING(this, "got no slices after lookup for segment", segment_id,
+                   "=> erases entire segment!");
+      return drop(seg);
+    }
+  } else {
+    VAST_WARNING(this, "was unable to get table slice for segment",
+                 segment_id, "=> erases entire segment!");
+    return drop(seg);
+  }
+  VAST_ASSERT(slices.size() > 0);
+  // We have IDs we wish to delete in `xs`, but we need a bitmap of what to
+  // keep for `select` in order to fill `new_slices` with the table slices
+  // that remain after dropping all deleted IDs from the segment.
+  auto keep_mask = ~xs;
+  std::vector<table_slice_ptr> new_slices;
+  for (auto& slice : slices) {
+    // Expand keep_mask on-the-fly if needed.
+    auto max_id = slice->offset() + slice->rows();
+    if (keep_mask.size() < max_id)
+      keep_mask.append_bits(true, max_id - keep_mask.size());
+    size_t new_slices_size_before = new_slices.size();
+    select(new_slices, slice, keep_mask);
+    size_t remaining_rows = 0;
+    for (size_t i = new_slices_size_before; i < new_slices.size(); ++i)
+      remaining_rows += new_slices[i]->rows();
+    erased_events += slice->rows() - remaining_rows;
+  }
+  if (new_slices.empty()) {
+    VAST_WARNING(this, "was unable to generate any new slice for segment",
+                 segment_id, "=> erases entire segment!");
+    return drop(seg);
+  }
+  VAST_DEBUG(this, "shrinks segment", segment_id, "from", slices.size(), "to",
+             new_slices.size(), "slices");
+  // Remove stale state.
+  erase_segment(segment_id);
+  // Create a new segment from the remaining slices.
+  segment_builder tmp_builder{builder_.method(), builder_.columnar()};
+  segment_builder* builder = &tmp_builder;
+  if constexpr (std::is_same_v<decltype(seg), segment_builder&>) {
+    // If `rewrite` got called with a builder then we simply use that by
+    // resetting it and filling it with new content. Otherwise, we fill
+    // `tmp_builder` instead and replace the the segment `seg` in the next
+    // `if constexpr` block.
+    seg.reset();
+    builder = &seg;
+  }
+  for (auto& slice : new_slices) {
+    if (auto err = builder->add(slice)) {
+      VAST_ERROR(this, "failed to add slice to builder:" << err);
+    } else if (!inject(slice->offset(), slice->offset() + slice->rows(),
+                       builder->id()))
+      VAST_ERROR(this, "failed to update range_map");
+  }
+  // Flush the new segment and remove the previous segment.
+  if constexpr (std::is_same_v<decltype(seg), segment&>) {
+    auto new_segment = builder->finish();
+    auto filename = segment_path() / to_string(new_segment->id());
+    if (auto err = save(nullptr, filename, new_segment))
+      VAST_ERROR(this, "failed to persist the new segment");
+    auto stale_filename = segment_path() / to_string(segment_id);
+    // Schedule deletion of the segment file when releasing the chunk.
+    seg.chunk()->add_deletion_step([=] { rm(stale_filename); });
+  }
+  // else: nothing to do, since we can continue filling the active segment.
+  return erased_events;
 }
 
 caf::error segment_store::erase(const ids& xs) {
@@ -177,124 +521,115 @@ caf::error segment_store::erase(const ids& xs) {
     return err;
   if (candidates.empty())
     return caf::none;
-  auto is_subset_of_xs = [&](const ids& ys) { return is_subset(ys, xs); };
   // Counts number of total erased events for user-facing output.
   uint64_t erased_events = 0;
-  // Implements the body of the for-loop below. This lambda must be generic,
-  // because the argument is either a `segment` or a `segment_builder`. This
-  // algorithm removes all events with IDs in `xs` from a segment. For existing
-  // segments, we create a new segment that contains all table slices that
-  // remain after erasing `xs` from the input segment. For builders, we update
-  // the builder directly by replacing the set of table slices. In any case, we
-  // have to update `segments_` to point to the new segment ID.
-  auto impl = [&](auto& seg) {
-    auto segment_id = seg.id();
-    // Get all slices in the segment and generate a new segment that contains
-    // only what's left after dropping the selection.
-    auto segment_ids = flat_slice_ids(seg.meta());
-    // Check whether we can drop the entire segment.
-    if (is_subset_of_xs(segment_ids)) {
-      erased_events += drop(seg);
-      return;
-    }
-    std::vector<table_slice_ptr> slices;
-    if (auto maybe_slices = seg.lookup(segment_ids)) {
-      slices = std::move(*maybe_slices);
-      if (slices.empty()) {
-        VAST_WARNING(this, "got no slices after lookup for segment", segment_id,
-                     "=> erases entire segment!");
-        erased_events += drop(seg);
-        return;
-      }
-    } else {
-      VAST_WARNING(this, "was unable to get table slice for segment",
-                   segment_id, "=> erases entire segment!");
-      erased_events += drop(seg);
-      return;
-    }
-    VAST_ASSERT(slices.size() > 0);
-    // We have IDs we wish to delete in `xs`, but we need a bitmap of what to
-    // keep for `select` in order to fill `new_slices` with the table slices
-    // that remain after dropping all deleted IDs from the segment.
-    auto keep_mask = ~xs;
-    std::vector<table_slice_ptr> new_slices;
-    for (auto& slice : slices) {
-      // Expand keep_mask on-the-fly if needed.
-      auto max_id = slice->offset() + slice->rows();
-      if (keep_mask.size() < max_id)
-        keep_mask.append_bits(true, max_id - keep_mask.size());
-      size_t new_slices_size_before = new_slices.size();
-      select(new_slices, slice, keep_mask);
-      size_t remaining_rows = 0;
-      for (size_t i = new_slices_size_before; i < new_slices.size(); ++i)
-        remaining_rows += new_slices[i]->rows();
-      erased_events += slice->rows() - remaining_rows;
-    }
-    if (new_slices.empty()) {
-      VAST_WARNING(this, "was unable to generate any new slice for segment",
-                   segment_id, "=> erases entire segment!");
-      erased_events += drop(seg);
-      return;
-    }
-    VAST_DEBUG(this, "shrinks segment", segment_id, "from", slices.size(), "to",
-               new_slices.size(), "slices");
-    // Remove stale state.
-    segments_.erase_value(segment_id);
-    // Create a new segment from the remaining slices.
-    segment_builder tmp_builder;
-    segment_builder* builder = &tmp_builder;
-    if constexpr (std::is_same_v<decltype(seg), segment_builder&>) {
-      // If `update` got called with a builder then we simply use that by
-      // resetting it and filling it with new content. Otherwise, we fill
-      // `tmp_builder` instead and replace the the segment `seg` in the next
-      // `if constexpr` block.
-      seg.reset();
-      builder = &seg;
-    }
-    for (auto& slice : new_slices) {
-      if (auto err = builder->add(slice)) {
-        VAST_ERROR(this, "failed to add slice to builder:" << err);
-      } else if (!segments_.inject(slice->offset(),
-                                   slice->offset() + slice->rows(),
-                                   builder->id()))
-        VAST_ERROR(this, "failed to update range_map");
-    }
-    // Flush the new segment and remove the previous segment.
-    if constexpr (std::is_same_v<decltype(seg), segment&>) {
-      auto new_segment = builder->finish();
-      auto filename = segment_path() / to_string(new_segment->id());
-      if (auto err = save(nullptr, filename, new_segment))
-        VAST_ERROR(this, "failed to persist the new segment");
-      auto stale_filename = segment_path() / to_string(segment_id);
-      // Schedule deletion of the segment file when releasing the chunk.
-      seg.chunk()->add_deletion_step([=] { rm(stale_filename); });
-    }
-    // else: nothing to do, since we can continue filling the active segment.
-  };
-  // Iterate affected segments.
+  // Iterate affected segments. We only rewrite the active segment, because
+  // it lives in memory. For persisted segments, we record the erased events
+  // in a deletion bitmap instead, and leave it to ::compact to eventually
+  // rewrite the segment.
+  caf::error err;
   for (auto& candidate : candidates) {
+    caf::expected<uint64_t> n{uint64_t{0}};
     auto j = cache_.find(candidate);
     if (j != cache_.end()) {
       VAST_DEBUG(this, "erases from the cached segement", candidate);
-      impl(*j->second);
-      cache_.erase(j);
+      auto seg_ptr = j->second;
+      n = tombstone(*seg_ptr, xs);
     } else if (candidate == builder_.id()) {
       VAST_DEBUG(this, "erases from the active segement", candidate);
-      impl(builder_);
-    } else if (auto sptr = load_segment(candidate)) {
+      n = rewrite(builder_, xs);
+    } else if (auto sptr = load_segment(candidate); !sptr) {
+      n = std::move(sptr.error());
+    } else if (*sptr == nullptr) {
+      n = make_error(ec::format_error, "failed to load segment", candidate);
+    } else {
       VAST_DEBUG(this, "erases from the segement", candidate);
-      impl(**sptr);
+      n = tombstone(**sptr, xs);
+    }
+    if (!n) {
+      VAST_ERROR(this, "failed to erase events from segment", candidate);
+      err = std::move(n.error());
+      break;
     }
+    erased_events += *n;
   }
+  // The meta data must reflect the segments that we erased from, even if
+  // we stopped early.
   if (erased_events > 0) {
     VAST_INFO(this, "erased", erased_events, "events");
-    if (auto err = save(nullptr, meta_path(), segments_))
-      VAST_ERROR(this, "failed to persist meta data after adding segment");
+    ++erasures_;
+    if (auto sync_err = sync_meta()) {
+      VAST_ERROR(this, "failed to persist meta data after erasing events");
+      if (!err)
+        err = std::move(sync_err);
+    }
   }
-  return caf::none;
+  return err;
+}
+
+caf::expected<bool> segment_store::compact(double threshold) {
+  VAST_TRACE(VAST_ARG(threshold));
+  if (tombstones_.empty())
+    return false;
+  // Count the events per segment with erased events.
+  std::unordered_map<uuid, uint64_t> events;
+  for (auto i = segments_.begin(); i != segments_.end(); ++i)
+    if (tombstones_.count(i->value) > 0)
+      events[i->value] += i->right - i->left;
+  std::vector<uuid> candidates;
+  for (auto& [id, erased] : tombstones_)
+    if (auto n = events[id]; n > 0 && rank(erased) >= threshold * n)
+      candidates.push_back(id);
+  if (candidates.empty())
+    return false;
+  auto& id = candidates.front();
+  segment_ptr seg_ptr = nullptr;
+  if (auto i = cache_.find(id); i != cache_.end()) {
+    seg_ptr = i->second;
+  } else {
+    auto x = load_segment(id);
+    if (!x)
+      return x.error();
+    seg_ptr = std::move(*x);
+  }
+  VAST_DEBUG(this, "compacts segment", id, "with", rank(seg_ptr->tombstones()),
+             "erased events");
+  rewrite(*seg_ptr, seg_ptr->tombstones());
+  ++erasures_;
+  cache_.erase(id);
+  if (tombstones_.erase(id) > 0)
+    stale_tombstones_.push_back(id);
+  if (auto err = sync_meta())
+    return err;
+  return candidates.size() > 1;
 }
 
-caf::expected<std::vector<table_slice_ptr>> segment_store::get(const ids& xs) {
+caf::expected<uint64_t> segment_store::tombstone(segment& seg,
+                                                  const ids& xs) {
+  auto segment_id = seg.id();
+  auto segment_ids = flat_slice_ids(seg.meta());
+  // Check whether we can drop the entire segment.
+  if (is_subset(segment_ids, xs | seg.tombstones()))
+    return drop(seg);
+  auto erased_events = rank((xs & segment_ids) - seg.tombstones());
+  if (erased_events == 0)
+    return uint64_t{0};
+  // Only consider the events erased once their deletion bitmap is on disk.
+  // Otherwise they would come back after a restart.
+  auto tombstones = seg.tombstones() | (xs & segment_ids);
+  auto filename = tombstone_path() / to_string(segment_id);
+  if (auto err = save(nullptr, filename, tombstones)) {
+    VAST_ERROR(this, "failed to persist tombstones of segment", segment_id);
+    return err;
+  }
+  seg.erase(xs);
+  tombstones_[segment_id] = seg.tombstones();
+  return erased_events;
+}
+
+caf::expected<std::vector<table_slice_ptr>>
+segment_store::get(const ids& xs, const expression& expr,
+                   const std::vector<std::string>& keys) {
   VAST_TRACE(VAST_ARG(xs));
   // Collect candidate segments by seeking through the ID set and
   // probing each ID interval.
@@ -305,30 +640,46 @@ caf::expected<std::vector<table_slice_ptr>> segment_store::get(const ids& xs) {
   std::vector<table_slice_ptr> result;
   VAST_DEBUG(this, "processes", candidates.size(), "candidates");
   std::partition(candidates.begin(), candidates.end(), [&](const auto& id) {
-    return id == builder_.id() || cache_.find(id) != cache_.end();
+    return id == builder_.id() || cache_.contains(id);
   });
+  // Reads the next candidate ahead while we process the current one.
+  segment_ptr next = nullptr;
+  auto prefetch_next = [&](auto cand) {
+    next = nullptr;
+    if (++cand != candidates.end())
+      next = prefetch_segment(*cand, xs);
+  };
   for (auto cand = candidates.begin(); cand != candidates.end(); ++cand) {
     auto& id = *cand;
     caf::expected<std::vector<table_slice_ptr>> slices{caf::no_error};
     if (id == builder_.id()) {
       VAST_DEBUG(this, "looks into the active segement", id);
+      prefetch_next(cand);
       slices = builder_.lookup(xs);
     } else {
       segment_ptr seg_ptr = nullptr;
       auto i = cache_.find(id);
       if (i != cache_.end()) {
         VAST_DEBUG(this, "got cache hit for segment", id);
+        seg_ptr = i->second;
+      } else if (next != nullptr && next->id() == id) {
+        VAST_DEBUG(this, "got cache miss for prefetched segment", id);
+        seg_ptr = std::move(next);
+        cache_.emplace(id, seg_ptr);
       } else {
         VAST_DEBUG(this, "got cache miss for segment", id);
         auto x = load_segment(id);
         if (!x)
           return x.error();
-        i = cache_.emplace(id, std::move(*x)).first;
+        seg_ptr = std::move(*x);
+        seg_ptr->prefetch(xs);
+        // The cache may decline the segment in favor of more popular ones.
+        cache_.emplace(id, seg_ptr);
       }
-      seg_ptr = i->second;
       VAST_ASSERT(seg_ptr != nullptr);
+      prefetch_next(cand);
       VAST_DEBUG(this, "looks into segment", id);
-      slices = seg_ptr->lookup(xs);
+      slices = seg_ptr->lookup(xs, expr, keys);
     }
     if (!slices)
       return slices.error();
@@ -341,8 +692,12 @@ caf::expected<std::vector<table_slice_ptr>> segment_store::get(const ids& xs) {
 void segment_store::inspect_status(caf::settings& dict) {
   using caf::put;
   put(dict, "meta-path", meta_path().str());
+  put(dict, "journal-path", journal_path().str());
+  put(dict, "journal-entries", journal_size_);
   put(dict, "segment-path", segment_path().str());
   put(dict, "max-segment-size", max_segment_size_);
+  put(dict, "compression", to_string(builder_.method()));
+  put(dict, "columnar", builder_.columnar());
   auto& segments = put_dictionary(dict, "segments");
   // Note: `for (auto& kvp : segments_)` does not compile.
   for (auto i = segments_.begin(); i != segments_.end(); ++i) {
@@ -356,16 +711,34 @@ void segment_store::inspect_status(caf::settings& dict) {
   auto& cached = put_list(dict, "cached");
   for (auto& kvp : cache_)
     cached.emplace_back(to_string(kvp.first));
+  auto& cache = put_dictionary(dict, "cache");
+  auto& stats = cache_.statistics();
+  put(cache, "capacity", cache_.capacity());
+  put(cache, "bytes", cache_.weight());
+  put(cache, "hits", stats.hits);
+  put(cache, "misses", stats.misses);
+  put(cache, "evictions", stats.evictions);
+  put(cache, "rejections", stats.rejections);
+  auto& tombstones = put_dictionary(dict, "tombstones");
+  for (auto& [id, erased] : tombstones_)
+    put(tombstones, to_string(id), rank(erased));
   auto& current = put_dictionary(dict, "current-segment");
   put(current, "id", to_string(builder_.id()));
   put(current, "size", builder_.table_slice_bytes());
 }
 
 segment_store::segment_store(path dir, uint64_t max_segment_size,
-                             size_t in_memory_segments)
+                             size_t in_memory_segments, compression method,
+                             bool columnar)
   : dir_{std::move(dir)},
     max_segment_size_{max_segment_size},
-    cache_{in_memory_segments} {
+    // A segment overshoots the maximum size by up to one table slice, so we
+    // weigh it at most that much to fit `in_memory_segments` of them.
+    cache_{in_memory_segments * max_segment_size,
+           [=](const segment_ptr& x) {
+             return std::min<uint64_t>(x->chunk()->size(), max_segment_size);
+           }},
+    builder_{method, columnar} {
   // nop
 }
 
@@ -389,11 +762,15 @@ uint64_t segment_store::drop(segment& x) {
   auto segment_id = x.id();
   for (auto& slices_data : x.meta().slices)
     erased_events += slices_data.size;
+  erased_events -= rank(x.tombstones());
   VAST_INFO(this, "erases entire segment", segment_id);
   // Schedule deletion of the segment file when releasing the chunk.
   auto filename = segment_path() / to_string(segment_id);
   x.chunk()->add_deletion_step([=] { rm(filename); });
-  segments_.erase_value(segment_id);
+  erase_segment(segment_id);
+  cache_.erase(segment_id);
+  if (tombstones_.erase(segment_id) > 0)
+    stale_tombstones_.push_back(segment_id);
   return erased_events;
 }
 
@@ -404,7 +781,7 @@ uint64_t segment_store::drop(segment_builder& x) {
     erased_events += slices_data.size;
   VAST_INFO(this, "erases entire segment", segment_id);
   x.reset();
-  segments_.erase_value(segment_id);
+  erase_segment(segment_id);
   return erased_events;
 }
 
@@ -13,6 +13,10 @@
 
 #include "vast/store.hpp"
 
+#include "vast/expression.hpp"
+#include "vast/ids.hpp"
+#include "vast/table_slice.hpp"
+
 namespace vast {
 
 store::~store() {
@@ -23,4 +27,12 @@ store::lookup::~lookup() {
   // nop
 }
 
+std::unique_ptr<store::lookup> store::extract(const ids& xs) const {
+  return extract(xs, expression{}, {});
+}
+
+caf::expected<std::vector<table_slice_ptr>> store::get(const ids& xs) {
+  return get(xs, expression{}, {});
+}
+
 } // namespace vast
@@ -0,0 +1,144 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+#include "vast/system/aggregate_command.hpp"
+
+#include "vast/aggregation.hpp"
+#include "vast/concept/parseable/to.hpp"
+#include "vast/concept/parseable/vast/expression.hpp"
+#include "vast/concept/printable/to_string.hpp"
+#include "vast/concept/printable/vast/data.hpp"
+#include "vast/defaults.hpp"
+#include "vast/error.hpp"
+#include "vast/logger.hpp"
+#include "vast/scope_linked.hpp"
+#include "vast/system/atoms.hpp"
+#include "vast/system/read_query.hpp"
+#include "vast/system/signal_monitor.hpp"
+#include "vast/system/spawn_or_connect_to_node.hpp"
+#include "vast/system/start_command.hpp"
+#include "vast/system/tracker.hpp"
+
+#include <caf/actor.hpp>
+#include <caf/event_based_actor.hpp>
+#include <caf/scoped_actor.hpp>
+#include <caf/settings.hpp>
+#include <caf/stateful_actor.hpp>
+
+#include <chrono>
+#include <csignal>
+#include <cstring>
+
+using namespace caf;
+using namespace std::chrono_literals;
+
+namespace vast::system {
+
+caf::message
+aggregate_command(const command::invocation& invocation, caf::actor_system& sys) {
+  VAST_TRACE(invocation);
+  const auto& options = invocation.options;
+  // Read query from input file, STDIN or CLI arguments.
+  auto query = read_query(invocation, "aggregate.read");
+  if (!query)
+    return caf::make_message(std::move(query.error()));
+  // Get a convenient and blocking way to interact with actors.
+  caf::scoped_actor self{sys};
+  // Get VAST node.
+  auto node_opt
+    = system::spawn_or_connect_to_node(self, options, content(sys.config()));
+  if (auto err = caf::get_if<caf::error>(&node_opt))
+    return caf::make_message(std::move(*err));
+  auto& node = caf::holds_alternative<caf::actor>(node_opt)
+                 ? caf::get<caf::actor>(node_opt)
+                 : caf::get<scope_linked_actor>(node_opt).get();
+  VAST_ASSERT(node != nullptr);
+  // Start signal monitor.
+  std::thread sig_mon_thread;
+  auto guard = system::signal_monitor::run_guarded(
+    sig_mon_thread, sys, defaults::system::signal_monitoring_interval, self);
+  // Spawn AGGREGATOR at the node.
+  caf::actor agg;
+  auto args = command::invocation{options, "spawn aggregator", {*query}};
+  VAST_DEBUG(invocation.full_name, "spawns aggregator with parameters:",
+             query);
+  caf::error err;
+  self->request(node, caf::infinite, std::move(args))
+    .receive(
+      [&](caf::actor& a) {
+        agg = std::move(a);
+        if (!agg)
+          err = make_error(ec::invalid_result, "remote spawn returned nullptr");
+      },
+      [&](caf::error& e) { err = std::move(e); });
+  if (err)
+    return caf::make_message(std::move(err));
+  self->monitor(agg);
+  self->send(agg, system::run_atom::value, self);
+  // The AGGREGATOR ships its result as its last message before terminating,
+  // so a DOWN message first means that it failed.
+  aggregation result;
+  auto stop = false;
+  self
+    ->do_receive(
+      [&](aggregation& x) {
+        result = std::move(x);
+        stop = true;
+      },
+      [&](caf::down_msg& msg) {
+        VAST_DEBUG(invocation.full_name, "received DOWN from aggregator");
+        err = msg.reason ? std::move(msg.reason)
+                         : make_error(ec::unspecified,
+                                      "aggregator terminated without result");
+        stop = true;
+      },
+      [&](caf::error& e) {
+        err = std::move(e);
+        stop = true;
+      },
+      [&](system::signal_atom, int signal) {
+        VAST_DEBUG(invocation.full_name, "got " << ::strsignal(signal));
+        if (signal == SIGINT || signal == SIGTERM)
+          self->send_exit(agg, exit_reason::user_shutdown);
+      })
+    .until([&] { return stop; });
+  if (err)
+    return caf::make_message(std::move(err));
+  // Print one tab-separated line per group, preceded by a header.
+  auto sep = "";
+  for (auto& key : result.group_by()) {
+    std::cout << sep << key;
+    sep = "\t";
+  }
+  for (auto& x : result.aggregates()) {
+    std::cout << sep << to_string(x);
+    sep = "\t";
+  }
+  std::cout << '\n';
+  for (auto& [key, values] : result.groups()) {
+    sep = "";
+    for (auto& x : key) {
+      std::cout << sep << to_string(x);
+      sep = "\t";
+    }
+    for (auto& x : values) {
+      std::cout << sep << to_string(x);
+      sep = "\t";
+    }
+    std::cout << '\n';
+  }
+  std::cout << std::flush;
+  return caf::none;
+}
+
+} // namespace vast::system
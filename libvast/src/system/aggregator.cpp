@@ -0,0 +1,97 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+#include "vast/system/aggregator.hpp"
+
+#include "vast/logger.hpp"
+
+#include <caf/event_based_actor.hpp>
+
+namespace vast::system {
+
+aggregator_state::aggregator_state(caf::event_based_actor* self)
+  : super(self) {
+  // nop
+}
+
+void aggregator_state::init(expression expr, aggregation spec,
+                            caf::actor index, system::archive_type archive) {
+  expr_ = std::move(expr);
+  result_ = std::move(spec);
+  archive_ = std::move(archive);
+  // Transition from idle state when receiving 'run' and client handle.
+  behaviors_[idle].assign([=](system::run_atom, caf::actor client) {
+    client_ = std::move(client);
+    start(expr_, index);
+    // Stop immediately when losing the client.
+    self_->monitor(client_);
+    self_->set_down_handler([this](caf::down_msg& dm) {
+      if (dm.source == client_)
+        self_->quit(dm.reason);
+    });
+  });
+  self_->send(archive_, system::exporter_atom::value, self_);
+  caf::message_handler base{behaviors_[collect_hits].as_behavior_impl()};
+  behaviors_[collect_hits] = base.or_else(
+    [this](aggregation& partial) {
+      result_.merge(partial);
+    },
+    [this](system::done_atom, const caf::error& err) {
+      if (self_->current_sender() != archive_) {
+        VAST_WARNING(self_, "received ('done', error) from unexpected actor");
+        return;
+      }
+      // A partial aggregation is wrong, so we fail the whole run instead.
+      if (err) {
+        VAST_ERROR(self_, "failed to aggregate hits:",
+                   self_->system().render(err));
+        self_->quit(err);
+        return;
+      }
+      if (--pending_archive_requests_ == 0)
+        block_end_of_hits(false);
+    });
+}
+
+void aggregator_state::process_hits(const ids& hits) {
+  // Let the ARCHIVE aggregate the hits next to the data, such that only the
+  // groups travel back to us.
+  self_->send(archive_, hits, expr_,
+              aggregation{result_.group_by(), result_.aggregates()});
+  // Block the FSM from advancing until we got all partial aggregations.
+  if (++pending_archive_requests_ == 1)
+    block_end_of_hits(true);
+}
+
+void aggregator_state::process_end_of_hits() {
+  // Fetch more hits if the INDEX has more partitions to go through.
+  if (partitions_.received < partitions_.total) {
+    auto n = std::min(partitions_.total - partitions_.received,
+                      partitions_.scheduled);
+    request_more_hits(n);
+    return;
+  }
+  // The AGGREGATOR runs only once and ships its result as its last message.
+  self_->send(client_, std::move(result_));
+  self_->quit();
+}
+
+caf::behavior
+aggregator(caf::stateful_actor<aggregator_state>* self, expression expr,
+           aggregation spec, caf::actor index, system::archive_type archive) {
+  self->state.init(std::move(expr), std::move(spec), std::move(index),
+                   std::move(archive));
+  return self->state.behavior();
+}
+
+} // namespace vast::system
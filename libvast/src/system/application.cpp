@@ -26,6 +26,7 @@
 #include "vast/format/null.hpp"
 #include "vast/format/test.hpp"
 #include "vast/format/zeek.hpp"
+#include "vast/system/aggregate_command.hpp"
 #include "vast/system/configuration.hpp"
 #include "vast/system/count_command.hpp"
 #include "vast/system/generator_command.hpp"
@@ -81,12 +82,27 @@ auto make_root_command(std::string_view path) {
                                       "definitions"));
 }
 
+auto make_aggregate_command() {
+  return std::make_unique<command>(
+    "aggregate", "computes aggregates per group of query results",
+    documentation::vast_aggregate,
+    opts("?aggregate")
+      .add<std::vector<std::string>>("group-by,g", "keys of the fields to "
+                                                   "group by")
+      .add<std::vector<std::string>>("functions,f",
+                                     "aggregates to compute per group "
+                                     "(default: [\"count\"])")
+      .add<std::string>("read,r", "path for reading the query"));
+}
+
 auto make_count_command() {
   return std::make_unique<command>(
     "count", "count hits for a query without exporting data", "",
-    opts("?count").add<bool>("skip-candidate-checks,s",
-                             "estimate an upper bound by "
-                             "skipping candidate checks"));
+    opts("?count")
+      .add<bool>("skip-candidate-checks,s", "estimate an upper bound by "
+                                            "skipping candidate checks")
+      .add<std::string>("distinct", "count the distinct values of the field "
+                                    "with this key from the index"));
 }
 
 auto make_export_command() {
@@ -97,6 +113,10 @@ auto make_export_command() {
       .add<bool>("continuous,c", "marks a query as continuous")
       .add<bool>("unified,u", "marks a query as unified")
       .add<size_t>("max-events,n", "maximum number of results")
+      .add<std::vector<std::string>>("fields", "keys of the fields to export "
+                                               "(default: all fields)")
+      .add<std::string>("sort", "export the latest max-events results "
+                                "according to the time field with this key")
       .add<std::string>("read,r", "path for reading the query"));
   export_->add_subcommand("zeek", "exports query results in Zeek format",
                           documentation::vast_export_zeek,
@@ -262,7 +282,9 @@ auto make_spawn_command() {
     "archive", "creates a new archive", "",
     opts()
       .add<size_t>("segments,s", "number of cached segments")
-      .add<size_t>("max-segment-size,m", "maximum segment size in MB"));
+      .add<size_t>("max-segment-size,m", "maximum segment size in MB")
+      .add<std::string>("compression", "table slice compression in segments "
+                                       "(null or lz4)"));
   spawn->add_subcommand(
     "exporter", "creates a new exporter", "",
     opts()
@@ -320,6 +342,7 @@ auto make_command_factory() {
   // When updating this list, remember to update its counterpart in node.cpp as
   // well iff necessary
   return command::factory{
+    {"aggregate", aggregate_command},
     {"count", count_command},
     {"export ascii",
      writer_command<format::ascii::writer, defaults::export_::ascii>},
@@ -387,6 +410,7 @@ auto make_command_factory() {
 std::pair<std::unique_ptr<command>, command::factory>
 make_application(std::string_view path) {
   auto root = make_root_command(path);
+  root->add_subcommand(make_aggregate_command());
   root->add_subcommand(make_count_command());
   root->add_subcommand(make_export_command());
   root->add_subcommand(make_infer_command());
@@ -17,6 +17,7 @@
 #include "vast/defaults.hpp"
 #include "vast/detail/assert.hpp"
 #include "vast/detail/fill_status_map.hpp"
+#include "vast/detail/narrow.hpp"
 #include "vast/event.hpp"
 #include "vast/logger.hpp"
 #include "vast/segment_store.hpp"
@@ -29,6 +30,9 @@
 #include <caf/settings.hpp>
 
 #include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 using std::chrono::duration_cast;
 using std::chrono::microseconds;
@@ -46,18 +50,164 @@ void archive_state::send_report() {
   }
 }
 
+void archive_state::advance() {
+  // Bound the slices in flight per session by the number of workers, such
+  // that a single lookup cannot flood the workers, and respect the credit of
+  // the requester, such that a slow requester cannot get flooded by us.
+  auto i = std::find_if(sessions.begin(), sessions.end(), [&](auto& x) {
+    return !x.exhausted && x.in_flight < workers.size() && has_credit(x);
+  });
+  if (i == sessions.end()) {
+    // Completing workers and new credit resume advancing.
+    advancing = false;
+    return;
+  }
+  auto x = std::move(*i);
+  sessions.erase(i);
+  auto read = x.lookup->next_reader();
+  if (!read) {
+    x.exhausted = true;
+    // Either we are done or an error occured. A failed worker may have
+    // already recorded an error.
+    if (!x.error)
+      x.error = std::move(read.error());
+  } else {
+    dispatch(x, std::move(*read));
+  }
+  // Give the other lookups a turn.
+  if (!try_complete(x))
+    sessions.push_back(std::move(x));
+  advancing = !sessions.empty();
+  if (advancing)
+    self->send(self, extract_atom::value);
+}
+
+void archive_state::dispatch(session& x, store::lookup::reader read) {
+  VAST_ASSERT(!workers.empty());
+  auto& worker = workers[next_worker++ % workers.size()];
+  auto id = x.id;
+  auto on_error = [=](caf::error& err) {
+    VAST_ERROR(self, "failed to process table slice:",
+               self->system().render(err));
+    // Fail the lookup with the first error and stop extracting more slices
+    // for it.
+    if (auto session = find_session(id)) {
+      if (!session->error)
+        session->error = std::move(err);
+      session->exhausted = true;
+    }
+    finish_slice(id);
+  };
+  ++x.in_flight;
+  if (x.partial) {
+    auto partial = aggregation{x.partial->group_by(), x.partial->aggregates()};
+    self
+      ->request(worker, caf::infinite, std::move(read), x.xs, x.expr,
+                std::move(partial))
+      .then(
+        [=](aggregation& y) {
+          if (auto session = find_session(id))
+            session->partial->merge(y);
+          finish_slice(id);
+        },
+        on_error);
+  } else if (!x.fields.empty()) {
+    self
+      ->request(worker, caf::infinite, std::move(read), x.xs, x.fields,
+                x.requester)
+      .then(
+        [=, requester = x.requester.address()](uint64_t rows) {
+          consume_credit(requester, rows);
+          finish_slice(id);
+        },
+        on_error);
+  } else {
+    self->request(worker, caf::infinite, std::move(read), x.xs, x.requester)
+      .then(
+        [=, requester = x.requester.address()](uint64_t rows) {
+          consume_credit(requester, rows);
+          finish_slice(id);
+        },
+        on_error);
+  }
+}
+
+void archive_state::consume_credit(const caf::actor_addr& requester,
+                                   uint64_t rows) {
+  auto i = credit.find(requester);
+  if (i != credit.end())
+    i->second -= detail::narrow_cast<int64_t>(rows);
+}
+
+bool archive_state::has_credit(const session& x) const {
+  // Aggregations ship no table slices.
+  if (x.partial)
+    return true;
+  auto i = credit.find(x.requester.address());
+  return i == credit.end() || i->second > 0;
+}
+
+void archive_state::finish_slice(uint64_t id) {
+  auto i = std::find_if(sessions.begin(), sessions.end(),
+                        [&](auto& x) { return x.id == id; });
+  // The session is gone if its requester terminated.
+  if (i == sessions.end())
+    return;
+  VAST_ASSERT(i->in_flight > 0);
+  --i->in_flight;
+  if (try_complete(*i))
+    sessions.erase(i);
+  else if (!advancing) {
+    advancing = true;
+    self->send(self, extract_atom::value);
+  }
+}
+
+bool archive_state::try_complete(session& x) {
+  if (!x.exhausted || x.in_flight > 0)
+    return false;
+  // Ship the partial aggregation ahead of the response, which the requester
+  // thus receives last. A failed lookup has no meaningful aggregation.
+  if (x.partial && !x.error)
+    self->send(caf::actor_cast<caf::actor>(x.requester), std::move(*x.partial));
+  if (!x.error)
+    x.promise.deliver(done_atom::value, make_error(ec::no_error));
+  else
+    x.promise.deliver(done_atom::value, std::move(x.error));
+  return true;
+}
+
+archive_state::session* archive_state::find_session(uint64_t id) {
+  auto i = std::find_if(sessions.begin(), sessions.end(),
+                        [&](auto& x) { return x.id == id; });
+  return i != sessions.end() ? &*i : nullptr;
+}
+
 archive_type::behavior_type
 archive(archive_type::stateful_pointer<archive_state> self, path dir,
-        size_t capacity, size_t max_segment_size) {
+        size_t capacity, size_t max_segment_size, compression method) {
   // TODO: make the choice of store configurable. For most flexibility, it
   // probably makes sense to pass a unique_ptr<stor> directory to the spawn
   // arguments of the actor. This way, users can provide their own store
   // implementation conveniently.
   VAST_DEBUG(self, "spawned:", VAST_ARG(capacity), VAST_ARG(max_segment_size));
   self->state.self = self;
-  self->state.store = segment_store::make(dir, max_segment_size, capacity);
+  namespace defs = defaults::system;
+  auto columnar = get_or(self->system().config(), "system.columnar-segments",
+                         defs::columnar_segments);
+  self->state.store = segment_store::make(dir, max_segment_size, capacity,
+                                          method, columnar);
   VAST_ASSERT(self->state.store != nullptr);
+  auto num_workers = get_or(self->system().config(), "system.archive-workers",
+                            defs::archive_workers);
+  for (size_t i = 0; i < std::max(num_workers, size_t{1}); ++i)
+    self->state.workers.push_back(self->spawn(archive_worker));
+  self->state.compaction_threshold
+    = get_or(self->system().config(), "system.compaction-threshold",
+             defs::compaction_threshold);
   self->set_exit_handler([=](const exit_msg& msg) {
+    for (auto& worker : self->state.workers)
+      self->send_exit(worker, msg.reason);
     self->state.send_report();
     self->state.store->flush();
     self->state.store.reset();
@@ -65,43 +215,67 @@ archive(archive_type::stateful_pointer<archive_state> self, path dir,
   });
   self->set_down_handler([=](const down_msg& msg) {
     VAST_DEBUG(self, "received DOWN from", msg.source);
-    self->state.active_exporters.erase(msg.source);
+    auto& st = self->state;
+    st.active_exporters.erase(msg.source);
+    st.credit.erase(msg.source);
+    // Abandon all lookups of the terminated exporter.
+    auto i = std::remove_if(st.sessions.begin(), st.sessions.end(),
+                            [&](auto& x) {
+                              return x.requester.address() == msg.source;
+                            });
+    st.sessions.erase(i, st.sessions.end());
   });
   if (auto a = self->system().registry().get(accountant_atom::value)) {
-    namespace defs = defaults::system;
     self->state.accountant = actor_cast<accountant_type>(a);
     self->send(self->state.accountant, announce_atom::value, self->name());
     self->delayed_send(self, defs::telemetry_rate, telemetry_atom::value);
   }
+  // Starts a lookup for a set of IDs. The session either projects the
+  // resulting table slices onto its fields, if any, or aggregates them.
+  auto lookup = [=](const ids& xs, archive_state::session x)
+    -> caf::result<done_atom, caf::error> {
+    auto& st = self->state;
+    VAST_ASSERT(rank(xs) > 0);
+    VAST_DEBUG(self, "got query for", rank(xs),
+               "events in range [" << select(xs, 1) << ','
+                                   << (select(xs, -1) + 1) << ')');
+    if (st.active_exporters.count(self->current_sender()->address()) == 0) {
+      VAST_DEBUG(self, "dismisses query for inactive sender");
+      return make_error(ec::no_error);
+    }
+    x.requester = caf::actor_cast<archive_state::receiver_type>(
+      self->current_sender());
+    x.id = st.next_session_id++;
+    x.promise = self->make_response_promise<done_atom, caf::error>();
+    x.xs = xs;
+    x.lookup = st.store->extract(xs, x.expr, x.fields);
+    auto promise = x.promise;
+    st.sessions.push_back(std::move(x));
+    if (!st.advancing) {
+      st.advancing = true;
+      self->send(self, extract_atom::value);
+    }
+    VAST_DEBUG(self, "has", st.sessions.size(), "lookups in progress");
+    return promise;
+  };
   return {[=](const ids& xs) -> caf::result<done_atom, caf::error> {
-            VAST_ASSERT(rank(xs) > 0);
-            VAST_DEBUG(self, "got query for", rank(xs),
-                       "events in range [" << select(xs, 1) << ','
-                                           << (select(xs, -1) + 1) << ')');
-            if (self->state.active_exporters.count(
-                  self->current_sender()->address())
-                == 0) {
-              VAST_DEBUG(self, "dismisses query for inactive sender");
-              return make_error(ec::no_error);
-            }
-            using receiver_type = caf::typed_actor<
-              caf::reacts_to<table_slice_ptr>>;
-            auto requester = caf::actor_cast<receiver_type>(
-              self->current_sender());
-            auto session = self->state.store->extract(xs);
-            while (true) {
-              auto slice = session->next();
-              if (!slice) {
-                if (!slice.error()) // Either we are done ...
-                  break;
-                // ... or an error occured.
-                return {done_atom::value, std::move(slice.error())};
-              }
-              // The slice may contain entries that are not selected by xs.
-              for (auto& sub_slice : select(*slice, xs))
-                self->send(requester, sub_slice);
-            }
-            return {done_atom::value, make_error(ec::no_error)};
+            return lookup(xs, {});
+          },
+          [=](const ids& xs, std::vector<std::string>& fields)
+            -> caf::result<done_atom, caf::error> {
+            archive_state::session x;
+            x.fields = std::move(fields);
+            return lookup(xs, std::move(x));
+          },
+          [=](const ids& xs, expression& expr, aggregation& partial)
+            -> caf::result<done_atom, caf::error> {
+            archive_state::session x;
+            x.expr = std::move(expr);
+            x.partial = std::move(partial);
+            return lookup(xs, std::move(x));
+          },
+          [=](extract_atom) {
+            self->state.advance();
           },
           [=](stream<table_slice_ptr> in) {
             self->make_sink(
@@ -136,9 +310,20 @@ archive(archive_type::stateful_pointer<archive_state> self, path dir,
             self->state.active_exporters.insert(sender_addr);
             self->monitor<caf::message_priority::high>(exporter);
           },
+          [=](credit_atom, uint64_t rows) {
+            auto& st = self->state;
+            auto sender_addr = self->current_sender()->address();
+            st.credit[sender_addr] += detail::narrow_cast<int64_t>(rows);
+            if (!st.advancing && !st.sessions.empty()) {
+              st.advancing = true;
+              self->send(self, extract_atom::value);
+            }
+          },
           [=](status_atom) {
             caf::dictionary<caf::config_value> result;
             detail::fill_status_map(result, self);
+            put(result, "lookups", self->state.sessions.size());
+            put(result, "workers", self->state.workers.size());
             self->state.store->inspect_status(put_dictionary(result, "store"));
             return result;
           },
@@ -149,9 +334,25 @@ archive(archive_type::stateful_pointer<archive_state> self, path dir,
                                telemetry_atom::value);
           },
           [=](erase_atom, const ids& xs) {
-            if (auto err = self->state.store->erase(xs))
+            auto& st = self->state;
+            if (auto err = st.store->erase(xs))
               VAST_ERROR(self,
                          "failed to erase events:", self->system().render(err));
+            // Compact segments in between other requests.
+            if (st.compaction_threshold > 0 && !st.compacting) {
+              st.compacting = true;
+              self->send(self, compact_atom::value);
+            }
+          },
+          [=](compact_atom) {
+            auto& st = self->state;
+            auto more = st.store->compact(st.compaction_threshold);
+            if (!more)
+              VAST_ERROR(self, "failed to compact segments:",
+                         self->system().render(more.error()));
+            st.compacting = more && *more;
+            if (st.compacting)
+              self->send(self, compact_atom::value);
           }};
 }
 
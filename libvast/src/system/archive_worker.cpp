@@ -0,0 +1,97 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+#include "vast/system/archive_worker.hpp"
+
+#include "vast/table_slice.hpp"
+
+namespace vast::system {
+
+namespace {
+
+// Reads the table slices of a part of a lookup, and decodes them here
+// rather than on first access, which cannot report corrupt data.
+caf::expected<std::vector<table_slice_ptr>>
+read_slices(const store::lookup::reader& f) {
+  auto slices = f();
+  if (!slices)
+    return slices.error();
+  for (auto& slice : *slices)
+    if (auto err = slice->decode())
+      return err;
+  return slices;
+}
+
+} // namespace
+
+archive_worker_type::behavior_type archive_worker(
+  archive_worker_type::stateful_pointer<archive_worker_state> self) {
+  return {[=](store::lookup::reader& f, const ids& xs,
+              table_slice_receiver_type& receiver) -> caf::result<uint64_t> {
+            auto slices = read_slices(f);
+            if (!slices)
+              return slices.error();
+            // The slices may contain entries that are not selected by xs.
+            uint64_t rows = 0;
+            for (auto& slice : *slices)
+              for (auto& sub_slice : select(slice, xs)) {
+                rows += sub_slice->rows();
+                self->send(receiver, std::move(sub_slice));
+              }
+            return rows;
+          },
+          [=](store::lookup::reader& f, const ids& xs,
+              const std::vector<std::string>& fields,
+              table_slice_receiver_type& receiver) -> caf::result<uint64_t> {
+            auto slices = read_slices(f);
+            if (!slices)
+              return slices.error();
+            uint64_t rows = 0;
+            for (auto& slice : *slices) {
+              auto columns = resolve_columns(slice->layout(), fields);
+              if (columns.empty())
+                continue;
+              for (auto& sub_slice : select(slice, xs))
+                if (auto projection = project(sub_slice, columns)) {
+                  rows += projection->rows();
+                  self->send(receiver, std::move(projection));
+                }
+            }
+            return rows;
+          },
+          [=](store::lookup::reader& f, const ids& xs, const expression& expr,
+              aggregation& partial) -> caf::result<aggregation> {
+            auto slices = read_slices(f);
+            if (!slices)
+              return slices.error();
+            auto& st = self->state;
+            for (auto& slice : *slices) {
+              auto& layout = slice->interned_layout();
+              if (layout != st.layout || expr != st.expr) {
+                auto program = compiled_expression::make(expr, slice->layout());
+                if (!program)
+                  return program.error();
+                st.expr = expr;
+                st.layout = layout;
+                st.checker = program->residual();
+              }
+              // All rows of the lookup are index hits, which only need to
+              // satisfy the predicates that the value indexes may answer
+              // with false positives.
+              partial.add(*slice, st.checker(*slice, xs));
+            }
+            return std::move(partial);
+          }};
+}
+
+} // namespace vast::system
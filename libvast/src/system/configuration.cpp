@@ -77,7 +77,16 @@ configuration::configuration() {
 #endif
   opt_group{custom_options_, "system"}
     .add<size_t>("table-slice-size",
-                 "maximum size for sources that generate table slices");
+                 "maximum size for sources that generate table slices")
+    .add<size_t>("archive-workers",
+                 "number of workers for processing ARCHIVE lookups")
+    .add<bool>("columnar-segments",
+               "store table slices column by column in ARCHIVE segments")
+    .add<double>("compaction-threshold",
+                 "fraction of erased events for compacting ARCHIVE segments "
+                 "(0 disables compaction)")
+    .add<std::string>("retention",
+                      "maximum age of events, e.g., 90d (disabled if empty)");
   initialize_factories<synopsis, table_slice, table_slice_builder,
                        value_index>();
 #ifdef VAST_HAVE_ARROW
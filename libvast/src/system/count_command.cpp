@@ -13,8 +13,11 @@
 
 #include "vast/system/count_command.hpp"
 
+#include "vast/aliases.hpp"
 #include "vast/concept/parseable/to.hpp"
 #include "vast/concept/parseable/vast/expression.hpp"
+#include "vast/concept/printable/to_string.hpp"
+#include "vast/concept/printable/vast/data.hpp"
 #include "vast/defaults.hpp"
 #include "vast/error.hpp"
 #include "vast/logger.hpp"
@@ -80,13 +83,22 @@ count_command(const command::invocation& invocation, caf::actor_system& sys) {
   self->send(cnt, system::run_atom::value, self);
   bool counting = true;
   uint64_t result = 0;
+  value_counts distinct;
   self->receive_while
     // Loop until false.
     (counting)
     // Message handlers.
     ([&](uint64_t x) { result += x; },
+     [&](value_counts& xs) { distinct = std::move(xs); },
      [&](system::done_atom) { counting = false; });
-  std::cout << result << std::endl;
+  if (caf::get_if<std::string>(&options, "count.distinct")) {
+    // Print one line per distinct value with its number of occurrences.
+    for (auto& [x, n] : distinct)
+      std::cout << to_string(x) << '\t' << n << '\n';
+    std::cout << std::flush;
+  } else {
+    std::cout << result << std::endl;
+  }
   return caf::none;
 }
 
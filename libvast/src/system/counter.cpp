@@ -13,11 +13,11 @@
 
 #include "vast/system/counter.hpp"
 
-#include "vast/event.hpp"
-#include "vast/expression_visitors.hpp"
+#include "vast/aliases.hpp"
+#include "vast/bitmap_algorithms.hpp"
+#include "vast/data.hpp"
 #include "vast/logger.hpp"
 #include "vast/table_slice.hpp"
-#include "vast/to_events.hpp"
 
 #include <caf/event_based_actor.hpp>
 
@@ -29,10 +29,31 @@ counter_state::counter_state(caf::event_based_actor* self) : super(self) {
 
 void counter_state::init(expression expr, caf::actor index,
                          system::archive_type archive,
-                         bool skip_candidate_check) {
+                         bool skip_candidate_check, std::string distinct_key) {
   skip_candidate_check_ = skip_candidate_check;
   expr_ = std::move(expr);
   archive_ = std::move(archive);
+  // Counting distinct values bypasses the regular query processing.
+  if (!distinct_key.empty()) {
+    behaviors_[idle].assign([=](system::run_atom, caf::actor client) {
+      client_ = std::move(client);
+      self_->request(index, caf::infinite, system::distinct_atom::value, expr_,
+                     distinct_key)
+        .then(
+          [this](value_counts& xs) {
+            self_->send(client_, std::move(xs));
+            self_->send(client_, system::done_atom::value);
+            self_->quit();
+          },
+          [this](caf::error& err) {
+            VAST_ERROR(self_, "failed to count distinct values:",
+                       self_->system().render(err));
+            self_->send(client_, system::done_atom::value);
+            self_->quit(std::move(err));
+          });
+    });
+    return;
+  }
   // Transition from idle state when receiving 'run' and client handle.
   behaviors_[idle].assign([=](system::run_atom, caf::actor client) {
     client_ = std::move(client);
@@ -52,24 +73,23 @@ void counter_state::init(expression expr, caf::actor index,
   behaviors_[collect_hits] = base.or_else(
     [this](table_slice_ptr slice) {
       // Construct a candidate checker if we don't have one for this type.
-      auto& checker = checkers_[slice->layout()];
-      if (caf::holds_alternative<caf::none_t>(checker)) {
-        if (auto x = tailor(expr_, slice->layout())) {
-          checker = std::move(*x);
-        } else {
+      auto& layout = slice->interned_layout();
+      auto checker = checkers_.find(layout);
+      if (checker == checkers_.end()) {
+        auto x = compiled_expression::make(expr_, slice->layout());
+        if (!x) {
           VAST_ERROR(self_, "failed to tailor expression:",
                      self_->system().render(x.error()));
           return;
         }
+        // All rows we check are index hits, which only need to satisfy the
+        // predicates that the value indexes may answer with false positives.
+        checker = checkers_.emplace(layout, x->residual()).first;
       }
-      // Performance candidate checks for all selected rows.
-      uint64_t num_hits = 0;
-      auto candidates = to_events(*slice, hits_);
-      for (auto& candidate : candidates)
-        if (caf::visit(event_evaluator{candidate}, checker))
-          ++num_hits;
+      // Perform candidate checks for all selected rows.
+      auto num_hits = rank(checker->second(*slice, hits_));
       if (num_hits > 0)
-        self_->send(client_, num_hits);
+        self_->send(client_, static_cast<uint64_t>(num_hits));
     },
     [this](system::done_atom, const caf::error&) {
       if (self_->current_sender() != archive_) {
@@ -109,9 +129,9 @@ void counter_state::process_end_of_hits() {
 
 caf::behavior counter(caf::stateful_actor<counter_state>* self, expression expr,
                       caf::actor index, system::archive_type archive,
-                      bool skip_candidate_check) {
+                      bool skip_candidate_check, std::string distinct_key) {
   self->state.init(std::move(expr), std::move(index), std::move(archive),
-                   skip_candidate_check);
+                   skip_candidate_check, std::move(distinct_key));
   return self->state.behavior();
 }
 
@@ -0,0 +1,133 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+#include "vast/system/enumerator.hpp"
+
+#include <algorithm>
+
+#include <caf/event_based_actor.hpp>
+#include <caf/stateful_actor.hpp>
+
+#include "vast/bitmap_algorithms.hpp"
+#include "vast/detail/assert.hpp"
+#include "vast/logger.hpp"
+#include "vast/system/atoms.hpp"
+
+namespace vast::system {
+
+namespace {
+
+using enumerator_actor = caf::stateful_actor<enumerator_state>;
+
+void finish(enumerator_actor* self) {
+  self->state.promise.deliver(std::move(self->state.result));
+  self->quit();
+}
+
+void fail(enumerator_actor* self, caf::error err) {
+  VAST_WARNING(self, "failed to count values:", self->system().render(err));
+  self->state.promise.deliver(std::move(err));
+  self->quit();
+}
+
+void next_batch(enumerator_actor* self);
+
+void count_values(enumerator_actor* self,
+                  const std::vector<caf::actor>& indexers) {
+  auto& st = self->state;
+  if (indexers.empty() || all<0>(st.hits)) {
+    next_batch(self);
+    return;
+  }
+  VAST_DEBUG(self, "asks", indexers.size(), "INDEXER actor(s) to count",
+             rank(st.hits), "hits");
+  st.pending = indexers.size();
+  for (auto& indexer : indexers)
+    self->request(indexer, caf::infinite, distinct_atom::value, st.hits)
+      .then(
+        [=](value_counts& xs) {
+          auto& result = self->state.result;
+          for (auto& [x, n] : xs)
+            result[x] += n;
+          if (--self->state.pending == 0)
+            next_batch(self);
+        },
+        [=](const caf::error& err) { fail(self, err); });
+}
+
+void evaluate(enumerator_actor* self, std::vector<caf::actor> evaluators,
+              std::vector<caf::actor> indexers) {
+  auto& st = self->state;
+  if (evaluators.empty()) {
+    next_batch(self);
+    return;
+  }
+  st.hits = {};
+  st.pending = evaluators.size();
+  // The EVALUATOR actors send their hits to us before responding.
+  auto client = caf::actor_cast<caf::actor>(self);
+  for (auto& evaluator : evaluators)
+    self->request(evaluator, caf::infinite, client)
+      .then(
+        [=](done_atom) {
+          if (--self->state.pending == 0)
+            count_values(self, indexers);
+        },
+        [=](const caf::error& err) { fail(self, err); });
+}
+
+void next_batch(enumerator_actor* self) {
+  auto& st = self->state;
+  if (st.partitions.empty()) {
+    finish(self);
+    return;
+  }
+  auto n = std::min(st.batch_size, st.partitions.size());
+  std::vector<uuid> batch(st.partitions.begin(), st.partitions.begin() + n);
+  st.partitions.erase(st.partitions.begin(), st.partitions.begin() + n);
+  VAST_DEBUG(self, "enumerates", st.key, "in", n, "partition(s) with",
+             st.partitions.size(), "remaining");
+  self->request(st.index, caf::infinite, distinct_atom::value, st.expr,
+                std::move(batch), st.key)
+    .then(
+      [=](std::vector<caf::actor>& evaluators,
+          std::vector<caf::actor>& indexers) {
+        evaluate(self, std::move(evaluators), std::move(indexers));
+      },
+      [=](const caf::error& err) { fail(self, err); });
+}
+
+} // namespace
+
+caf::behavior enumerator(caf::stateful_actor<enumerator_state>* self,
+                         caf::actor index, expression expr, std::string key,
+                         std::vector<uuid> partitions, size_t batch_size) {
+  VAST_ASSERT(batch_size > 0);
+  auto& st = self->state;
+  st.index = std::move(index);
+  st.expr = std::move(expr);
+  st.key = std::move(key);
+  st.partitions = std::move(partitions);
+  st.batch_size = batch_size;
+  return {
+    [=](run_atom) -> caf::result<value_counts> {
+      auto& st = self->state;
+      st.promise = self->make_response_promise<value_counts>();
+      next_batch(self);
+      return st.promise;
+    },
+    [=](const ids& hits) { self->state.hits |= hits; },
+  };
+}
+
+} // namespace vast::system
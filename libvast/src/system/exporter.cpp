@@ -19,6 +19,7 @@
 #include "vast/concept/printable/vast/event.hpp"
 #include "vast/concept/printable/vast/expression.hpp"
 #include "vast/concept/printable/vast/uuid.hpp"
+#include "vast/defaults.hpp"
 #include "vast/detail/assert.hpp"
 #include "vast/detail/fill_status_map.hpp"
 #include "vast/detail/narrow.hpp"
@@ -33,6 +34,9 @@
 
 #include <caf/all.hpp>
 
+#include <algorithm>
+#include <type_traits>
+
 using namespace std::chrono;
 using namespace std::string_literals;
 using namespace caf;
@@ -42,6 +46,67 @@ namespace system {
 
 namespace {
 
+// Collects the keys of all fields that a candidate check may need. Returns
+// false if the check needs fields that keys cannot name, e.g., for type
+// extractors.
+struct key_collector {
+  bool operator()(caf::none_t) {
+    return true;
+  }
+
+  bool operator()(const conjunction& xs) {
+    return std::all_of(xs.begin(), xs.end(),
+                       [&](auto& x) { return caf::visit(*this, x); });
+  }
+
+  bool operator()(const disjunction& xs) {
+    return std::all_of(xs.begin(), xs.end(),
+                       [&](auto& x) { return caf::visit(*this, x); });
+  }
+
+  bool operator()(const negation& x) {
+    return caf::visit(*this, x.expr());
+  }
+
+  bool operator()(const predicate& x) {
+    return caf::visit(*this, x.lhs) && caf::visit(*this, x.rhs);
+  }
+
+  bool operator()(const attribute_extractor& x) {
+    return x.attr == type_atom::get_value();
+  }
+
+  bool operator()(const key_extractor& x) {
+    keys.push_back(x.key);
+    return true;
+  }
+
+  template <class T>
+  bool operator()(const T&) {
+    return std::is_same_v<T, data>;
+  }
+
+  std::vector<std::string>& keys;
+};
+
+// Grants the ARCHIVE credit for more rows while the results that wait for
+// the SINK stay below the credit window. This bounds the memory of a
+// historical query regardless of its selectivity.
+void grant_credit(stateful_actor<exporter_state>* self) {
+  auto& st = self->state;
+  if (!st.archive || !has_historical_option(st.options))
+    return;
+  auto window = detail::narrow_cast<int64_t>(defaults::system::archive_credit);
+  if (detail::narrow_cast<int64_t>(st.query.cached) >= window)
+    return;
+  // Replenish in bulk once the ARCHIVE used up half of the window.
+  if (st.archive_credit > window / 2)
+    return;
+  auto n = window - st.archive_credit;
+  st.archive_credit = window;
+  self->send(st.archive, credit_atom::value, detail::narrow_cast<uint64_t>(n));
+}
+
 void ship_results(stateful_actor<exporter_state>* self) {
   VAST_TRACE("");
   auto& st = self->state;
@@ -69,6 +134,7 @@ void ship_results(stateful_actor<exporter_state>* self) {
     st.query.shipped += rows;
     self->send(st.sink, std::move(slice));
   }
+  grant_credit(self);
 }
 
 void report_statistics(stateful_actor<exporter_state>* self) {
@@ -116,16 +182,21 @@ void request_more_hits(stateful_actor<exporter_state>* self) {
                "results and waits for client to request more");
     return;
   }
-  // Do nothing if we are still waiting for results from the ARCHIVE.
-  if (st.query.lookups_issued > st.query.lookups_complete) {
-    VAST_DEBUG(self, "currently awaits",
-               st.query.lookups_issued - st.query.lookups_complete,
+  // Do nothing if the INDEX still evaluates or prunes partitions for us.
+  if (st.query.scheduled > 0 || st.pruning) {
+    VAST_DEBUG(self, "currently awaits hits for", st.query.scheduled,
+               "partitions");
+    return;
+  }
+  // Do nothing if the ARCHIVE cannot keep up with the INDEX. Otherwise, hits
+  // would pile up in our queue.
+  auto lookups = st.query.lookups_issued - st.query.lookups_complete
+                 + st.pending_lookups.size();
+  if (lookups >= defaults::system::max_archive_lookups) {
+    VAST_DEBUG(self, "currently awaits", lookups,
                "more lookup results from the archive");
     return;
   }
-  // If the if-statement above isn't true then the two values must be equal.
-  // Otherwise, we would complete more than we issue.
-  VAST_ASSERT(st.query.lookups_issued == st.query.lookups_complete);
   // Do nothing if we received everything.
   if (st.query.received == st.query.expected) {
     VAST_DEBUG(self, "received hits for all", st.query.expected, "partitions");
@@ -147,6 +218,128 @@ void request_more_hits(stateful_actor<exporter_state>* self) {
   self->send(st.index, st.id, detail::narrow<uint32_t>(n));
 }
 
+bool finished(stateful_actor<exporter_state>* self) {
+  auto& qs = self->state.query;
+  return qs.received == qs.expected && qs.lookups_issued == qs.lookups_complete
+         && self->state.pending_lookups.empty() && !self->state.pruning;
+}
+
+// Ships the rows of a sorted export in descending order.
+void ship_top_k(stateful_actor<exporter_state>* self) {
+  auto& st = self->state;
+  if (st.sort_key.empty())
+    return;
+  std::sort_heap(st.top_k.begin(), st.top_k.end(), top_k_order{});
+  for (auto& x : st.top_k) {
+    for (auto& y : select(x.slice, make_ids({{x.row, x.row + 1}}))) {
+      if (!st.fields.empty()) {
+        auto& t = y->interned_layout();
+        auto columns = st.projections.find(t);
+        if (columns == st.projections.end()) {
+          auto xs = resolve_columns(y->layout(), st.fields);
+          columns = st.projections.emplace(t, std::move(xs)).first;
+        }
+        y = project(y, columns->second);
+      }
+      if (y != nullptr) {
+        st.query.cached += y->rows();
+        st.results.push_back(std::move(y));
+      }
+    }
+  }
+  st.top_k.clear();
+  ship_results(self);
+}
+
+// Shuts down after shipping all results once we processed all hits.
+void complete(stateful_actor<exporter_state>* self) {
+  if (!finished(self))
+    return;
+  ship_top_k(self);
+  shutdown(self);
+}
+
+// Keeps the rows with the latest points in time of a slice for a sorted
+// export.
+void collect_top_k(stateful_actor<exporter_state>* self,
+                   const table_slice_ptr& slice, const ids& selection) {
+  auto& st = self->state;
+  auto& layout = slice->layout();
+  auto& t = slice->interned_layout();
+  auto column = st.sort_columns.find(t);
+  if (column == st.sort_columns.end()) {
+    caf::optional<size_t> x;
+    for (auto col : resolve_columns(layout, {st.sort_key}))
+      if (caf::holds_alternative<time_type>(layout.fields[col].type)) {
+        x = col;
+        break;
+      }
+    if (!x)
+      VAST_WARNING(self, "cannot sort", layout.name(), "by", st.sort_key);
+    column = st.sort_columns.emplace(t, x).first;
+  }
+  if (!column->second)
+    return;
+  for (auto row : select(selection)) {
+    auto x = slice->at(row - slice->offset(), *column->second);
+    auto ts = caf::get_if<view<time>>(&x);
+    if (!ts)
+      continue;
+    if (st.top_k.size() < st.limit) {
+      st.top_k.push_back({*ts, row, slice});
+      std::push_heap(st.top_k.begin(), st.top_k.end(), top_k_order{});
+    } else if (*ts > st.top_k.front().key) {
+      std::pop_heap(st.top_k.begin(), st.top_k.end(), top_k_order{});
+      st.top_k.back() = {*ts, row, slice};
+      std::push_heap(st.top_k.begin(), st.top_k.end(), top_k_order{});
+    }
+  }
+}
+
+// Asks the INDEX to evaluate the remaining partitions of a sorted export in
+// descending order of time, skipping those that cannot contribute anymore.
+void prune_partitions(stateful_actor<exporter_state>* self) {
+  auto& st = self->state;
+  auto bound = st.top_k.size() == st.limit ? st.top_k.front().key
+                                           : time::min();
+  st.pruning = true;
+  self->request(st.index, infinite, st.id, st.sort_key, bound)
+    .then(
+      [=](uint32_t dropped) {
+        auto& st = self->state;
+        st.pruning = false;
+        VAST_DEBUG(self, "skips", dropped, "partitions");
+        VAST_ASSERT(st.query.received + dropped <= st.query.expected);
+        st.query.expected -= dropped;
+        request_more_hits(self);
+        complete(self);
+      },
+      [=](const caf::error& err) {
+        VAST_ERROR(self, "failed to prune partitions:",
+                   self->system().render(err));
+        self->state.pruning = false;
+        request_more_hits(self);
+        complete(self);
+      });
+}
+
+// Sends queued hits to the ARCHIVE while we have free lookup slots.
+void issue_lookups(stateful_actor<exporter_state>* self) {
+  auto& st = self->state;
+  while (!st.pending_lookups.empty()
+         && st.query.lookups_issued - st.query.lookups_complete
+              < defaults::system::max_archive_lookups) {
+    VAST_DEBUG(self, "forwards hits to archive");
+    ++st.query.lookups_issued;
+    auto hits = std::move(st.pending_lookups.front());
+    st.pending_lookups.pop_front();
+    if (st.archive_fields.empty())
+      self->send(st.archive, std::move(hits));
+    else
+      self->send(st.archive, std::move(hits), st.archive_fields);
+  }
+}
+
 } // namespace <anonymous>
 
 caf::settings exporter_state::status() {
@@ -155,17 +348,34 @@ caf::settings exporter_state::status() {
   put(result, "start", caf::deep_to_string(start));
   put(result, "id", to_string(id));
   put(result, "expression", to_string(expr));
+  // The number of items in each stage of the query pipeline.
+  auto& depths = put_dictionary(result, "queue-depths");
+  put(depths, "index", query.scheduled);
+  put(depths, "archive-pending", pending_lookups.size());
+  put(depths, "archive-in-flight",
+      query.lookups_issued - query.lookups_complete);
+  put(depths, "sink", query.cached);
+  put(result, "archive-credit", archive_credit);
   return result;
 }
 
 behavior exporter(stateful_actor<exporter_state>* self, expression expr,
-                  query_options options) {
+                  query_options options, std::vector<std::string> fields) {
   if (auto a = self->system().registry().get(accountant_atom::value)) {
     self->state.accountant = actor_cast<accountant_type>(a);
     self->send(self->state.accountant, announce_atom::value, self->name());
   }
   self->state.options = options;
   self->state.expr = std::move(expr);
+  self->state.fields = std::move(fields);
+  // Push the projection down to the ARCHIVE, unless the candidate check needs
+  // fields that we cannot name.
+  if (!self->state.fields.empty()) {
+    auto keys = self->state.fields;
+    if (caf::visit(key_collector{keys}, self->state.expr))
+      self->state.archive_fields = std::move(keys);
+    VAST_DEBUG(self, "projects onto", self->state.fields.size(), "fields");
+  }
   if (has_continuous_option(options))
     VAST_DEBUG(self, "has continuous query option");
   self->set_exit_handler(
@@ -188,20 +398,18 @@ behavior exporter(stateful_actor<exporter_state>* self, expression expr,
         report_statistics(self);
     }
   );
-  auto finished = [](const query_status& qs) -> bool {
-    return qs.received == qs.expected
-           && qs.lookups_issued == qs.lookups_complete;
-  };
-  auto handle_batch = [=](table_slice_ptr slice) {
+  // Slices from the ARCHIVE only contain candidates for index hits, whereas
+  // continuous queries receive all slices without consulting the INDEX.
+  auto handle_batch = [=](table_slice_ptr slice, bool historical) {
     VAST_ASSERT(slice != nullptr);
     auto& st = self->state;
     VAST_DEBUG(self, "got batch of", slice->rows(), "events");
     auto sender = self->current_sender();
     // Construct a candidate checker if we don't have one for this type.
-    type t = slice->layout();
-    auto& checker = st.checkers[t];
-    if (caf::holds_alternative<caf::none_t>(checker)) {
-      auto x = tailor(st.expr, t);
+    auto& t = slice->interned_layout();
+    auto checker = st.checkers.find(t);
+    if (checker == st.checkers.end()) {
+      auto x = compiled_expression::make(st.expr, slice->layout());
       if (!x) {
         VAST_ERROR(self, "failed to tailor expression:",
                    self->system().render(x.error()));
@@ -209,18 +417,50 @@ behavior exporter(stateful_actor<exporter_state>* self, expression expr,
         shutdown(self);
         return;
       }
-      checker = std::move(*x);
-      VAST_DEBUG(self, "tailored AST to", t, ':', checker);
+      VAST_DEBUG(self, "tailored AST to", t, ':', x->expr());
+      checker = st.checkers.emplace(t, std::move(*x)).first;
     }
     // Perform candidate check, splitting the slice into subsets if needed.
-    auto selection = evaluate(*slice, checker);
+    // Index hits need to satisfy the residual only, i.e., the predicates for
+    // which the value indexes may have false positives.
+    ids selection;
+    if (historical) {
+      auto residual = st.residuals.find(t);
+      if (residual == st.residuals.end()) {
+        auto x = checker->second.residual();
+        VAST_DEBUG(self, "checks index hits for", t, "against", x.expr());
+        residual = st.residuals.emplace(t, std::move(x)).first;
+      }
+      selection = residual->second(*slice, st.hits);
+    } else {
+      selection = checker->second(*slice);
+    }
     auto selection_size = rank(selection);
     if (selection_size == 0) {
       // No rows qualify.
       return;
     }
-    st.query.cached += selection_size;
-    select(st.results, slice, selection);
+    if (!st.sort_key.empty()) {
+      // Defer shipping until we know the latest rows of all hits.
+      collect_top_k(self, slice, selection);
+    } else if (st.fields.empty()) {
+      st.query.cached += selection_size;
+      select(st.results, slice, selection);
+    } else {
+      // Ship only the projected columns.
+      auto columns = st.projections.find(t);
+      if (columns == st.projections.end()) {
+        auto xs = resolve_columns(slice->layout(), st.fields);
+        columns = st.projections.emplace(t, std::move(xs)).first;
+      }
+      if (columns->second.empty())
+        return;
+      for (auto& x : select(slice, selection))
+        if (auto y = project(x, columns->second)) {
+          st.query.cached += y->rows();
+          st.results.push_back(std::move(y));
+        }
+    }
     // Ship slices to connected SINKs.
     st.query.processed += slice->rows();
     ship_results(self);
@@ -253,42 +493,44 @@ behavior exporter(stateful_actor<exporter_state>* self, expression expr,
         VAST_DEBUG(self, "got", count, "index hits in [", (select(hits, 1)),
                    ',', (select(hits, -1) + 1), ')');
         st.hits |= hits;
-        VAST_DEBUG(self, "forwards hits to archive");
         // FIXME: restrict according to configured limit.
-        ++st.query.lookups_issued;
-        self->send(st.archive, std::move(hits));
+        st.pending_lookups.push_back(std::move(hits));
+        issue_lookups(self);
       }
       return caf::unit;
     },
     [=](table_slice_ptr slice) {
+      self->state.archive_credit -= detail::narrow_cast<int64_t>(slice->rows());
       // Use the same handler as we use for streamed slices.
-      handle_batch(std::move(slice));
+      handle_batch(std::move(slice), true);
+      grant_credit(self);
     },
-    [=](done_atom) -> caf::result<void> {
+    [=](done_atom) {
       auto& st = self->state;
       auto& qs = st.query;
-      // Ignore this message until we got all lookup results from the ARCHIVE.
-      // Otherwise, we can end up in weirdly interleaved state.
-      if (qs.lookups_issued != qs.lookups_complete)
-        return caf::skip;
       // Figure out if we're done by bumping the counter for `received` and
-      // check whether it reaches `expected`.
+      // check whether it reaches `expected`. The lookups for the hits of this
+      // round may still be in progress, which allows the INDEX to evaluate
+      // the next partitions in the meantime.
       timespan runtime = steady_clock::now() - st.start;
       qs.runtime = runtime;
       qs.received += qs.scheduled;
+      qs.scheduled = 0;
       if (qs.received < qs.expected) {
         VAST_DEBUG(self, "received hits from", qs.received, '/', qs.expected,
                    "partitions");
-        request_more_hits(self);
+        // Skip partitions that cannot contribute to a sorted export anymore.
+        if (!st.sort_key.empty() && st.top_k.size() == st.limit)
+          prune_partitions(self);
+        else
+          request_more_hits(self);
       } else {
         VAST_DEBUG(self, "received all hits from", qs.expected,
                    "partition(s) in", vast::to_string(runtime));
         if (st.accountant)
           self->send(st.accountant, "exporter.hits.runtime", runtime);
-        if (finished(qs))
-          shutdown(self);
+        complete(self);
       }
-      return caf::unit;
     },
     [=](done_atom, [[maybe_unused]] const caf::error& err) {
       auto& st = self->state;
@@ -300,9 +542,24 @@ behavior exporter(stateful_actor<exporter_state>* self, expression expr,
       ++qs.lookups_complete;
       VAST_DEBUG(self, "received done from archive:", VAST_ARG(err),
                  VAST_ARG("query", qs));
-      // We skip 'done' messages of the query supervisors until we process all
-      // hits first. Hence, we can never be finished here.
-      VAST_ASSERT(!finished(qs));
+      // Refill the pipeline.
+      issue_lookups(self);
+      if (qs.received < qs.expected)
+        request_more_hits(self);
+      else
+        complete(self);
+    },
+    [=](limit_atom, std::string& key, uint64_t k) {
+      auto& st = self->state;
+      VAST_DEBUG(self, "keeps the", k, "latest results by", key);
+      VAST_ASSERT(k > 0);
+      // Fetch the sort key from the ARCHIVE as well if we push down a
+      // projection.
+      if (!st.archive_fields.empty())
+        st.archive_fields.push_back(key);
+      st.sort_key = std::move(key);
+      st.limit = k;
+      st.top_k.reserve(k);
     },
     [=](extract_atom) {
       auto& qs = self->state.query;
@@ -349,8 +606,10 @@ behavior exporter(stateful_actor<exporter_state>* self, expression expr,
       if (has_continuous_option(self->state.options))
         self->monitor(archive);
       // Register self at the archive
-      if (has_historical_option(self->state.options))
+      if (has_historical_option(self->state.options)) {
         self->send(archive, exporter_atom::value, self);
+        grant_credit(self);
+      }
     },
     [=](index_atom, const actor& index) {
       VAST_DEBUG(self, "registers index", index);
@@ -382,6 +641,9 @@ behavior exporter(stateful_actor<exporter_state>* self, expression expr,
           if (partitions > 0) {
             self->state.query.expected = partitions;
             self->state.query.scheduled = scheduled;
+            // Evaluate the latest partitions first for sorted exports.
+            if (!self->state.sort_key.empty() && lookup != uuid::nil())
+              prune_partitions(self);
           } else {
             shutdown(self);
           }
@@ -403,7 +665,7 @@ behavior exporter(stateful_actor<exporter_state>* self, expression expr,
           // nop
         },
         [=](caf::unit_t&, const table_slice_ptr& slice) {
-          handle_batch(slice);
+          handle_batch(slice, false);
         },
         [=](caf::unit_t&, const error& err) {
           VAST_IGNORE_UNUSED(err);
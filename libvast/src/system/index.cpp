@@ -14,6 +14,7 @@
 #include "vast/system/index.hpp"
 
 #include "vast/concept/parseable/to.hpp"
+#include "vast/concept/printable/std/chrono.hpp"
 #include "vast/concept/printable/to_string.hpp"
 #include "vast/concept/printable/vast/bitmap.hpp"
 #include "vast/concept/printable/vast/error.hpp"
@@ -33,6 +34,7 @@
 #include "vast/logger.hpp"
 #include "vast/save.hpp"
 #include "vast/system/accountant.hpp"
+#include "vast/system/enumerator.hpp"
 #include "vast/system/evaluator.hpp"
 #include "vast/system/index.hpp"
 #include "vast/system/partition.hpp"
@@ -44,9 +46,11 @@
 #include <caf/all.hpp>
 #include <caf/detail/unordered_flat_map.hpp>
 
+#include <algorithm>
 #include <chrono>
 #include <deque>
 #include <unordered_set>
+#include <utility>
 
 using namespace caf;
 using namespace std::chrono;
@@ -62,6 +66,99 @@ auto make_index_stage(index_state* st) {
   return result;
 }
 
+/// Collects the hits of multiple EVALUATOR actors into a single bitmap.
+struct hits_collector_state {
+  /// Spawns the EVALUATOR actors for a batch of partitions.
+  caf::actor index;
+
+  /// The query that selects the events.
+  expression expr;
+
+  /// The candidate partitions that we did not evaluate yet.
+  std::vector<uuid> partitions;
+
+  /// The maximum number of partitions per batch.
+  size_t batch_size;
+
+  /// Accumulates the hits of all EVALUATOR actors.
+  ids hits;
+
+  /// Stores the number of EVALUATOR actors that did not respond yet.
+  size_t pending = 0;
+
+  /// Allows us to respond to the client after collecting all hits.
+  caf::typed_response_promise<ids> promise;
+
+  /// Gives this actor a recognizable name in logging output.
+  static inline const char* name = "hits-collector";
+};
+
+using hits_collector_actor = caf::stateful_actor<hits_collector_state>;
+
+/// Requests the EVALUATOR actors for the next batch of partitions from the
+/// INDEX and runs them, or delivers the hits once no partitions remain.
+void collect_next_batch(hits_collector_actor* self) {
+  auto& st = self->state;
+  if (st.partitions.empty()) {
+    st.promise.deliver(std::move(st.hits));
+    self->quit();
+    return;
+  }
+  auto fail = [=](const caf::error& err) {
+    VAST_WARNING(self, "failed to collect hits:", self->system().render(err));
+    self->state.promise.deliver(err);
+    self->quit();
+  };
+  auto n = std::min(st.batch_size, st.partitions.size());
+  std::vector<uuid> batch(st.partitions.begin(), st.partitions.begin() + n);
+  st.partitions.erase(st.partitions.begin(), st.partitions.begin() + n);
+  self->request(st.index, caf::infinite, erase_atom::value, st.expr,
+                std::move(batch))
+    .then(
+      [=](std::vector<caf::actor>& evaluators) {
+        if (evaluators.empty()) {
+          collect_next_batch(self);
+          return;
+        }
+        self->state.pending = evaluators.size();
+        // The EVALUATOR actors send their hits to us before responding.
+        auto client = caf::actor_cast<caf::actor>(self);
+        for (auto& evaluator : evaluators)
+          self->request(evaluator, caf::infinite, client)
+            .then(
+              [=](done_atom) {
+                if (--self->state.pending == 0)
+                  collect_next_batch(self);
+              },
+              fail);
+      },
+      fail);
+}
+
+/// Runs the EVALUATOR actors for *expr* on *partitions* in batches of
+/// *batch_size* partitions and responds to a `run_atom` with the union of
+/// their hits and *init*, or with the first error.
+caf::behavior
+hits_collector(hits_collector_actor* self, caf::actor index, expression expr,
+               std::vector<uuid> partitions, size_t batch_size, ids init) {
+  VAST_ASSERT(batch_size > 0);
+  auto& st = self->state;
+  st.index = std::move(index);
+  st.expr = std::move(expr);
+  st.partitions = std::move(partitions);
+  st.batch_size = batch_size;
+  st.hits = std::move(init);
+  return {
+    [=](run_atom) -> caf::result<ids> {
+      auto& st = self->state;
+      st.promise = self->make_response_promise<ids>();
+      collect_next_batch(self);
+      return st.promise;
+    },
+    [=](const ids& hits) { self->state.hits |= hits; },
+  };
+}
+
 } // namespace
 
 partition_ptr index_state::partition_factory::operator()(const uuid& id) const {
@@ -317,6 +414,35 @@ partition* index_state::find_unpersisted(const uuid& id) {
 
 using pending_query_map = caf::detail::unordered_flat_map<uuid, evaluation_map>;
 
+partition* index_state::fetch_partition(const uuid& id) {
+  // We need to first check whether the ID is the active partition or one
+  // of our unpersistet ones. Only then can we dispatch to our LRU cache.
+  if (active != nullptr && active->id() == id)
+    return active.get();
+  if (auto ptr = find_unpersisted(id); ptr != nullptr)
+    return ptr;
+  return lru_partitions.get_or_add(id).get();
+}
+
+ids index_state::drop_partition(const uuid& id) {
+  VAST_ASSERT(active == nullptr || id != active->id());
+  VAST_ASSERT(find_unpersisted(id) == nullptr);
+  VAST_DEBUG(self, "drops partition", id);
+  auto result = lru_partitions.get_or_add(id)->row_ids();
+  auto& xs = lru_partitions.elements();
+  xs.erase(std::remove_if(xs.begin(), xs.end(),
+                          [&](auto& x) { return x->id() == id; }),
+           xs.end());
+  meta_idx.erase(id);
+  for (auto& kvp : pending) {
+    auto& ys = kvp.second.partitions;
+    ys.erase(std::remove(ys.begin(), ys.end(), id), ys.end());
+  }
+  if (auto part_dir = dir / to_string(id); exists(part_dir) && !rm(part_dir))
+    VAST_WARNING(self, "failed to remove partition directory", part_dir);
+  return result;
+}
+
 pending_query_map
 index_state::build_query_map(lookup_state& lookup, uint32_t num_partitions) {
   VAST_TRACE(VAST_ARG(lookup), VAST_ARG(num_partitions));
@@ -333,16 +459,7 @@ index_state::build_query_map(lookup_state& lookup, uint32_t num_partitions) {
   pending_query_map result;
   // Helper function to spin up EVALUATOR actors for a single partition.
   auto spin_up = [&](const uuid& partition_id) {
-    // We need to first check whether the ID is the active partition or one
-    // of our unpersistet ones. Only then can we dispatch to our LRU cache.
-    partition* part;
-    if (active != nullptr && active->id() == partition_id)
-      part = active.get();
-    else if (auto ptr = find_unpersisted(partition_id); ptr != nullptr)
-      part = ptr;
-    else
-      part = lru_partitions.get_or_add(partition_id).get();
-    auto eval = part->eval(lookup.expr);
+    auto eval = fetch_partition(partition_id)->eval(lookup.expr);
     if (eval.empty()) {
       VAST_DEBUG(self, "identified partition", partition_id,
                  "as candidate in the meta index, but it didn't produce an "
@@ -411,6 +528,88 @@ behavior index(stateful_actor<index_state>* self, const path& dir,
   // Launch workers for resolving queries.
   for (size_t i = 0; i < num_workers; ++i)
     self->spawn(query_supervisor, self);
+  // Partitions per batch of the ENUMERATOR and the HITS-COLLECTOR.
+  auto batch_size = std::max(taste_partitions, size_t{1});
+  // Counts the distinct values of a field among the hits of a query with an
+  // ENUMERATOR. Unlike regular queries, this requires no worker, because the
+  // ENUMERATOR collects the hits of the candidate partitions by itself. It
+  // requests them in batches, such that we never load all candidates at
+  // once.
+  auto distinct = [=](distinct_atom, expression& expr, std::string& key) {
+    auto candidates = self->state.meta_idx.lookup(expr);
+    VAST_DEBUG(self, "enumerates", key, "in", candidates.size(),
+               "candidate partition(s)");
+    auto hdl = self->spawn(enumerator, caf::actor_cast<caf::actor>(self),
+                           std::move(expr), std::move(key),
+                           std::move(candidates), batch_size);
+    self->delegate(hdl, run_atom::value);
+  };
+  // Spawns the EVALUATOR actors for a batch of partitions of an ENUMERATOR
+  // and responds with them and the INDEXER actors of the field.
+  auto distinct_batch
+    = [=](distinct_atom, const expression& expr,
+          const std::vector<uuid>& partitions, const std::string& key)
+    -> caf::result<std::vector<caf::actor>, std::vector<caf::actor>> {
+    auto& st = self->state;
+    std::vector<caf::actor> evaluators;
+    std::vector<caf::actor> indexers;
+    for (auto& id : partitions) {
+      auto part = st.fetch_partition(id);
+      auto xs = part->indexers(key);
+      if (xs.empty())
+        continue;
+      auto eval = part->eval(expr);
+      if (eval.empty())
+        continue;
+      evaluators.push_back(self->spawn(evaluator, expr, std::move(eval)));
+      indexers.insert(indexers.end(), xs.begin(), xs.end());
+    }
+    return {std::move(evaluators), std::move(indexers)};
+  };
+  // Drops all partitions that contain only events older than *cutoff* and
+  // responds with the IDs of all events older than *cutoff*, including those
+  // of partitions that straddle the cutoff. Like `distinct`, this requires no
+  // worker and evaluates the remaining candidates in batches.
+  auto retain = [=](erase_atom, time cutoff) {
+    auto& st = self->state;
+    auto expr = expression{predicate{attribute_extractor{timestamp_atom::value},
+                                     less, data{cutoff}}};
+    ids dropped;
+    size_t num_dropped = 0;
+    std::vector<uuid> remaining;
+    for (auto& id : st.meta_idx.lookup(expr)) {
+      auto resident = (st.active != nullptr && st.active->id() == id)
+                      || st.find_unpersisted(id) != nullptr;
+      if (auto upper = st.meta_idx.upper_bound(id);
+          !resident && upper && *upper < cutoff) {
+        dropped |= st.drop_partition(id);
+        ++num_dropped;
+        continue;
+      }
+      remaining.push_back(id);
+    }
+    VAST_DEBUG(self, "dropped", num_dropped, "partition(s) and evaluates",
+               remaining.size(), "partition(s) older than", cutoff);
+    if (num_dropped > 0)
+      st.flush_to_disk();
+    auto hdl = self->spawn(hits_collector, caf::actor_cast<caf::actor>(self),
+                           std::move(expr), std::move(remaining), batch_size,
+                           std::move(dropped));
+    self->delegate(hdl, run_atom::value);
+  };
+  // Spawns the EVALUATOR actors for a batch of partitions of a
+  // HITS-COLLECTOR.
+  auto retain_batch = [=](erase_atom, const expression& expr,
+                          const std::vector<uuid>& partitions) {
+    auto& st = self->state;
+    std::vector<caf::actor> evaluators;
+    for (auto& id : partitions) {
+      auto eval = st.fetch_partition(id)->eval(expr);
+      if (!eval.empty())
+        evaluators.push_back(self->spawn(evaluator, expr, std::move(eval)));
+    }
+    return evaluators;
+  };
   // We switch between has_worker behavior and the default behavior (which
   // simply waits for a worker).
   self->set_default_handler(caf::skip);
@@ -513,6 +712,38 @@ behavior index(stateful_actor<index_state>* self, const path& dir,
       if (iter->second.partitions.empty())
         st.pending.erase(iter);
     },
+    [=](const uuid& query_id, const std::string& key, time bound) {
+      // Orders the remaining partitions of a query by their latest point in
+      // time for *key* and drops all partitions that end before *bound*.
+      // Partitions without time bounds come last. Responds with the number
+      // of dropped partitions.
+      auto& st = self->state;
+      auto iter = st.pending.find(query_id);
+      if (iter == st.pending.end())
+        return uint32_t{0};
+      auto& partitions = iter->second.partitions;
+      std::vector<std::pair<caf::optional<time>, uuid>> xs;
+      xs.reserve(partitions.size());
+      for (auto& x : partitions)
+        if (auto upper = st.meta_idx.upper_bound(x, key);
+            !upper || *upper >= bound)
+          xs.emplace_back(upper, x);
+      auto dropped = partitions.size() - xs.size();
+      std::stable_sort(xs.begin(), xs.end(), [](auto& x, auto& y) {
+        return x.first && (!y.first || *x.first > *y.first);
+      });
+      partitions.clear();
+      for (auto& x : xs)
+        partitions.push_back(x.second);
+      VAST_DEBUG(self, "dropped", dropped, "partition(s) for query", query_id);
+      if (partitions.empty())
+        st.pending.erase(iter);
+      return detail::narrow<uint32_t>(dropped);
+    },
+    distinct,
+    distinct_batch,
+    retain,
+    retain_batch,
     [=](worker_atom, caf::actor& worker) {
       self->state.idle_workers.emplace_back(std::move(worker));
     },
@@ -534,7 +765,11 @@ behavior index(stateful_actor<index_state>* self, const path& dir,
     [=](subscribe_atom, flush_atom, actor& listener) {
       self->state.add_flush_listener(std::move(listener));
     });
-  return {[=](worker_atom, caf::actor& worker) {
+  return {distinct,
+          distinct_batch,
+          retain,
+          retain_batch,
+          [=](worker_atom, caf::actor& worker) {
             auto& st = self->state;
             st.idle_workers.emplace_back(std::move(worker));
             self->become(keep_behavior, st.has_worker);
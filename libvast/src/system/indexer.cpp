@@ -17,6 +17,7 @@
 
 #include <caf/all.hpp>
 
+#include "vast/bitmap_algorithms.hpp"
 #include "vast/concept/printable/stream.hpp"
 #include "vast/concept/printable/vast/expression.hpp"
 #include "vast/detail/assert.hpp"
@@ -78,6 +79,10 @@ behavior indexer(stateful_actor<indexer_state>* self, path dir,
       VAST_DEBUG(self, "got predicate:", pred);
       return self->state.col.lookup(pred.op, make_view(pred.rhs));
     },
+    [=](distinct_atom, const ids& selection) {
+      VAST_DEBUG(self, "counts distinct values of", rank(selection), "events");
+      return self->state.col.distinct(selection);
+    },
     [=](persist_atom) -> result<void> {
       if (auto err = self->state.col.flush_to_disk(); err != caf::none)
         return err;
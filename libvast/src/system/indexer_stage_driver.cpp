@@ -28,7 +28,7 @@ namespace vast::system {
 
 bool indexer_stage_selector::operator()(const indexer_stage_filter& f,
                                         const table_slice_ptr& x) const {
-  return f == x->layout();
+  return f == x->interned_layout();
 }
 
 indexer_stage_driver::indexer_stage_driver(downstream_manager_type& dm,
@@ -70,7 +70,7 @@ void indexer_stage_driver::process(downstream_type& out, batch_type& slices) {
               auto slt = out_.parent()
                            ->add_unchecked_outbound_path<output_type>(x);
               VAST_DEBUG(st.self, "spawned new INDEXER at slot", slt);
-              out_.set_filter(slt, layout);
+              out_.set_filter(slt, slice->interned_layout());
               st.active_partition_indexers++;
             }
           }
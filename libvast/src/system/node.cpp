@@ -13,19 +13,23 @@
 
 #include "vast/system/node.hpp"
 
+#include "vast/bitmap_algorithms.hpp"
 #include "vast/concept/parseable/to.hpp"
 #include "vast/concept/parseable/vast/endpoint.hpp"
+#include "vast/concept/printable/std/chrono.hpp"
 #include "vast/concept/printable/stream.hpp"
 #include "vast/concept/printable/to_string.hpp"
 #include "vast/concept/printable/vast/json.hpp"
 #include "vast/config.hpp"
 #include "vast/defaults.hpp"
 #include "vast/detail/assert.hpp"
+#include "vast/ids.hpp"
 #include "vast/json.hpp"
 #include "vast/logger.hpp"
 #include "vast/system/accountant.hpp"
 #include "vast/system/node.hpp"
 #include "vast/system/raft.hpp"
+#include "vast/system/spawn_aggregator.hpp"
 #include "vast/system/spawn_archive.hpp"
 #include "vast/system/spawn_arguments.hpp"
 #include "vast/system/spawn_consensus.hpp"
@@ -39,6 +43,7 @@
 #include "vast/system/spawn_profiler.hpp"
 #include "vast/system/spawn_sink.hpp"
 #include "vast/system/spawn_source.hpp"
+#include "vast/time.hpp"
 
 #include <caf/all.hpp>
 #include <caf/io/all.hpp>
@@ -248,6 +253,7 @@ node_state::component_factory_fun lift_component_factory() {
 auto make_component_factory() {
   return node_state::named_component_factory{
     {"spawn accountant", lift_component_factory<spawn_accountant>()},
+    {"spawn aggregator", lift_component_factory<spawn_aggregator>()},
     {"spawn archive", lift_component_factory<spawn_archive>()},
     {"spawn counter", lift_component_factory<spawn_counter>()},
     {"spawn exporter", lift_component_factory<spawn_exporter>()},
@@ -276,6 +282,7 @@ auto make_command_factory() {
     {"peer", peer_command},
     {"send", send_command},
     {"spawn accountant", node_state::spawn_command},
+    {"spawn aggregator", node_state::spawn_command},
     {"spawn archive", node_state::spawn_command},
     {"spawn consensus", node_state::spawn_command},
     {"spawn counter", node_state::spawn_command},
@@ -414,6 +421,32 @@ caf::behavior node(node_actor* self, std::string id, path dir) {
     [=](signal_atom, int signal) {
       VAST_IGNORE_UNUSED(signal);
       VAST_WARNING(self, "got signal", ::strsignal(signal));
+    },
+    [=](erase_atom, time cutoff) {
+      // Lets the INDEX drop all partitions older than the cutoff and forwards
+      // the IDs of all affected events to the ARCHIVE.
+      auto& st = self->state;
+      if (!st.index || !st.archive) {
+        VAST_DEBUG(self, "skips retention without INDEX and ARCHIVE");
+        return;
+      }
+      self->request(st.index, infinite, erase_atom::value, cutoff).then(
+        [=](const ids& xs) {
+          VAST_DEBUG(self, "erases", rank(xs), "events older than", cutoff);
+          if (any(xs))
+            self->send(self->state.archive, erase_atom::value, xs);
+        },
+        [=](const error& e) {
+          VAST_ERROR(self, "failed to apply retention:",
+                     self->system().render(e));
+        }
+      );
+    },
+    [=](erase_atom, duration max_age) {
+      // Applies the retention policy periodically.
+      self->send(self, erase_atom::value, caf::make_timestamp() - max_age);
+      self->delayed_send(self, defaults::system::retention_interval,
+                         erase_atom::value, max_age);
     }};
 }
 
@@ -32,6 +32,7 @@
 #include "vast/system/index.hpp"
 #include "vast/system/spawn_indexer.hpp"
 #include "vast/system/table_indexer.hpp"
+#include "vast/table_slice.hpp"
 #include "vast/time.hpp"
 
 using namespace std::chrono;
@@ -192,6 +193,24 @@ evaluation_map partition::eval(const expression& expr) {
   return result;
 }
 
+std::vector<caf::actor> partition::indexers(const std::string& key) {
+  std::vector<caf::actor> result;
+  for (auto& layout : layouts()) {
+    auto columns = resolve_columns(layout, {key});
+    if (columns.empty())
+      continue;
+    auto tbl = get_or_add(layout);
+    if (!tbl) {
+      VAST_ERROR(state_->self, "failed to initialize table_indexer for layout",
+                 layout);
+      continue;
+    }
+    if (auto& hdl = tbl->first.indexer_at(columns.front()); hdl != nullptr)
+      result.push_back(hdl);
+  }
+  return result;
+}
+
 std::vector<record_type> partition::layouts() const {
   std::vector<record_type> result;
   auto& ts = meta_data_.types;
@@ -201,6 +220,20 @@ std::vector<record_type> partition::layouts() const {
   return result;
 }
 
+ids partition::row_ids() {
+  ids result;
+  for (auto& layout : layouts()) {
+    auto tbl = get_or_add(layout);
+    if (!tbl) {
+      VAST_ERROR(state_->self, "failed to initialize table_indexer for layout",
+                 layout);
+      continue;
+    }
+    result |= tbl->first.row_ids();
+  }
+  return result;
+}
+
 path partition::base_dir() const {
   return state_->dir / to_string(id_);
 }
@@ -32,17 +32,18 @@ namespace {
 /// Returns the field that shall be used to extract values from for
 /// the pivot membership query.
 caf::optional<record_field>
-common_field(const pivoter_state& st, const record_type& indicator) {
-  auto f = st.cache.find(indicator);
+common_field(const pivoter_state& st, const type& layout) {
+  auto f = st.cache.find(layout);
   if (f != st.cache.end())
     return f->second;
+  auto& indicator = caf::get<record_type>(layout);
     // TODO: This algorithm can be enabled once we have a live updated
     //       type registry. (Switch the type of target to record_type.)
 #if 0
   for (auto& t : target.fields) {
     for (auto& i : indicator.fields) {
       if (t.name == i.name) {
-        st.cache.insert({indicator, i});
+        st.cache.insert({layout, i});
         return i;
       }
     }
@@ -63,12 +64,12 @@ common_field(const pivoter_state& st, const record_type& indicator) {
   }
   for (auto& i : indicator.fields) {
     if (i.name == edge) {
-      st.cache.insert({indicator, i});
+      st.cache.insert({layout, i});
       return i;
     }
   }
 #endif
-  st.cache.insert({indicator, caf::none});
+  st.cache.insert({layout, caf::none});
   VAST_WARNING(st.self, "got slice without shared column:", indicator.name());
   return caf::none;
 }
@@ -101,7 +102,7 @@ caf::behavior pivoter(caf::stateful_actor<pivoter_state>* self, caf::actor node,
   });
   return {[=](vast::table_slice_ptr slice) {
             auto& st = self->state;
-            auto pivot_field = common_field(st, slice->layout());
+            auto pivot_field = common_field(st, slice->interned_layout());
             if (!pivot_field)
               return;
             VAST_DEBUG(self, "uses", *pivot_field, "to extract", st.target,
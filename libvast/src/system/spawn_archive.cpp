@@ -13,7 +13,9 @@
 
 #include "vast/system/spawn_archive.hpp"
 
+#include "vast/compression.hpp"
 #include "vast/defaults.hpp"
+#include "vast/error.hpp"
 #include "vast/filesystem.hpp"
 #include "vast/si_literals.hpp"
 #include "vast/system/archive.hpp"
@@ -27,6 +29,8 @@
 #include <caf/local_actor.hpp>
 #include <caf/settings.hpp>
 
+#include <string>
+
 using namespace vast::binary_byte_literals;
 
 namespace vast::system {
@@ -39,7 +43,15 @@ maybe_actor spawn_archive(node_actor* self, spawn_arguments& args) {
   auto mss = 1_MiB
              * get_or(args.invocation.options, "max-segment-size",
                       sd::max_segment_size);
-  auto a = self->spawn(archive, args.dir / args.label, segments, mss);
+  auto method_name = get_or(args.invocation.options, "compression",
+                            std::string{sd::segment_compression});
+  auto method = compression::null;
+  if (method_name == "lz4")
+    method = compression::lz4;
+  else if (method_name != "null")
+    return make_error(ec::invalid_configuration,
+                      "invalid segment compression:", method_name);
+  auto a = self->spawn(archive, args.dir / args.label, segments, mss, method);
   self->state.archive = a;
   return caf::actor_cast<caf::actor>(a);
 }
@@ -18,8 +18,12 @@
 #include <caf/send.hpp>
 #include <caf/settings.hpp>
 
+#include <string>
+#include <vector>
+
 #include "vast/defaults.hpp"
 #include "vast/detail/unbox_var.hpp"
+#include "vast/error.hpp"
 #include "vast/logger.hpp"
 #include "vast/query_options.hpp"
 #include "vast/system/exporter.hpp"
@@ -41,10 +45,30 @@ maybe_actor spawn_exporter(node_actor* self, spawn_arguments& args) {
   // Default to historical if no options provided.
   if (query_opts == no_query_options)
     query_opts = historical;
-  auto exp = self->spawn(exporter, std::move(expr), query_opts);
+  // Parse the projection, defaulting to all fields.
+  std::vector<std::string> fields;
+  if (auto xs = caf::get_if<std::vector<std::string>>(&args.invocation.options,
+                                                      "export.fields"))
+    fields = *xs;
   // Setting max-events to 0 means infinite.
   auto max_events = get_or(args.invocation.options, "export.max-events",
                            defaults::export_::max_events);
+  // A sorted export keeps the max-events latest results.
+  auto sort_key = caf::get_if<std::string>(&args.invocation.options,
+                                           "export.sort");
+  if (sort_key) {
+    if (query_opts != historical)
+      return make_error(ec::invalid_configuration,
+                        "cannot sort continuous queries");
+    if (max_events == 0)
+      return make_error(ec::invalid_configuration,
+                        "sorting requires a limit via max-events");
+  }
+  auto exp = self->spawn(exporter, std::move(expr), query_opts,
+                         std::move(fields));
+  if (sort_key)
+    caf::anon_send(exp, limit_atom::value, *sort_key,
+                   static_cast<uint64_t>(max_events));
   if (max_events > 0)
     caf::anon_send(exp, extract_atom::value, static_cast<uint64_t>(max_events));
   else
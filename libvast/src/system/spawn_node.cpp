@@ -20,10 +20,15 @@
 #include <caf/scoped_actor.hpp>
 #include <caf/settings.hpp>
 
+#include "vast/concept/parseable/to.hpp"
+#include "vast/concept/parseable/vast/time.hpp"
 #include "vast/defaults.hpp"
+#include "vast/error.hpp"
 #include "vast/logger.hpp"
 #include "vast/scope_linked.hpp"
+#include "vast/system/atoms.hpp"
 #include "vast/system/node.hpp"
+#include "vast/time.hpp"
 
 namespace vast::system {
 
@@ -57,6 +62,17 @@ spawn_node(caf::scoped_actor& self, const caf::settings& opts) {
       return err;
     }
   }
+  // Start applying the retention policy, if configured.
+  if (auto retention = get_or(opts, "system.retention", std::string{});
+      !retention.empty()) {
+    auto max_age = to<duration>(retention);
+    if (!max_age || *max_age <= duration::zero()) {
+      VAST_ERROR(self, "got an invalid retention period:", retention);
+      return make_error(ec::invalid_configuration, "invalid retention",
+                        retention);
+    }
+    self->send(node.get(), erase_atom::value, *max_age);
+  }
   return node;
 }
 
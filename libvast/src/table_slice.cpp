@@ -13,6 +13,7 @@
 
 #include "vast/table_slice.hpp"
 
+#include <algorithm>
 #include <unordered_map>
 
 #include <caf/actor_system.hpp>
@@ -80,6 +81,13 @@ table_slice::table_slice(table_slice_header header)
   // nop
 }
 
+table_slice::table_slice(const table_slice& other)
+  : caf::ref_counted(other),
+    header_{other.header_},
+    interned_layout_{other.interned_layout()} {
+  // nop
+}
+
 table_slice::~table_slice() {
   // no
 }
@@ -95,6 +103,19 @@ record_type table_slice::layout(size_type first_column,
   return record_type{std::move(sub_records)};
 }
 
+const type& table_slice::interned_layout() const {
+  std::call_once(interned_layout_flag_, [&] {
+    if (!interned_layout_)
+      interned_layout_ = intern(type{header_.layout});
+  });
+  return interned_layout_;
+}
+
+void table_slice::interned_layout(type x) noexcept {
+  VAST_ASSERT(x == type{header_.layout});
+  interned_layout_ = std::move(x);
+}
+
 table_slice::row_view table_slice::row(size_t index) const {
   VAST_ASSERT(index < rows());
   return {*this, index};
@@ -121,12 +142,27 @@ caf::error table_slice::load(chunk_ptr chunk) {
   return deserialize(source);
 }
 
+caf::error table_slice::decode() const {
+  return caf::none;
+}
+
 void table_slice::append_column_to_index(size_type col,
                                          value_index& idx) const {
   for (size_type row = 0; row < rows(); ++row)
     idx.append(at(row, col), offset() + row);
 }
 
+ids table_slice::evaluate_column(size_type col, relational_operator op,
+                                 const data_view& rhs) const {
+  VAST_ASSERT(col < columns());
+  auto& t = layout().fields[col].type;
+  ids result;
+  result.append_bits(false, offset());
+  for (size_type row = 0; row < rows(); ++row)
+    result.append_bit(evaluate_view(to_canonical(t, at(row, col)), op, rhs));
+  return result;
+}
+
 caf::expected<std::vector<table_slice_ptr>>
 make_random_table_slices(size_t num_slices, size_t slice_size,
                          record_type layout, id offset, size_t seed) {
@@ -228,6 +264,55 @@ table_slice* intrusive_cow_ptr_unshare(table_slice*& ptr) {
   return caf::default_intrusive_cow_ptr_unshare(ptr);
 }
 
+std::vector<size_t> resolve_columns(const record_type& layout,
+                                    const std::vector<std::string>& keys) {
+  std::vector<size_t> result;
+  for (auto& key : keys)
+    for (auto& offset : layout.find_suffix(key))
+      if (offset.size() == 1
+          && std::find(result.begin(), result.end(), offset[0]) == result.end())
+        result.push_back(offset[0]);
+  return result;
+}
+
+table_slice_ptr project(const table_slice_ptr& slice,
+                        const std::vector<size_t>& columns) {
+  VAST_ASSERT(slice != nullptr);
+  if (columns.empty())
+    return nullptr;
+  auto& fields = slice->layout().fields;
+  auto identity = columns.size() == fields.size();
+  for (size_t i = 0; identity && i < columns.size(); ++i)
+    identity = columns[i] == i;
+  if (identity)
+    return slice;
+  std::vector<record_field> projected;
+  projected.reserve(columns.size());
+  for (auto col : columns) {
+    VAST_ASSERT(col < fields.size());
+    projected.push_back(fields[col]);
+  }
+  auto layout = record_type{std::move(projected)};
+  layout.name(slice->layout().name());
+  auto impl = slice->implementation_id();
+  auto builder = factory<table_slice_builder>::make(impl, std::move(layout));
+  if (builder == nullptr) {
+    VAST_ERROR(__func__, "failed to get a table slice builder for", impl);
+    return nullptr;
+  }
+  for (size_t row = 0; row < slice->rows(); ++row)
+    for (auto col : columns)
+      if (!builder->add(slice->at(row, col))) {
+        VAST_ERROR(__func__, "failed to add data at column", col, "in row",
+                   row, "to the builder");
+        return nullptr;
+      }
+  auto result = builder->finish();
+  if (result != nullptr)
+    result.unshared().offset(slice->offset());
+  return result;
+}
+
 table_slice_ptr truncate(const table_slice_ptr& slice, size_t num_rows) {
   VAST_ASSERT(slice != nullptr);
   VAST_ASSERT(num_rows > 0);
@@ -291,10 +376,13 @@ caf::error inspect(caf::deserializer& source, table_slice_ptr& ptr) {
   table_slice_header header;
   if (auto err = source(header))
     return err;
+  auto layout = intern(type{header.layout});
   ptr = factory<table_slice>::make(id, std::move(header));
   if (!ptr)
     return ec::invalid_table_slice_type;
-  return ptr.unshared().deserialize(source);
+  auto& slice = ptr.unshared();
+  slice.interned_layout(std::move(layout));
+  return slice.deserialize(source);
 }
 
 } // namespace vast
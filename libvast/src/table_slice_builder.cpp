@@ -21,7 +21,8 @@
 namespace vast {
 
 table_slice_builder::table_slice_builder(record_type layout)
-  : layout_(std::move(layout)) { // nop
+  : layout_(std::move(layout)), interned_layout_(intern(type{layout_})) {
+  // nop
 }
 
 table_slice_builder::~table_slice_builder() {
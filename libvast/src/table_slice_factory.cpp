@@ -37,14 +37,17 @@ table_slice_ptr factory_traits<table_slice>::make(chunk_ptr chunk) {
     VAST_ERROR_ANON(__func__, "failed to deserialize table slice meta data");
     return nullptr;
   }
+  auto layout = intern(type{header.layout});
   auto result = factory<table_slice>::make(id, std::move(header));
   if (!result) {
     VAST_ERROR_ANON(__func__, "failed to make table slice for:", to_string(id));
     return nullptr;
   }
+  auto& slice = result.unshared();
+  slice.interned_layout(std::move(layout));
   // Skip table slice data already processed.
   auto bytes_read = chunk->size() - source.remaining();
-  if (auto err = result.unshared().load(chunk->slice(bytes_read))) {
+  if (auto err = slice.load(chunk->slice(bytes_read))) {
     VAST_ERROR_ANON(__func__, "failed to load table slice from chunk");
     return nullptr;
   }
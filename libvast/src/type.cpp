@@ -11,8 +11,10 @@
  * contained in the LICENSE file.                                             *
  ******************************************************************************/
 
+#include <mutex>
 #include <tuple>
 #include <typeindex>
+#include <unordered_map>
 #include <utility>
 
 #include "vast/data.hpp"
@@ -45,17 +47,60 @@ none_type none_type_singleton;
 // -- type ---------------------------------------------------------------------
 
 bool operator==(const type& x, const type& y) {
-  if (x.ptr_ && y.ptr_)
+  if (x.ptr_ == y.ptr_)
+    return true;
+  if (x.ptr_ && y.ptr_) {
+    // Distinct canonical instances never compare equal.
+    if (x.interned() && y.interned())
+      return false;
     return *x.ptr_ == *y.ptr_;
-  return x.ptr_ == y.ptr_;
+  }
+  return false;
 }
 
 bool operator<(const type& x, const type& y) {
+  if (x.ptr_ == y.ptr_)
+    return false;
   if (x.ptr_ && y.ptr_)
     return *x.ptr_ < *y.ptr_;
   return x.ptr_ < y.ptr_;
 }
 
+type intern(type x) {
+  if (!x || x.interned())
+    return x;
+  auto digest = uhash<xxhash64>{}(x);
+  auto find = [&](auto& xs) -> const type* {
+    auto [first, last] = xs.equal_range(digest);
+    for (auto i = first; i != last; ++i)
+      if (*i->second.ptr_ == *x.ptr_)
+        return &i->second;
+    return nullptr;
+  };
+  // Each thread remembers the canonical instances it has seen, so that hits
+  // do not contend for the global table.
+  thread_local std::unordered_multimap<type_digest, type> cache;
+  if (auto y = find(cache))
+    return *y;
+  // The canonical instances, bucketed by digest to handle collisions. The
+  // table never shrinks: it holds one instance per distinct interned type.
+  static std::mutex mtx;
+  static std::unordered_multimap<type_digest, type> canonical_types;
+  std::lock_guard<std::mutex> guard{mtx};
+  if (auto y = find(canonical_types)) {
+    cache.emplace(digest, *y);
+    return *y;
+  }
+  // We must not mark an instance that other handles may still modify, so we
+  // make sure that we own the canonical instance exclusively at this point.
+  auto& canonical = x.ptr_.unshared();
+  canonical.digest_ = digest;
+  canonical.interned_ = true;
+  canonical_types.emplace(digest, x);
+  cache.emplace(digest, x);
+  return x;
+}
+
 type& type::name(const std::string& x) & {
   if (ptr_)
     ptr_.unshared().name_ = x;
@@ -94,6 +139,12 @@ const std::vector<attribute>& type::attributes() const {
   return ptr_ ? ptr_->attributes_ : no_attributes;
 }
 
+type_digest type::digest() const {
+  if (interned())
+    return ptr_->digest_;
+  return uhash<xxhash64>{}(*this);
+}
+
 abstract_type_ptr type::ptr() const {
   return ptr_;
 }
@@ -114,8 +165,42 @@ type::type(abstract_type_ptr x) : ptr_{std::move(x)} {
   // nop
 }
 
+bool type::interned() const noexcept {
+  return ptr_ && ptr_->interned_;
+}
+
 // -- abstract_type -----------------------------------------------------------
 
+abstract_type::abstract_type(const abstract_type& other)
+  : caf::ref_counted{},
+    name_{other.name_},
+    attributes_{other.attributes_} {
+  // nop
+}
+
+abstract_type::abstract_type(abstract_type&& other) noexcept
+  : caf::ref_counted{},
+    name_{std::move(other.name_)},
+    attributes_{std::move(other.attributes_)} {
+  // nop
+}
+
+abstract_type& abstract_type::operator=(const abstract_type& other) {
+  name_ = other.name_;
+  attributes_ = other.attributes_;
+  digest_ = 0;
+  interned_ = false;
+  return *this;
+}
+
+abstract_type& abstract_type::operator=(abstract_type&& other) noexcept {
+  name_ = std::move(other.name_);
+  attributes_ = std::move(other.attributes_);
+  digest_ = 0;
+  interned_ = false;
+  return *this;
+}
+
 abstract_type::~abstract_type() {
   // nop
 }
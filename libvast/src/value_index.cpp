@@ -14,11 +14,16 @@
 #include "vast/value_index.hpp"
 
 #include "vast/base.hpp"
+#include "vast/bitmap_algorithms.hpp"
+#include "vast/chunk.hpp"
 #include "vast/defaults.hpp"
 
+#include <caf/binary_deserializer.hpp>
 #include <caf/settings.hpp>
 
+#include <algorithm>
 #include <cmath>
+#include <limits>
 
 namespace vast {
 
@@ -88,6 +93,20 @@ value_index::lookup(relational_operator op, data_view x) const {
   return std::move(*result);
 }
 
+caf::expected<value_counts>
+value_index::distinct(const ids& selection) const {
+  auto result = distinct_impl(selection & mask_);
+  if (!result)
+    return result;
+  if (auto nils = rank(selection & none_); nils > 0)
+    result->emplace(caf::none, nils);
+  return result;
+}
+
+bool value_index::exact(relational_operator, data_view) const {
+  return false;
+}
+
 value_index::size_type value_index::offset() const {
   return std::max(none_.size(), mask_.size());
 }
@@ -108,6 +127,16 @@ caf::error value_index::deserialize(caf::deserializer& source) {
   return source(mask_, none_);
 }
 
+caf::error value_index::load(chunk_ptr chunk) {
+  VAST_ASSERT(chunk != nullptr);
+  caf::binary_deserializer source{nullptr, chunk->data(), chunk->size()};
+  return deserialize(source);
+}
+
+caf::expected<value_counts> value_index::distinct_impl(const ids&) const {
+  return make_error(ec::unimplemented, "distinct values for", type_);
+}
+
 const ewah_bitmap& value_index::mask() const {
   return mask_;
 }
@@ -265,6 +294,20 @@ enumeration_index::enumeration_index(vast::type t, caf::settings opts)
   // nop
 }
 
+bool enumeration_index::exact(relational_operator op, data_view x) const {
+  if (!(op == equal || op == not_equal))
+    return false;
+  if (caf::holds_alternative<view<enumeration>>(x))
+    return true;
+  // Queries refer to enumeration values by name, which must be known.
+  auto e = caf::get_if<enumeration_type>(&type());
+  auto str = caf::get_if<view<std::string>>(&x);
+  if (!e || !str)
+    return false;
+  auto& fs = e->fields;
+  return std::find(fs.begin(), fs.end(), *str) != fs.end();
+}
+
 caf::error enumeration_index::serialize(caf::serializer& sink) const {
   return caf::error::eval([&] { return value_index::serialize(sink); },
                           [&] { return sink(index_); });
@@ -301,37 +344,188 @@ enumeration_index::lookup_impl(relational_operator op, data_view d) const {
     d);
 }
 
+caf::expected<value_counts>
+enumeration_index::distinct_impl(const ids& selection) const {
+  // The equality coder holds one bitmap per value.
+  value_counts result;
+  auto& bitmaps = index_.coder().storage();
+  for (size_t i = 0; i < bitmaps.size(); ++i)
+    if (auto n = rank(bitmaps[i] & selection); n > 0)
+      result.emplace(static_cast<enumeration>(i), n);
+  return result;
+}
+
 // -- address_index ------------------------------------------------------------
 
+namespace {
+
+/// Computes the key of the prefix trie leaf for an address, i.e., the top
+/// 8 network bits tagged with the address family.
+uint32_t prefix_key(const address& x) {
+  static_assert(address_index::prefix_bits == 8);
+  auto& bytes = x.data();
+  auto first = x.is_v4() ? 12u : 0u;
+  return (uint32_t{x.is_v4()} << 8) | uint32_t{bytes[first]};
+}
+
+/// Precedes the format version of a serialized address index. The legacy
+/// format begins with the size of its first byte index instead, which never
+/// reaches this value.
+constexpr uint64_t address_index_marker = std::numeric_limits<uint64_t>::max();
+
+/// The version of the serialization format of an address index.
+constexpr uint8_t address_index_version = 1;
+
+} // namespace
+
 address_index::address_index(vast::type t, caf::settings opts)
   : value_index{std::move(t), std::move(opts)} {
   bytes_.fill(byte_index{8});
 }
 
+bool address_index::exact(relational_operator op, data_view x) const {
+  if (caf::holds_alternative<view<address>>(x))
+    return op == equal || op == not_equal;
+  if (caf::holds_alternative<view<subnet>>(x))
+    return op == in || op == not_in;
+  return false;
+}
+
 caf::error address_index::serialize(caf::serializer& sink) const {
+  auto marker = address_index_marker;
+  auto version = address_index_version;
   return caf::error::eval([&] { return value_index::serialize(sink); },
-                          [&] { return sink(bytes_, v4_); });
+                          [&] { return sink(marker, version); },
+                          [&] { return sink(prefixes_, bytes_); });
 }
 
 caf::error address_index::deserialize(caf::deserializer& source) {
-  return caf::error::eval([&] { return value_index::deserialize(source); },
-                          [&] { return source(bytes_, v4_); });
+  uint64_t marker = 0;
+  if (auto err = caf::error::eval(
+        [&] { return value_index::deserialize(source); },
+        [&] { return source(marker); }))
+    return err;
+  if (marker != address_index_marker)
+    return deserialize_legacy(source);
+  uint8_t version = 0;
+  if (auto err = source(version))
+    return err;
+  if (version > address_index_version)
+    return make_error(ec::version_error, "unsupported address index version",
+                      version);
+  return source(prefixes_, bytes_);
+}
+
+caf::error address_index::deserialize_legacy(caf::deserializer& source) {
+  // The bitmaps of a bitslice-coded byte index hold the positions where the
+  // corresponding bit of the byte is 0.
+  std::vector<id> positions;
+  for (auto rng = select(mask()); !rng.done(); rng.next())
+    positions.push_back(rng.get());
+  std::vector<address::array_type> addrs(positions.size());
+  for (auto& x : addrs)
+    x.fill(0xFF);
+  for (auto i = 0u; i < 16; ++i) {
+    // The caller has read the size of the first byte index already.
+    uint64_t size = 0;
+    if (i > 0)
+      if (auto err = source(size))
+        return err;
+    std::vector<ewah_bitmap> bitmaps;
+    if (auto err = source(bitmaps))
+      return err;
+    for (auto bit = 0u; bit < bitmaps.size(); ++bit) {
+      auto zeros = bitmaps[bit] & mask();
+      for (auto rng = select(zeros); !rng.done(); rng.next()) {
+        auto j = std::lower_bound(positions.begin(), positions.end(),
+                                  rng.get());
+        addrs[j - positions.begin()][i] &= ~(1u << bit);
+      }
+    }
+  }
+  // The IPv4 addresses are apparent from their bytes.
+  ewah_bitmap v4;
+  if (auto err = source(v4))
+    return err;
+  for (size_t j = 0; j < addrs.size(); ++j)
+    append_impl(address::v6(addrs[j].data(), address::network), positions[j]);
+  return caf::none;
 }
 
 bool address_index::append_impl(data_view x, id pos) {
   auto addr = caf::get_if<view<address>>(&x);
   if (!addr)
     return false;
+  auto key = prefix_key(*addr);
+  auto leaf = prefixes_.find(key);
+  if (leaf == prefixes_.end())
+    leaf = prefixes_.emplace(key, ewah_bitmap{}).first;
+  leaf->second.append_bits(false, pos - leaf->second.size());
+  leaf->second.append_bit(true);
+  // IPv4 addresses only populate the byte indexes of their 32 network bits.
   auto& bytes = addr->data();
-  for (auto i = 0u; i < 16; ++i) {
+  auto first = (addr->is_v4() ? 12u : 0u) + prefix_bits / 8;
+  for (auto i = 0u; first + i < 16; ++i) {
     bytes_[i].skip(pos - bytes_[i].size());
-    bytes_[i].append(bytes[i]);
+    bytes_[i].append(bytes[first + i]);
   }
-  v4_.skip(pos - v4_.size());
-  v4_.append(addr->is_v4());
   return true;
 }
 
+ids address_index::lookup_prefix(const address& x, size_t k) const {
+  VAST_ASSERT(k > 0 && k <= (x.is_v4() ? 32u : 128u));
+  auto& leaves = as_vector(prefixes_);
+  auto key_less = [](const auto& leaf, uint32_t key) {
+    return leaf.first < key;
+  };
+  // Computes the union of all leaves with a key in [lo, hi).
+  auto unite = [&](uint32_t lo, uint32_t hi) {
+    auto f = std::lower_bound(leaves.begin(), leaves.end(), lo, key_less);
+    auto l = std::lower_bound(f, leaves.end(), hi, key_less);
+    ewah_bitmap result;
+    for (; f != l; ++f)
+      result |= f->second;
+    return result;
+  };
+  ewah_bitmap result;
+  if (k < prefix_bits) {
+    // The inner node at depth k is the union of all leaves below it.
+    auto span = uint32_t{1} << (prefix_bits - k);
+    auto lo = prefix_key(x) & ~(span - 1);
+    result = unite(lo, lo + span);
+  } else if (auto leaf = prefixes_.find(prefix_key(x));
+             leaf != prefixes_.end()) {
+    result = leaf->second;
+    auto& bytes = x.data();
+    auto first = (x.is_v4() ? 12u : 0u) + prefix_bits / 8;
+    auto n = k - prefix_bits;
+    for (auto i = 0u; n > 0 && !all<0>(result); ++i) {
+      auto byte = bytes[first + i];
+      if (n >= 8) {
+        result &= bytes_[i].lookup(equal, byte);
+        n -= 8;
+      } else {
+        for (auto j = 0u; j < n; ++j) {
+          auto bit = 7 - j;
+          auto& bm = bytes_[i].coder().storage()[bit];
+          result &= (byte >> bit) & 1 ? ~bm : bm;
+        }
+        n = 0;
+      }
+    }
+  }
+  // We store IPv4 addresses as IPv4-mapped IPv6 addresses, so a short IPv6
+  // network may contain all of them.
+  if (x.is_v6() && k <= 96) {
+    uint32_t any = 0;
+    if (x.compare(address::v4(&any), k))
+      result |= unite(uint32_t{1} << prefix_bits, uint32_t{2} << prefix_bits);
+  }
+  if (result.size() < offset())
+    result.append_bits(false, offset() - result.size());
+  return result;
+}
+
 caf::expected<ids>
 address_index::lookup_impl(relational_operator op, data_view d) const {
   return caf::visit(
@@ -342,13 +536,7 @@ address_index::lookup_impl(relational_operator op, data_view d) const {
       [&](view<address> x) -> caf::expected<ids> {
         if (!(op == equal || op == not_equal))
           return make_error(ec::unsupported_operator, op);
-        auto result = x.is_v4() ? v4_.coder().storage() : ids{offset(), true};
-        for (auto i = x.is_v4() ? 12u : 0u; i < 16; ++i) {
-          auto bm = bytes_[i].lookup(equal, x.data()[i]);
-          result &= bm;
-          if (all<0>(result))
-            return ids{offset(), op == not_equal};
-        }
+        auto result = lookup_prefix(x, x.is_v4() ? 32 : 128);
         if (op == not_equal)
           result.flip();
         return result;
@@ -360,21 +548,7 @@ address_index::lookup_impl(relational_operator op, data_view d) const {
         if (topk == 0)
           return make_error(ec::unspecified,
                             "invalid IP subnet length: ", topk);
-        auto is_v4 = x.network().is_v4();
-        if ((is_v4 ? topk + 96 : topk) == 128)
-          // Asking for /32 or /128 membership is equivalent to an equality
-          // lookup.
-          return lookup_impl(op == in ? equal : not_equal, x.network());
-        auto result = is_v4 ? v4_.coder().storage() : ids{offset(), true};
-        auto& bytes = x.network().data();
-        size_t i = is_v4 ? 12 : 0;
-        for (; i < 16 && topk >= 8; ++i, topk -= 8)
-          result &= bytes_[i].lookup(equal, bytes[i]);
-        for (auto j = 0u; j < topk; ++j) {
-          auto bit = 7 - j;
-          auto& bm = bytes_[i].coder().storage()[bit];
-          result &= (bytes[i] >> bit) & 1 ? ~bm : bm;
-        }
+        auto result = lookup_prefix(x.network(), topk);
         if (op == not_in)
           result.flip();
         return result;
@@ -543,6 +717,26 @@ port_index::lookup_impl(relational_operator op, data_view d) const {
     d);
 }
 
+caf::expected<value_counts>
+port_index::distinct_impl(const ids& selection) const {
+  // Partition the selection by protocol, which has one bitmap per value, and
+  // then bisect the range-coded port numbers of each protocol.
+  value_counts result;
+  auto& bitmaps = proto_.coder().storage();
+  for (size_t i = 0; i < bitmaps.size(); ++i) {
+    ids xs = bitmaps[i] & selection;
+    if (all<0>(xs))
+      continue;
+    auto type = static_cast<port::port_type>(i);
+    auto f = [&](port::number_type number, const ids& ys) {
+      result.emplace(port{number, type}, rank(ys));
+    };
+    detail::bisect(num_, xs, std::numeric_limits<port::number_type>::min(),
+                   std::numeric_limits<port::number_type>::max(), f);
+  }
+  return result;
+}
+
 // -- sequence_index -----------------------------------------------------------
 
 sequence_index::sequence_index(vast::type t, caf::settings opts)
@@ -622,4 +816,97 @@ sequence_index::lookup_impl(relational_operator op, data_view x) const {
   return result;
 }
 
+// -- element_set_index --------------------------------------------------------
+
+element_set_index::element_set_index(vast::type t, caf::settings opts)
+  : value_index{std::move(t), std::move(opts)} {
+  auto f = [](const auto& x) -> vast::type {
+    using concrete_type = std::decay_t<decltype(x)>;
+    if constexpr (detail::is_any_v<concrete_type, vector_type, set_type>)
+      return x.value_type;
+    else
+      return none_type{};
+  };
+  auto value_type = caf::visit(f, value_index::type());
+  VAST_ASSERT(!caf::holds_alternative<none_type>(value_type));
+  elements_ = factory<value_index>::make(std::move(value_type), options());
+  VAST_ASSERT(elements_);
+}
+
+caf::error element_set_index::serialize(caf::serializer& sink) const {
+  return caf::error::eval([&] { return value_index::serialize(sink); },
+                          [&] { return sink(elements_, ends_, rows_); });
+}
+
+caf::error element_set_index::deserialize(caf::deserializer& source) {
+  return caf::error::eval([&] { return value_index::deserialize(source); },
+                          [&] { return source(elements_, ends_, rows_); });
+}
+
+bool element_set_index::append_impl(data_view x, id pos) {
+  auto f = [&](const auto& v) {
+    using view_type = std::decay_t<decltype(v)>;
+    if constexpr (detail::is_any_v<view_type, view<vector>, view<set>>) {
+      if (v->size() == 0)
+        return true;
+      // Elements occupy consecutive positions in the element index, and the
+      // n-th end marker belongs to the n-th row in rows_.
+      auto first = ends_.size();
+      auto i = first;
+      for (auto element : *v)
+        elements_->append(element, i++);
+      ends_.append_bits(false, v->size() - 1);
+      ends_.append_bit(true);
+      rows_.append_bits(false, pos - rows_.size());
+      rows_.append_bit(true);
+      return true;
+    }
+    return false;
+  };
+  return caf::visit(f, x);
+}
+
+caf::expected<ids>
+element_set_index::lookup_impl(relational_operator op, data_view x) const {
+  if (!(op == ni || op == not_ni))
+    return make_error(ec::unsupported_operator, op);
+  auto hits = elements_->lookup(equal, x);
+  if (!hits)
+    return hits;
+  auto result = to_rows(*hits);
+  if (op == not_ni) {
+    result.append_bits(false, offset() - result.size());
+    result.flip();
+  }
+  return result;
+}
+
+ids element_set_index::to_rows(const ids& hits) const {
+  ewah_bitmap result;
+  auto ends = select(ends_);
+  auto rows = select(rows_);
+  auto rng = select(hits);
+  while (rng && ends) {
+    // Find the row of the current element, i.e., the first end marker at or
+    // after it. The rows advance in lockstep with the end markers.
+    while (ends && ends.get() < rng.get()) {
+      ends.next();
+      rows.next();
+    }
+    if (!ends)
+      break;
+    VAST_ASSERT(rows);
+    result.append_bits(false, rows.get() - result.size());
+    result.append_bit(true);
+    // Skip the remaining hits in the same row.
+    auto last = ends.get();
+    ends.next();
+    rows.next();
+    if (last + 1 >= hits.size())
+      break;
+    rng.next_from(last + 1);
+  }
+  return result;
+}
+
 } // namespace vast
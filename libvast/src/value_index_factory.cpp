@@ -14,6 +14,7 @@
 #include "vast/value_index_factory.hpp"
 
 #include "vast/base.hpp"
+#include "vast/chunk.hpp"
 #include "vast/concept/parseable/numeric/integral.hpp"
 #include "vast/concept/parseable/vast/base.hpp"
 #include "vast/detail/bit.hpp"
@@ -23,6 +24,7 @@
 #include "vast/type.hpp"
 #include "vast/value_index.hpp"
 
+#include <caf/binary_deserializer.hpp>
 #include <caf/optional.hpp>
 #include <caf/settings.hpp>
 
@@ -55,8 +57,38 @@ value_index_ptr make(type x, caf::settings opts) {
       return nullptr;
     }
   }
+  // Binning is either fixed per type or adaptive.
+  if (auto i = opts.find("binning"); i != opts.end()) {
+    auto str = caf::get_if<caf::config_value::string>(&i->second);
+    if (!str || *str != "adaptive") {
+      VAST_ERROR_ANON(__func__, "invalid binning (\"adaptive\" needed)");
+      return nullptr;
+    }
+  }
+  // The attribute `#binning-sample=N` chooses the sample size of a field.
+  if (auto a = find_attribute(x, "binning-sample"); a && a->value) {
+    int_type n = 0;
+    if (!parsers::i64(*a->value, n)) {
+      VAST_ERROR_ANON(__func__, "invalid binning sample size");
+      return nullptr;
+    }
+    opts["binning-sample"] = n;
+  }
+  if (auto i = opts.find("binning-sample"); i != opts.end()) {
+    auto n = caf::get_if<int_type>(&i->second);
+    if (!n || *n <= 0) {
+      VAST_ERROR_ANON(__func__, "invalid binning sample size");
+      return nullptr;
+    }
+  }
   if (auto a = find_attribute(x, "index")) {
-    if (auto value = a->value)
+    if (auto value = a->value) {
+      if (*value == "adaptive"sv)
+        opts["binning"] = caf::config_value::string{"adaptive"};
+      if constexpr (std::is_same_v<T, sequence_index>)
+        if (*value == "elements"sv)
+          return std::make_unique<element_set_index>(std::move(x),
+                                                     std::move(opts));
       if (*value == "hash"sv) {
         auto i = opts.find("cardinality");
         if (i == opts.end())
@@ -112,6 +144,7 @@ value_index_ptr make(type x, caf::settings opts) {
             return std::make_unique<hash_index<8>>(std::move(x));
         }
       }
+    }
   }
   return std::make_unique<T>(std::move(x), std::move(opts));
 }
@@ -161,4 +194,29 @@ factory_traits<value_index>::key(const type& t) {
   return caf::visit(f, t);
 }
 
+value_index_ptr factory_traits<value_index>::make(chunk_ptr chunk) {
+  if (chunk == nullptr)
+    return nullptr;
+  // Deserialize type and options, and construct a value index.
+  caf::binary_deserializer source{nullptr, chunk->data(), chunk->size()};
+  type t;
+  caf::settings opts;
+  if (auto err = source(t, opts)) {
+    VAST_ERROR_ANON(__func__, "failed to deserialize value index meta data");
+    return nullptr;
+  }
+  auto result = factory<value_index>::make(std::move(t), std::move(opts));
+  if (result == nullptr) {
+    VAST_ERROR_ANON(__func__, "failed to construct value index");
+    return nullptr;
+  }
+  // Skip the data already processed.
+  auto bytes_read = chunk->size() - source.remaining();
+  if (auto err = result->load(chunk->slice(bytes_read))) {
+    VAST_ERROR_ANON(__func__, "failed to load value index from chunk");
+    return nullptr;
+  }
+  return result;
+}
+
 } // namespace vast
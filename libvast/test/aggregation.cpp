@@ -0,0 +1,124 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+#define SUITE aggregation
+
+#include "vast/aggregation.hpp"
+
+#include "vast/test/test.hpp"
+
+#include "vast/default_table_slice_builder.hpp"
+#include "vast/ids.hpp"
+#include "vast/table_slice.hpp"
+#include "vast/view.hpp"
+
+#include <caf/make_copy_on_write.hpp>
+
+using namespace vast;
+using namespace std::string_literals;
+
+namespace {
+
+struct fixture {
+  fixture() {
+    auto layout = record_type{{"host", string_type{}},
+                              {"bytes", count_type{}},
+                              {"note", string_type{}}};
+    auto builder = default_table_slice_builder::make(layout);
+    auto add = [&](auto host, count bytes) {
+      CHECK(builder->add(make_data_view(host)));
+      CHECK(builder->add(make_data_view(bytes)));
+      CHECK(builder->add(make_data_view("foo")));
+    };
+    add("a", 10);
+    add("b", 5);
+    add("a", 7);
+    add(caf::none, 3);
+    slice = builder->finish();
+    REQUIRE(slice != nullptr);
+    slice.unshared().offset(100);
+  }
+
+  static aggregation make(std::vector<std::string> group_by,
+                          std::vector<std::string> functions) {
+    std::vector<aggregate> aggregates;
+    for (auto& x : functions)
+      aggregates.push_back(unbox(make_aggregate(x)));
+    return aggregation{std::move(group_by), std::move(aggregates)};
+  }
+
+  table_slice_ptr slice;
+};
+
+} // namespace
+
+FIXTURE_SCOPE(aggregation_tests, fixture)
+
+TEST(parsing) {
+  auto x = unbox(make_aggregate("sum(bytes)"));
+  CHECK(x.function == aggregate_function::sum);
+  CHECK_EQUAL(x.field, "bytes");
+  CHECK_EQUAL(to_string(x), "sum(bytes)");
+  x = unbox(make_aggregate("count"));
+  CHECK(x.function == aggregate_function::count);
+  CHECK(x.field.empty());
+  CHECK(!make_aggregate("sum"));
+  CHECK(!make_aggregate("sum()"));
+  CHECK(!make_aggregate("avg(bytes)"));
+  CHECK(!make_aggregate("max(bytes"));
+}
+
+TEST(group by) {
+  auto sut = make({"host"}, {"count", "sum(bytes)", "min(bytes)", "max(bytes)",
+                             "sum(note)"});
+  sut.add(*slice);
+  auto& groups = sut.groups();
+  REQUIRE_EQUAL(groups.size(), 3u);
+  auto values = [&](data key) {
+    auto i = groups.find(aggregation::key_type{std::move(key)});
+    REQUIRE(i != groups.end());
+    return i->second;
+  };
+  auto a = values("a"s);
+  CHECK_EQUAL(a[0], count{2});
+  CHECK_EQUAL(a[1], count{17});
+  CHECK_EQUAL(a[2], count{7});
+  CHECK_EQUAL(a[3], count{10});
+  CHECK_EQUAL(a[4], data{});
+  auto nil = values(caf::none);
+  CHECK_EQUAL(nil[0], count{1});
+  CHECK_EQUAL(nil[1], count{3});
+}
+
+TEST(selection and merging) {
+  auto sut = make({"host"}, {"count", "sum(bytes)", "max(bytes)"});
+  sut.add(*slice, make_ids({{100, 102}}));
+  auto other = make({"host"}, {"count", "sum(bytes)", "max(bytes)"});
+  other.add(*slice, make_ids({{102, 104}, 200}));
+  sut.merge(other);
+  auto all = make({"host"}, {"count", "sum(bytes)", "max(bytes)"});
+  all.add(*slice);
+  CHECK(sut.groups() == all.groups());
+}
+
+TEST(no group) {
+  auto sut = make({}, {"count", "count(host)", "sum(bytes)"});
+  sut.add(*slice);
+  REQUIRE_EQUAL(sut.groups().size(), 1u);
+  auto& values = sut.groups().begin()->second;
+  CHECK_EQUAL(values[0], count{4});
+  CHECK_EQUAL(values[1], count{3});
+  CHECK_EQUAL(values[2], count{25});
+}
+
+FIXTURE_SCOPE_END()
@@ -16,6 +16,11 @@
 #define SUITE bitmap_index
 #include "vast/test/test.hpp"
 
+#include "vast/aliases.hpp"
+
+#include <numeric>
+#include <vector>
+
 using namespace vast;
 
 TEST(precision - binner 1) {
@@ -67,3 +72,24 @@ TEST(decimal binner 2) {
   using b = decimal_binner<2>;
   CHECK(b::bucket_size == 100);
 }
+
+TEST(adaptive binner - fractional digits) {
+  auto b = adaptive_binner::fit(std::vector<double>{1.5, 2.25, 3.125});
+  CHECK_EQUAL(b.exponent(), -3);
+  CHECK_EQUAL(b.bin(3.125), 3125);
+  CHECK_EQUAL(b.bin(3.1254), 3125);
+  CHECK(b.lossy<double>());
+}
+
+TEST(adaptive binner - integral values) {
+  std::vector<count> xs(100'000);
+  std::iota(xs.begin(), xs.end(), 0);
+  auto b = adaptive_binner::fit(xs);
+  CHECK_EQUAL(b.exponent(), 1);
+  CHECK_EQUAL(b.bin(count{12345}), 1234u);
+  CHECK(b.lossy<count>());
+  xs.resize(1000);
+  b = adaptive_binner::fit(xs);
+  CHECK_EQUAL(b.exponent(), 0);
+  CHECK(!b.lossy<count>());
+}
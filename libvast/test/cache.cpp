@@ -114,3 +114,58 @@ TEST(MRU cache insertion) {
 }
 
 FIXTURE_SCOPE_END()
+
+FIXTURE_SCOPE(tiny_lfu_cache_tests, fixture<detail::tiny_lfu>)
+
+TEST(TinyLFU cache admission) {
+  xs.capacity(4);
+  // Make all cached elements more popular than a newcomer.
+  for (auto i = 0; i < 2; ++i)
+    for (auto key : {"foo", "bar", "baz", "qux"})
+      CHECK(xs.find(key) != xs.end());
+  // A scan over elements that nobody looked up before cannot displace them.
+  for (auto i = 0; i < 10; ++i) {
+    auto key = "scan" + std::to_string(i);
+    CHECK(xs.find(key) == xs.end());
+    auto [it, inserted] = xs.emplace(key, i);
+    CHECK(!inserted);
+    CHECK(it == xs.end());
+  }
+  CHECK_EQUAL(xs.size(), 4u);
+  CHECK(xs.contains("foo"));
+  // Repeated lookups eventually make a newcomer eligible.
+  CHECK(xs.find("new") == xs.end());
+  CHECK(xs.find("new") == xs.end());
+  CHECK(xs.emplace("new", 42).second);
+  CHECK(xs.contains("new"));
+  CHECK(!xs.contains("foo"));
+  auto& stats = xs.statistics();
+  CHECK_EQUAL(stats.hits, 8u);
+  CHECK_EQUAL(stats.misses, 12u);
+  CHECK_EQUAL(stats.evictions, 1u);
+  CHECK_EQUAL(stats.rejections, 10u);
+}
+
+FIXTURE_SCOPE_END()
+
+TEST(weighted cache) {
+  auto weigh = [](const std::string& x) { return x.size(); };
+  detail::cache<int, std::string> xs{10, weigh};
+  CHECK(xs.emplace(1, "aaaa").second);
+  CHECK(xs.emplace(2, "bbbb").second);
+  CHECK_EQUAL(xs.weight(), 8u);
+  // Evicts the first element to make room for the third.
+  CHECK(xs.emplace(3, "cccc").second);
+  CHECK_EQUAL(xs.size(), 2u);
+  CHECK_EQUAL(xs.weight(), 8u);
+  CHECK(!xs.contains(1));
+  // Evicts both elements for a large one.
+  CHECK(xs.emplace(4, "dddddddd").second);
+  CHECK_EQUAL(xs.size(), 1u);
+  CHECK_EQUAL(xs.statistics().evictions, 3u);
+  // Declines elements that exceed the capacity.
+  CHECK(!xs.emplace(5, "eeeeeeeeeee").second);
+  CHECK_EQUAL(xs.statistics().rejections, 1u);
+  CHECK_EQUAL(xs.erase(4), 1u);
+  CHECK_EQUAL(xs.weight(), 0u);
+}
@@ -87,4 +87,18 @@ TEST(read / write) {
   CHECK_EQUAL(as_bytes(x), as_bytes(y));
 }
 
+TEST(prefetching) {
+  std::string_view str = "foobarbaz";
+  auto filename = directory / "chunk";
+  REQUIRE_EQUAL(write(filename, chunk::make(str)), caf::none);
+  auto x = chunk::mmap(filename);
+  REQUIRE_NOT_EQUAL(x, nullptr);
+  x->prefetch();
+  x->prefetch(3, 3);
+  auto y = x->slice(6);
+  y->prefetch(1);
+  CHECK_EQUAL(std::string_view(x->data(), x->size()), str);
+  CHECK_EQUAL(std::string_view(y->data(), y->size()), "baz");
+}
+
 FIXTURE_SCOPE_END()
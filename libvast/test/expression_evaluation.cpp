@@ -16,6 +16,8 @@
 #include "vast/test/fixtures/events.hpp"
 #include "vast/test/test.hpp"
 
+#include "vast/bitmap_algorithms.hpp"
+#include "vast/compiled_expression.hpp"
 #include "vast/concept/parseable/to.hpp"
 #include "vast/concept/parseable/vast/expression.hpp"
 #include "vast/event.hpp"
@@ -25,6 +27,7 @@
 #include "vast/schema.hpp"
 #include "vast/table_slice.hpp"
 
+#include <caf/settings.hpp>
 #include <caf/test/dsl.hpp>
 
 using namespace vast;
@@ -195,4 +198,131 @@ TEST(evaluation - table slice) {
               make_ids({0, 2, 4}, 8));
 }
 
+TEST(evaluation - table slice columns agree with rows) {
+  auto& slice = zeek_conn_log_slices[1];
+  auto layout = slice->layout();
+  auto tailored = [&](std::string_view expr) {
+    auto ast = unbox(to<expression>(expr));
+    return unbox(caf::visit(type_resolver{layout}, ast));
+  };
+  auto row_wise = [&](const expression& expr) {
+    ids result;
+    result.append_bits(false, slice->offset());
+    for (size_t row = 0; row < slice->rows(); ++row)
+      result.append_bit(evaluate_at(*slice, row, expr));
+    return result;
+  };
+  auto exprs = {
+    "orig_h == 192.168.1.102",
+    "orig_h != 192.168.1.102 && resp_p < 100/tcp",
+    "resp_h in 192.168.0.0/16 || duration > 1s",
+    "!(orig_bytes >= 100) && service == \"http\"",
+    "#timestamp >= 2009-11-18+00:00:00",
+    "conn_state ni \"S\"",
+    "proto == \"udp\"",
+    "#type == \"zeek.conn\"",
+  };
+  for (auto expr : exprs) {
+    MESSAGE(expr);
+    auto ast = tailored(expr);
+    auto result = evaluate(*slice, ast);
+    CHECK_EQUAL(result.size(), slice->offset() + slice->rows());
+    CHECK_EQUAL(result, row_wise(ast));
+  }
+}
+
+TEST(evaluation - table slice selection) {
+  auto& slice = zeek_conn_log_slices[1];
+  auto layout = slice->layout();
+  auto ast = unbox(to<expression>("orig_h != 192.168.1.102"));
+  auto expr = unbox(caf::visit(type_resolver{layout}, ast));
+  auto all = evaluate(*slice, expr);
+  auto first = slice->offset();
+  MESSAGE("sparse selection");
+  auto sparse = make_ids({first + 1}, first + slice->rows());
+  CHECK_EQUAL(evaluate(*slice, expr, sparse), all & sparse);
+  MESSAGE("dense selection");
+  auto dense = make_ids({{first, first + slice->rows()}});
+  CHECK_EQUAL(evaluate(*slice, expr, dense), all);
+  MESSAGE("selection outside of the slice");
+  auto outside = make_ids({first + slice->rows() + 10});
+  CHECK_EQUAL(rank(evaluate(*slice, expr, outside)), 0u);
+}
+
+TEST(evaluation - compiled expression) {
+  auto& slice = zeek_conn_log_slices[1];
+  auto layout = slice->layout();
+  auto exprs = {
+    "orig_h == 192.168.1.102",
+    "service ~ /d.s/",
+    "service in /n/ || proto != \"udp\"",
+    "resp_p in {67/udp, 137/udp}",
+    "!(orig_h in {192.168.1.102, 192.168.1.103})",
+    "#type == \"zeek.conn\" && duration < 5s",
+    "#timestamp < 2009-11-18+08:00:00",
+  };
+  for (auto str : exprs) {
+    MESSAGE(str);
+    auto expr = unbox(to<expression>(str));
+    auto tailored = unbox(caf::visit(type_resolver{layout}, expr));
+    auto compiled = unbox(compiled_expression::make(expr, layout));
+    CHECK(!compiled.program().empty());
+    ids expected;
+    expected.append_bits(false, slice->offset());
+    for (size_t row = 0; row < slice->rows(); ++row) {
+      auto x = evaluate_at(*slice, row, tailored);
+      CHECK_EQUAL(compiled(*slice, row), x);
+      expected.append_bit(x);
+    }
+    CHECK_EQUAL(compiled(*slice), expected);
+    auto selection = make_ids({slice->offset() + 2},
+                              slice->offset() + slice->rows());
+    CHECK_EQUAL(compiled(*slice, selection), expected & selection);
+  }
+  MESSAGE("an empty program matches nothing");
+  CHECK_EQUAL(rank(compiled_expression{}(*slice)), 0u);
+}
+
+TEST(evaluation - residual expression) {
+  auto& slice = zeek_conn_log_slices[1];
+  auto layout = slice->layout();
+  auto compile = [&](const char* str) {
+    return unbox(compiled_expression::make(unbox(to<expression>(str)),
+                                           layout));
+  };
+  MESSAGE("exact predicates need no candidate check");
+  auto exact = compile("orig_h == 192.168.1.102 && orig_bytes > 100");
+  CHECK(exact.exact());
+  auto hits = exact(*slice);
+  auto residual = exact.residual();
+  CHECK(residual.exact());
+  CHECK_EQUAL(residual(*slice, hits), hits);
+  MESSAGE("inexact predicates remain in the residual");
+  auto mixed = compile("orig_h == 192.168.1.102 && service ~ /d.s/ "
+                       "&& duration < 5s");
+  CHECK(!mixed.exact());
+  residual = mixed.residual();
+  CHECK(!residual.exact());
+  CHECK_EQUAL(residual.expr(),
+              compile("service ~ /d.s/ && duration < 5s").expr());
+  CHECK_EQUAL(residual(*slice, hits), mixed(*slice) & hits);
+  CHECK_EQUAL(compile("service ~ /d.s/ && orig_bytes > 100").residual().expr(),
+              compile("service ~ /d.s/").expr());
+  MESSAGE("negations and hashed or binned columns are inexact");
+  for (auto str : {"!(orig_h == 192.168.1.102)", "duration < 5s",
+                   "orig_h in 192.168.0.0/16 || service == \"dns\""}) {
+    auto x = compile(str);
+    CHECK(!x.exact());
+    CHECK_EQUAL(x.residual().expr(), x.expr());
+  }
+  CHECK(compile("orig_h in 192.168.0.0/16").exact());
+  MESSAGE("adaptive binning makes arithmetic predicates inexact");
+  caf::settings opts;
+  opts["binning"] = "adaptive";
+  auto binned = unbox(compiled_expression::make(
+    unbox(to<expression>("orig_bytes > 100")), layout, opts));
+  CHECK(!binned.exact());
+  CHECK_EQUAL(binned.residual().expr(), binned.expr());
+}
+
 FIXTURE_SCOPE_END()
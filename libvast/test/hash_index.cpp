@@ -17,14 +17,19 @@
 
 #include "vast/test/test.hpp"
 
+#include "vast/chunk.hpp"
 #include "vast/concept/printable/to_string.hpp"
 #include "vast/concept/printable/vast/bitmap.hpp"
+#include "vast/detail/steady_map.hpp"
 #include "vast/load.hpp"
 #include "vast/save.hpp"
 #include "vast/si_literals.hpp"
 
+#include <caf/binary_serializer.hpp>
 #include <caf/test/dsl.hpp>
 
+#include <map>
+
 using namespace vast;
 using namespace std::string_literals;
 using namespace vast::si_literals;
@@ -64,6 +69,126 @@ TEST(serialization) {
   CHECK(!y.append(make_data_view("foo")));
 }
 
+TEST(collisions at higher cardinality) {
+  // Two bytes for 1,000 values yield a handful of collisions that the index
+  // must resolve with seeds.
+  hash_index<2> x{count_type{}};
+  for (count i = 0; i < 1000; ++i)
+    REQUIRE(x.append(make_data_view(i), i * 2));
+  auto verify = [](const auto& idx) {
+    for (count i = 0; i < 1000; ++i) {
+      auto result = unbox(idx.lookup(equal, make_data_view(i)));
+      REQUIRE_EQUAL(rank(result), 1u);
+      CHECK_EQUAL(select(result, -1), id{i * 2});
+    }
+    auto xs = vector{count{1}, count{42}, count{999}};
+    auto result = unbox(idx.lookup(in, make_data_view(xs)));
+    CHECK_EQUAL(rank(result), 3u);
+    result = unbox(idx.lookup(not_equal, make_data_view(count{42})));
+    CHECK_EQUAL(rank(result), 999u);
+  };
+  MESSAGE("lookup while building");
+  verify(x);
+  MESSAGE("lookup after deserialization");
+  std::vector<char> buf;
+  REQUIRE(save(nullptr, buf, x) == caf::none);
+  hash_index<2> y{count_type{}};
+  REQUIRE(load(nullptr, buf, y) == caf::none);
+  verify(y);
+}
+
+TEST(loading from a chunk) {
+  hash_index<1> x{string_type{}};
+  REQUIRE(x.append(make_data_view("foo")));
+  REQUIRE(x.append(make_data_view("bar")));
+  REQUIRE(x.append(make_data_view("baz")));
+  REQUIRE(x.append(make_data_view("foo")));
+  std::vector<char> buf;
+  REQUIRE(save(nullptr, buf, x) == caf::none);
+  hash_index<1> y{string_type{}};
+  REQUIRE_EQUAL(y.load(chunk::make(buf)), caf::none);
+  auto result = y.lookup(equal, make_data_view("foo"));
+  CHECK_EQUAL(to_string(unbox(result)), "1001");
+  result = y.lookup(not_equal, make_data_view("bar"));
+  CHECK_EQUAL(to_string(unbox(result)), "1011");
+  CHECK(!y.append(make_data_view("foo")));
+  MESSAGE("serializing a loaded index yields the same bytes");
+  std::vector<char> copy;
+  REQUIRE(save(nullptr, copy, y) == caf::none);
+  CHECK(copy == buf);
+  MESSAGE("load through the factory");
+  factory<value_index>::initialize();
+  auto t = string_type{}.attributes({{"index", "hash"}});
+  auto idx = factory<value_index>::make(t, caf::settings{});
+  REQUIRE(idx != nullptr);
+  REQUIRE(idx->append(make_data_view("foo")));
+  REQUIRE(idx->append(make_data_view("bar")));
+  buf.clear();
+  REQUIRE(save(nullptr, buf, idx) == caf::none);
+  auto z = factory<value_index>::traits::make(chunk::make(std::move(buf)));
+  REQUIRE(z != nullptr);
+  result = z->lookup(equal, make_data_view("bar"));
+  CHECK_EQUAL(to_string(unbox(result)), "01");
+}
+
+TEST(legacy format) {
+  // The legacy format stored all digests as a sequence, followed by the
+  // seeds of all colliding values, keyed by value.
+  using index_type = hash_index<1>;
+  auto xs = std::vector<data>{"foo", "bar", "baz", "foo"};
+  std::vector<index_type::digest_type> digests;
+  detail::steady_map<data, size_t> seeds;
+  std::map<index_type::digest_type, data> owners;
+  for (auto& x : xs) {
+    for (size_t seed = 0;; ++seed) {
+      auto digest = index_type::hash(make_view(x), seed);
+      auto [i, inserted] = owners.emplace(digest, x);
+      if (inserted || i->second == x) {
+        if (inserted && seed > 0)
+          seeds.emplace(x, seed);
+        digests.push_back(digest);
+        break;
+      }
+    }
+  }
+  REQUIRE(!seeds.empty());
+  // Take the base class state from an index in the current format.
+  index_type x{string_type{}};
+  for (auto& y : xs)
+    REQUIRE(x.append(make_view(y)));
+  std::vector<char> buf;
+  caf::binary_serializer sink{nullptr, buf};
+  auto& base = static_cast<const value_index&>(x);
+  REQUIRE_EQUAL(base.value_index::serialize(sink), caf::none);
+  REQUIRE_EQUAL(sink(digests, seeds), caf::none);
+  index_type y{string_type{}};
+  REQUIRE(load(nullptr, buf, y) == caf::none);
+  auto result = y.lookup(equal, make_data_view("foo"));
+  CHECK_EQUAL(to_string(unbox(result)), "1001");
+  result = y.lookup(equal, make_data_view("bar"));
+  CHECK_EQUAL(to_string(unbox(result)), "0100");
+  result = y.lookup(not_equal, make_data_view("baz"));
+  CHECK_EQUAL(to_string(unbox(result)), "1101");
+  CHECK(!y.append(make_data_view("foo")));
+  MESSAGE("loading from a chunk copies the legacy format");
+  index_type z{string_type{}};
+  REQUIRE_EQUAL(z.load(chunk::make(std::move(buf))), caf::none);
+  result = z.lookup(equal, make_data_view("bar"));
+  CHECK_EQUAL(to_string(unbox(result)), "0100");
+  MESSAGE("an empty index in the legacy format");
+  index_type empty{string_type{}};
+  buf.clear();
+  caf::binary_serializer empty_sink{nullptr, buf};
+  auto& empty_base = static_cast<const value_index&>(empty);
+  REQUIRE_EQUAL(empty_base.value_index::serialize(empty_sink), caf::none);
+  REQUIRE_EQUAL(empty_sink(std::vector<index_type::digest_type>{},
+                           detail::steady_map<data, size_t>{}),
+                caf::none);
+  index_type w{string_type{}};
+  REQUIRE(load(nullptr, buf, w) == caf::none);
+  CHECK(w.append(make_data_view("foo")));
+}
+
 // The attribute #index=hash selects the hash_index implementation.
 TEST(factory construction and parameterization) {
   factory<value_index>::initialize();
@@ -204,6 +204,13 @@ TEST(attribute extractor - time) {
   CHECK_EQUAL(attr_time_query("00:00:10", "00:00:30"), slice(0, 2));
 }
 
+TEST(upper time bound) {
+  CHECK_EQUAL(meta_idx.upper_bound(ids[0], "timestamp"), epoch + 24s);
+  CHECK_EQUAL(meta_idx.upper_bound(ids[3], "timestamp"), epoch + 99s);
+  CHECK_EQUAL(meta_idx.upper_bound(ids[3], "content"), caf::none);
+  CHECK_EQUAL(meta_idx.upper_bound(uuid::nil(), "timestamp"), caf::none);
+}
+
 TEST(attribute extractor - type) {
   auto foo = std::vector<uuid>{ids[0], ids[2]};
   auto foobar = std::vector<uuid>{ids[1], ids[3]};
@@ -21,11 +21,19 @@
 
 #include <caf/binary_deserializer.hpp>
 #include <caf/binary_serializer.hpp>
+#include <caf/test/dsl.hpp>
 
+#include "vast/compression.hpp"
+#include "vast/concept/parseable/to.hpp"
+#include "vast/concept/parseable/vast/expression.hpp"
+#include "vast/expression.hpp"
 #include "vast/ids.hpp"
 #include "vast/load.hpp"
 #include "vast/table_slice.hpp"
 #include "vast/save.hpp"
+#include "vast/uuid.hpp"
+
+#include <tuple>
 
 using namespace vast;
 
@@ -68,4 +76,188 @@ TEST(serialization) {
                    z->chunk()->begin(), z->chunk()->end()));
 }
 
+TEST(slices outlive their segment) {
+  segment_builder builder;
+  for (auto& slice : zeek_conn_log_slices)
+    REQUIRE(!builder.add(slice));
+  auto x = builder.finish();
+  REQUIRE_NOT_EQUAL(x, nullptr);
+  std::vector<char> buf;
+  REQUIRE_EQUAL(save(nullptr, buf, x), caf::none);
+  x = segment::make(chunk::make(std::move(buf)));
+  REQUIRE_NOT_EQUAL(x, nullptr);
+  auto xs = x->lookup(make_ids({{8, 16}}));
+  REQUIRE(xs);
+  REQUIRE_EQUAL(xs->size(), 1u);
+  MESSAGE("the slice references the segment chunk until decoded");
+  x.reset();
+  CHECK_EQUAL(*xs->front(), *zeek_conn_log_slices[1]);
+}
+
+TEST(extracting located slices) {
+  segment_builder builder;
+  for (auto& slice : zeek_conn_log_slices)
+    REQUIRE(!builder.add(slice));
+  auto x = builder.finish();
+  REQUIRE_NOT_EQUAL(x, nullptr);
+  auto slices = x->locate(make_ids({0, 6, 19, 21}), expression{});
+  REQUIRE_EQUAL(slices, (std::vector<size_t>{0, 2}));
+  auto tombstones = x->tombstones();
+  x->erase(make_ids({{16, 17}}));
+  MESSAGE("extracting ignores erasures after locating");
+  auto xs = unbox(x->extract(slices[1], {}, tombstones));
+  REQUIRE_EQUAL(xs.size(), 1u);
+  CHECK_EQUAL(*xs[0], *zeek_conn_log_slices[2]);
+  MESSAGE("extracting cuts the given tombstones");
+  xs = unbox(x->extract(slices[1], {}, x->tombstones()));
+  REQUIRE_EQUAL(xs.size(), 1u);
+  CHECK_EQUAL(xs[0]->offset(), 17u);
+  CHECK_EQUAL(xs[0]->rows(), 7u);
+}
+
+TEST(compression) {
+  segment_builder builder{compression::lz4};
+  for (auto& slice : zeek_conn_log_slices)
+    REQUIRE(!builder.add(slice));
+  auto x = builder.finish();
+  REQUIRE_NOT_EQUAL(x, nullptr);
+  uint64_t uncompressed_bytes = 0;
+  for (auto& slice : x->meta().slices)
+    uncompressed_bytes += slice.bytes;
+  CHECK_LESS(x->chunk()->size(), uncompressed_bytes);
+  MESSAGE("load compressed segment from chunk");
+  std::vector<char> buf;
+  REQUIRE_EQUAL(save(nullptr, buf, x), caf::none);
+  auto y = segment::make(chunk::make(std::move(buf)));
+  REQUIRE_NOT_EQUAL(y, nullptr);
+  auto xs = y->lookup(make_ids({0, 6, 19, 21}));
+  REQUIRE(xs);
+  auto& slices = *xs;
+  REQUIRE_EQUAL(slices.size(), 2u);
+  CHECK_EQUAL(*slices[0], *zeek_conn_log_slices[0]);
+  CHECK_EQUAL(*slices[1], *zeek_conn_log_slices[2]);
+}
+
+TEST(layout dictionary) {
+  segment_builder builder;
+  for (auto& slice : zeek_conn_log_slices)
+    REQUIRE(!builder.add(slice));
+  auto x = builder.finish();
+  REQUIRE_NOT_EQUAL(x, nullptr);
+  MESSAGE("all slices share a single layout");
+  REQUIRE_EQUAL(x->meta().layouts.size(), 1u);
+  CHECK_EQUAL(x->meta().layouts[0], zeek_conn_log_slices[0]->layout());
+  for (auto& slice : x->meta().slices)
+    CHECK_EQUAL(slice.layout, 0u);
+  MESSAGE("the payload omits the layouts");
+  std::vector<char> full;
+  caf::binary_serializer full_sink{nullptr, full};
+  for (auto slice : zeek_conn_log_slices)
+    REQUIRE_EQUAL(full_sink(slice), caf::none);
+  CHECK_LESS(x->chunk()->size(), full.size());
+  MESSAGE("lookup restores the layouts");
+  std::vector<char> buf;
+  REQUIRE_EQUAL(save(nullptr, buf, x), caf::none);
+  x = segment::make(chunk::make(std::move(buf)));
+  REQUIRE_NOT_EQUAL(x, nullptr);
+  auto xs = x->lookup(make_ids({{8, 24}}));
+  REQUIRE(xs);
+  REQUIRE_EQUAL(xs->size(), 2u);
+  CHECK_EQUAL(*xs->at(0), *zeek_conn_log_slices[1]);
+  CHECK_EQUAL(*xs->at(1), *zeek_conn_log_slices[2]);
+  MESSAGE("skip table slices without matching columns");
+  xs = x->lookup(make_ids({{8, 24}}), expression{}, {"no.such.column"});
+  REQUIRE(xs);
+  CHECK(xs->empty());
+}
+
+TEST(version 1 segments) {
+  MESSAGE("write segment in the format without compression");
+  auto slice = zeek_conn_log_slices[0];
+  std::vector<char> payload;
+  caf::binary_serializer payload_sink{nullptr, payload};
+  REQUIRE_EQUAL(payload_sink(slice), caf::none);
+  auto header = segment_header{segment::magic, 1, uuid::random(), 0};
+  std::vector<std::tuple<int64_t, int64_t, id, uint64_t>> synopses;
+  synopses.emplace_back(0, static_cast<int64_t>(payload.size()),
+                        slice->offset(), slice->rows());
+  std::vector<char> buf;
+  caf::binary_serializer sink{nullptr, buf};
+  REQUIRE_EQUAL(sink(header, synopses, chunk::make(std::move(payload))),
+                caf::none);
+  auto y = segment::make(chunk::make(std::move(buf)));
+  REQUIRE_NOT_EQUAL(y, nullptr);
+  CHECK_EQUAL(y->num_slices(), 1u);
+  auto xs = y->lookup(make_ids({0}));
+  REQUIRE(xs);
+  REQUIRE_EQUAL(xs->size(), 1u);
+  CHECK_EQUAL(*xs->front(), *zeek_conn_log_slices[0]);
+}
+
+TEST(version 2 segments) {
+  MESSAGE("write segment in the format without columnar table slices");
+  auto slice = zeek_conn_log_slices[0];
+  std::vector<char> payload;
+  caf::binary_serializer payload_sink{nullptr, payload};
+  REQUIRE_EQUAL(payload_sink(slice), caf::none);
+  auto header = segment_header{segment::magic, 2, uuid::random(), 0};
+  std::vector<std::tuple<int64_t, int64_t, id, uint64_t, compression,
+                         uint64_t>>
+    synopses;
+  auto size = static_cast<int64_t>(payload.size());
+  synopses.emplace_back(0, size, slice->offset(), slice->rows(),
+                        compression::null, static_cast<uint64_t>(size));
+  std::vector<char> buf;
+  caf::binary_serializer sink{nullptr, buf};
+  REQUIRE_EQUAL(sink(header, synopses, chunk::make(std::move(payload))),
+                caf::none);
+  auto y = segment::make(chunk::make(std::move(buf)));
+  REQUIRE_NOT_EQUAL(y, nullptr);
+  auto xs = y->lookup(make_ids({0}));
+  REQUIRE(xs);
+  REQUIRE_EQUAL(xs->size(), 1u);
+  CHECK_EQUAL(*xs->front(), *zeek_conn_log_slices[0]);
+}
+
+TEST(columnar segments) {
+  segment_builder builder{compression::lz4, true};
+  for (auto& slice : zeek_conn_log_slices)
+    REQUIRE(!builder.add(slice));
+  auto x = builder.finish();
+  REQUIRE_NOT_EQUAL(x, nullptr);
+  CHECK_EQUAL(x->meta().layouts.size(), 1u);
+  for (auto& slice : x->meta().slices)
+    CHECK_EQUAL(slice.columns.size(), zeek_conn_log_slices[0]->columns());
+  std::vector<char> buf;
+  REQUIRE_EQUAL(save(nullptr, buf, x), caf::none);
+  x = segment::make(chunk::make(std::move(buf)));
+  REQUIRE_NOT_EQUAL(x, nullptr);
+  MESSAGE("lookup entire table slices");
+  auto xs = x->lookup(make_ids({0, 6, 19, 21}));
+  REQUIRE(xs);
+  REQUIRE_EQUAL(xs->size(), 2u);
+  CHECK_EQUAL(*xs->at(0), *zeek_conn_log_slices[0]);
+  CHECK_EQUAL(*xs->at(1), *zeek_conn_log_slices[2]);
+  MESSAGE("lookup a single column");
+  auto& expected = zeek_conn_log_slices[1];
+  auto col = resolve_columns(expected->layout(), {"id.orig_h"});
+  REQUIRE_EQUAL(col.size(), 1u);
+  xs = x->lookup(make_ids({{8, 16}}), expression{}, {"id.orig_h"});
+  REQUIRE(xs);
+  REQUIRE_EQUAL(xs->size(), 1u);
+  auto& projected = xs->front();
+  CHECK_EQUAL(projected->offset(), expected->offset());
+  REQUIRE_EQUAL(projected->columns(), 1u);
+  CHECK_EQUAL(projected->layout().fields[0].name, "id.orig_h");
+  for (size_t row = 0; row < expected->rows(); ++row)
+    CHECK_EQUAL(projected->at(row, 0), expected->at(row, col[0]));
+  MESSAGE("skip table slices by their column statistics");
+  auto expr = unbox(to<expression>("ts < 2009-11-18+08:13:20"));
+  xs = x->lookup(make_ids({{0, 20}}), expr, {});
+  REQUIRE(xs);
+  REQUIRE_EQUAL(xs->size(), 2u);
+  CHECK_EQUAL(*xs->at(0), *zeek_conn_log_slices[0]);
+  CHECK_EQUAL(*xs->at(1), *zeek_conn_log_slices[1]);
+}
+
 FIXTURE_SCOPE_END()
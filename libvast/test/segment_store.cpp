@@ -19,14 +19,19 @@
 
 #include "vast/test/fixtures/actor_system_and_events.hpp"
 
+#include "vast/concept/parseable/to.hpp"
+#include "vast/concept/parseable/vast/expression.hpp"
 #include "vast/concept/printable/to_string.hpp"
 #include "vast/concept/printable/vast/uuid.hpp"
 #include "vast/detail/narrow.hpp"
+#include "vast/expression.hpp"
 #include "vast/ids.hpp"
 #include "vast/si_literals.hpp"
 #include "vast/table_slice.hpp"
 #include "vast/to_events.hpp"
 
+#include <fstream>
+
 using namespace vast;
 using namespace binary_byte_literals;
 
@@ -198,6 +203,17 @@ TEST(sessionized extraction on filled segment store) {
   CHECK_EQUAL(val(slices[1]).offset(), 16u);
 }
 
+TEST(caching a single segment) {
+  // Every table slice exceeds the maximum segment size, such that each
+  // segment holds exactly one of them.
+  store = segment_store::make(directory / "tiny-segments", 64, 1);
+  REQUIRE_NOT_EQUAL(store, nullptr);
+  auto segment_id = store->active_id();
+  put({zeek_conn_log_slices[0]});
+  REQUIRE(!store->dirty());
+  CHECK(store->cached(segment_id));
+}
+
 TEST(erase on empty segment store) {
   erase(make_ids({0, 6, 19, 21}));
   auto slices = get(everything);
@@ -301,4 +317,188 @@ TEST(erase slice part from persisted segment) {
   CHECK_SLICE(slices[3], 2, 0);
 }
 
+TEST(erase keeps tombstones across restarts) {
+  auto segment_id = store->active_id();
+  put_cold(zeek_conn_log_slices);
+  erase(make_ids({{10, 14}}));
+  CHECK_EQUAL(segment_files().size(), 1u);
+  CHECK(exists(store->tombstone_path() / to_string(segment_id)));
+  MESSAGE("erase the same events again");
+  erase(make_ids({{10, 14}}));
+  MESSAGE("restart the store");
+  store = nullptr;
+  store = segment_store::make(directory / "segments", 512_KiB, 2);
+  REQUIRE_NOT_EQUAL(store, nullptr);
+  auto slices = get(everything);
+  REQUIRE_EQUAL(slices.size(), 4u);
+  CHECK_SLICE(slices[0], 0, 0);
+  CHECK_SLICE(slices[1], 1, 0, 2);
+  CHECK_SLICE(slices[2], 1, 6, 2);
+  CHECK_SLICE(slices[3], 2, 0);
+}
+
+TEST(erase remaining events of tombstoned segment) {
+  auto tombstone_file = store->tombstone_path() / to_string(store->active_id());
+  put_cold(zeek_conn_log_slices);
+  erase(make_ids({{0, 10}}));
+  CHECK(exists(tombstone_file));
+  erase(make_ids({{10, 20}}));
+  CHECK_EQUAL(get(everything).size(), 0u);
+  CHECK(!exists(tombstone_file));
+  store = nullptr;
+  CHECK_EQUAL(segment_files().size(), 0u);
+}
+
+TEST(compaction) {
+  auto segment_id = store->active_id();
+  put_hot(zeek_conn_log_slices);
+  erase(make_ids({{8, 16}}));
+  MESSAGE("compaction skips segments below the threshold");
+  CHECK_EQUAL(unbox(store->compact(0.5)), false);
+  CHECK(exists(store->tombstone_path() / to_string(segment_id)));
+  MESSAGE("compaction rewrites segments above the threshold");
+  CHECK_EQUAL(unbox(store->compact(0.4)), false);
+  CHECK(!exists(store->tombstone_path() / to_string(segment_id)));
+  CHECK_EQUAL(store->cached(segment_id), false);
+  auto slices = get(everything);
+  REQUIRE_EQUAL(slices.size(), 2u);
+  CHECK_SLICE(slices[0], 0, 0);
+  CHECK_SLICE(slices[1], 2, 0);
+  store = nullptr;
+  CHECK_EQUAL(segment_files().size(), 1u);
+}
+
+TEST(erase during extraction) {
+  put_cold({zeek_conn_log_slices[0]});
+  put_cold({zeek_conn_log_slices[1], zeek_conn_log_slices[2]});
+  auto session = store->extract(everything);
+  auto first = unbox(session->next());
+  CHECK_SLICE(first, 0, 0);
+  MESSAGE("erase from the segment that the session reads ahead");
+  erase(make_ids({{8, 16}}));
+  std::vector<table_slice_ptr> slices;
+  for (auto x = session->next(); x.engaged(); x = session->next())
+    slices.emplace_back(unbox(x));
+  REQUIRE_EQUAL(slices.size(), 1u);
+  CHECK_SLICE(slices[0], 2, 0);
+}
+
+TEST(compaction during extraction) {
+  put_cold({zeek_conn_log_slices[0]});
+  put_cold({zeek_conn_log_slices[1], zeek_conn_log_slices[2]});
+  erase(make_ids({{8, 16}}));
+  auto session = store->extract(everything);
+  auto first = unbox(session->next());
+  CHECK_SLICE(first, 0, 0);
+  MESSAGE("compact the segment that the session reads ahead");
+  CHECK_EQUAL(unbox(store->compact(0.5)), false);
+  std::vector<table_slice_ptr> slices;
+  for (auto x = session->next(); x.engaged(); x = session->next())
+    slices.emplace_back(unbox(x));
+  REQUIRE_EQUAL(slices.size(), 1u);
+  CHECK_SLICE(slices[0], 2, 0);
+}
+
+TEST(rewriting the active segment during extraction) {
+  put({zeek_conn_log_slices[0], zeek_conn_log_slices[1]});
+  auto session = store->extract(everything);
+  MESSAGE("erasing gives the active segment a new ID");
+  auto segment_id = store->active_id();
+  erase(make_ids({{4, 12}}));
+  CHECK_NOT_EQUAL(store->active_id(), segment_id);
+  std::vector<table_slice_ptr> slices;
+  for (auto x = session->next(); x.engaged(); x = session->next())
+    slices.emplace_back(unbox(x));
+  REQUIRE_EQUAL(slices.size(), 2u);
+  CHECK_SLICE(slices[0], 0, 0, 4);
+  CHECK_SLICE(slices[1], 1, 4);
+}
+
+TEST(stale tombstones) {
+  auto tombstone_file = store->tombstone_path() / to_string(uuid::random());
+  put_cold(zeek_conn_log_slices);
+  erase(make_ids({{10, 14}}));
+  REQUIRE(exists(store->tombstone_path()));
+  {
+    std::ofstream out{tombstone_file.str()};
+    out << "stale";
+  }
+  MESSAGE("restarting removes tombstones of unknown segments");
+  store = nullptr;
+  store = segment_store::make(directory / "segments", 512_KiB, 2);
+  REQUIRE_NOT_EQUAL(store, nullptr);
+  CHECK(!exists(tombstone_file));
+  CHECK_EQUAL(get(everything).size(), 4u);
+}
+
+TEST(failing to persist tombstones) {
+  put_cold(zeek_conn_log_slices);
+  MESSAGE("block the directory for deletion bitmaps with a file");
+  {
+    std::ofstream out{store->tombstone_path().str()};
+    out << "blocked";
+  }
+  CHECK_NOT_EQUAL(store->erase(make_ids({{10, 14}})), caf::none);
+  auto slices = get(everything);
+  REQUIRE_EQUAL(slices.size(), 3u);
+  CHECK_SLICE(slices[1], 1, 0);
+}
+
+TEST(meta data journal) {
+  put_cold({zeek_conn_log_slices[0]});
+  put_cold({zeek_conn_log_slices[1], zeek_conn_log_slices[2]});
+  CHECK(exists(store->journal_path()));
+  CHECK(!exists(store->meta_path()));
+  erase(make_ids({{0, 8}}));
+  CHECK_EQUAL(segment_files().size(), 1u);
+  MESSAGE("restart the store");
+  store = nullptr;
+  store = segment_store::make(directory / "segments", 512_KiB, 2);
+  REQUIRE_NOT_EQUAL(store, nullptr);
+  CHECK(!exists(store->journal_path()));
+  CHECK(exists(store->meta_path()));
+  auto slices = get(everything);
+  REQUIRE_EQUAL(slices.size(), 2u);
+  CHECK_SLICE(slices[0], 1, 0);
+  CHECK_SLICE(slices[1], 2, 0);
+  MESSAGE("restart the store with a truncated journal");
+  store = nullptr;
+  {
+    std::ofstream journal{(directory / "segments" / "journal").str(),
+                          std::ios::binary | std::ios::app};
+    journal.put('\0');
+  }
+  store = segment_store::make(directory / "segments", 512_KiB, 2);
+  REQUIRE_NOT_EQUAL(store, nullptr);
+  CHECK(!exists(store->journal_path()));
+  slices = get(everything);
+  REQUIRE_EQUAL(slices.size(), 2u);
+  CHECK_SLICE(slices[0], 1, 0);
+  CHECK_SLICE(slices[1], 2, 0);
+}
+
+TEST(projected extraction on columnar segment store) {
+  store = segment_store::make(directory / "columnar", 512_KiB, 2,
+                              compression::null, true);
+  REQUIRE_NOT_EQUAL(store, nullptr);
+  put_cold(zeek_conn_log_slices);
+  MESSAGE("extract a single column");
+  auto session = store->extract(make_ids({0, 6, 19, 21}), expression{},
+                                {"id.orig_h"});
+  std::vector<table_slice_ptr> slices;
+  for (auto x = session->next(); x.engaged(); x = session->next())
+    slices.emplace_back(unbox(x));
+  REQUIRE_EQUAL(slices.size(), 2u);
+  for (auto& slice : slices) {
+    REQUIRE_EQUAL(val(slice).columns(), 1u);
+    CHECK_EQUAL(slice->layout().fields[0].name, "id.orig_h");
+  }
+  MESSAGE("skip table slices by their column statistics");
+  auto expr = unbox(to<expression>("ts < 2009-11-18+08:13:20"));
+  slices = unbox(store->get(everything, expr, {}));
+  REQUIRE_EQUAL(slices.size(), 2u);
+  CHECK_EQUAL(val(slices[0]), val(zeek_conn_log_slices[0]));
+  CHECK_EQUAL(val(slices[1]), val(zeek_conn_log_slices[1]));
+}
+
 FIXTURE_SCOPE_END()
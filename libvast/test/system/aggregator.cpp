@@ -0,0 +1,154 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+#define SUITE aggregator
+
+#include "vast/system/aggregator.hpp"
+
+#include "vast/test/fixtures/actor_system_and_events.hpp"
+#include "vast/test/test.hpp"
+
+#include "vast/aggregation.hpp"
+#include "vast/concept/parseable/to.hpp"
+#include "vast/concept/parseable/vast/expression.hpp"
+#include "vast/defaults.hpp"
+#include "vast/detail/spawn_container_source.hpp"
+#include "vast/error.hpp"
+#include "vast/system/archive.hpp"
+#include "vast/system/archive_worker.hpp"
+#include "vast/system/atoms.hpp"
+#include "vast/system/index.hpp"
+
+#include <caf/actor_system.hpp>
+#include <caf/event_based_actor.hpp>
+#include <caf/stateful_actor.hpp>
+
+using namespace vast;
+using namespace system;
+
+using vast::expression;
+using vast::system::run_atom;
+
+namespace {
+
+struct mock_client_state {
+  caf::optional<aggregation> result;
+  static inline constexpr const char* name = "mock-client";
+};
+
+using mock_client_actor = caf::stateful_actor<mock_client_state>;
+
+caf::behavior mock_client(mock_client_actor* self) {
+  return {[=](aggregation& x) {
+    CHECK(!self->state.result);
+    self->state.result = std::move(x);
+  }};
+}
+
+// Fails to aggregate any table slice.
+system::archive_worker_type::behavior_type failing_worker() {
+  auto fail = [] { return make_error(ec::unspecified, "mock worker failure"); };
+  using reader = vast::store::lookup::reader;
+  return {[=](reader&, const ids&, table_slice_receiver_type&)
+            -> caf::result<uint64_t> { return fail(); },
+          [=](reader&, const ids&, const std::vector<std::string>&,
+              table_slice_receiver_type&) -> caf::result<uint64_t> {
+            return fail();
+          },
+          [=](reader&, const ids&, const expression&,
+              aggregation&) -> caf::result<aggregation> { return fail(); }};
+}
+
+using archive_actor = std::remove_pointer_t<
+  system::archive_type::stateful_pointer<system::archive_state>>;
+
+struct fixture : fixtures::deterministic_actor_system_and_events {
+  fixture() {
+    MESSAGE("spawn INDEX ingest 4 slices with 100 rows (= 1 partition) each");
+    index = self->spawn(system::index, directory / "index",
+                        defaults::system::table_slice_size, 100, 3, 1);
+    archive = self->spawn(system::archive, directory / "archive",
+                          defaults::system::segments,
+                          defaults::system::max_segment_size,
+                          compression::null);
+    client = sys.spawn(mock_client);
+    // Fill the INDEX with 400 rows from the Zeek conn log.
+    detail::spawn_container_source(sys, take(zeek_full_conn_log_slices, 4),
+                                   index);
+    // Fill the ARCHIVE with only 300 rows from the Zeek conn log.
+    detail::spawn_container_source(sys, take(zeek_full_conn_log_slices, 3),
+                                   archive);
+    run();
+  }
+
+  ~fixture() {
+    self->send_exit(aut, caf::exit_reason::user_shutdown);
+    self->send_exit(index, caf::exit_reason::user_shutdown);
+  }
+
+  void spawn_aut(std::string_view query, aggregation spec) {
+    aut = sys.spawn(aggregator, unbox(to<expression>(query)), std::move(spec),
+                    index, archive);
+    run();
+    anon_send(aut, run_atom::value, client);
+    sched.run_once();
+  }
+
+  caf::actor index;
+  system::archive_type archive;
+  caf::actor client;
+  caf::actor aut;
+};
+
+} // namespace
+
+FIXTURE_SCOPE(aggregator_tests, fixture)
+
+TEST(count per service for IP point query) {
+  MESSAGE("spawn the AGGREGATOR for query ':addr == 192.168.1.104'");
+  auto count = unbox(make_aggregate("count"));
+  spawn_aut(":addr == 192.168.1.104", aggregation{{"service"}, {count}});
+  expect((expression), from(aut).to(index));
+  run();
+  auto& result = deref<mock_client_actor>(client).state.result;
+  REQUIRE(result);
+  CHECK(!result->groups().empty());
+  // The ARCHIVE contains 105 matching rows, as for the COUNTER.
+  vast::count total = 0;
+  for (auto& [key, values] : result->groups()) {
+    CHECK_EQUAL(key.size(), 1u);
+    total += caf::get<vast::count>(values[0]);
+  }
+  CHECK_EQUAL(total, 105u);
+}
+
+TEST(ARCHIVE failure) {
+  MESSAGE("let the workers of the ARCHIVE fail");
+  auto& st = deref<archive_actor>(archive).state;
+  for (auto& worker : st.workers)
+    self->send_exit(worker, caf::exit_reason::user_shutdown);
+  st.workers = {sys.spawn(failing_worker)};
+  auto count = unbox(make_aggregate("count"));
+  spawn_aut(":addr == 192.168.1.104", aggregation{{"service"}, {count}});
+  self->monitor(aut);
+  expect((expression), from(aut).to(index));
+  run();
+  MESSAGE("the AGGREGATOR terminates with the error and without a result");
+  CHECK(!deref<mock_client_actor>(client).state.result);
+  self->receive([&](caf::down_msg& msg) {
+    CHECK_EQUAL(msg.source, aut.address());
+    CHECK_EQUAL(msg.reason, ec::unspecified);
+  });
+}
+
+FIXTURE_SCOPE_END()
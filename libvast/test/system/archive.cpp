@@ -11,15 +11,24 @@
  * contained in the LICENSE file.                                             *
  ******************************************************************************/
 
+#include "vast/aggregation.hpp"
+#include "vast/chunk.hpp"
 #include "vast/concept/printable/stream.hpp"
 #include "vast/concept/printable/vast/event.hpp"
+#include "vast/default_table_slice.hpp"
 #include "vast/ids.hpp"
+#include "vast/error.hpp"
+#include "vast/expression.hpp"
+#include "vast/store.hpp"
 #include "vast/system/archive.hpp"
+#include "vast/system/archive_worker.hpp"
 #include "vast/table_slice.hpp"
 #include "vast/to_events.hpp"
 
 #include "vast/detail/spawn_container_source.hpp"
 
+#include <caf/binary_serializer.hpp>
+
 #define SUITE archive
 #include "vast/test/test.hpp"
 #include "vast/test/fixtures/actor_system_and_events.hpp"
@@ -29,11 +38,48 @@ using namespace vast;
 
 namespace {
 
+struct mock_worker_state {
+  size_t slices = 0;
+  static inline constexpr const char* name = "mock-worker";
+};
+
+using mock_worker_pointer
+  = system::archive_worker_type::stateful_pointer<mock_worker_state>;
+
+using mock_worker_actor = std::remove_pointer_t<mock_worker_pointer>;
+
+// Counts the table slices it receives without shipping any rows, and fails
+// if requested.
+system::archive_worker_type::behavior_type
+mock_worker(mock_worker_pointer self, bool fail) {
+  auto process = [=](auto x) -> caf::result<decltype(x)> {
+    ++self->state.slices;
+    if (fail)
+      return make_error(ec::unspecified, "mock worker failure");
+    return x;
+  };
+  using reader = vast::store::lookup::reader;
+  return {[=](reader&, const ids&, system::table_slice_receiver_type&) {
+            return process(uint64_t{0});
+          },
+          [=](reader&, const ids&, const std::vector<std::string>&,
+              system::table_slice_receiver_type&) {
+            return process(uint64_t{0});
+          },
+          [=](reader&, const ids&, const expression&, aggregation& x) {
+            return process(std::move(x));
+          }};
+}
+
+using archive_actor = std::remove_pointer_t<
+  system::archive_type::stateful_pointer<system::archive_state>>;
+
 struct fixture : fixtures::deterministic_actor_system_and_events {
   system::archive_type a;
 
   fixture() {
-    a = self->spawn(system::archive, directory, 10, 1024 * 1024);
+    a = self->spawn(system::archive, directory, 10, 1024 * 1024,
+                    compression::lz4);
     self->send(a, system::exporter_atom::value, self);
   }
 
@@ -63,6 +109,40 @@ struct fixture : fixtures::deterministic_actor_system_and_events {
   std::vector<event> query(std::initializer_list<id_range> ranges) {
     return query(make_ids(ranges));
   }
+
+  system::archive_state& state() {
+    return deref<archive_actor>(a).state;
+  }
+
+  // Replaces the workers of the ARCHIVE.
+  void replace_workers(std::vector<system::archive_worker_type> xs) {
+    auto& st = state();
+    for (auto& worker : st.workers)
+      self->send_exit(worker, exit_reason::user_shutdown);
+    st.workers = std::move(xs);
+    st.next_worker = 0;
+  }
+
+  // Collects the pending table slices, row counts, aggregations, and
+  // completions.
+  void collect() {
+    bool running = true;
+    self->receive_while(running)(
+      [&](vast::system::done_atom, caf::error& err) {
+        completed = true;
+        result = std::move(err);
+      },
+      [&](table_slice_ptr slice) { received.push_back(std::move(slice)); },
+      [&](uint64_t n) { shipped += n; },
+      [&](aggregation&) { ++aggregations; },
+      after(std::chrono::seconds(0)) >> [&] { running = false; });
+  }
+
+  std::vector<table_slice_ptr> received;
+  uint64_t shipped = 0;
+  size_t aggregations = 0;
+  bool completed = false;
+  caf::error result;
 };
 
 } // namespace <anonymous>
@@ -102,4 +182,144 @@ TEST(archiving and querying) {
   self->send_exit(a, exit_reason::user_shutdown);
 }
 
+TEST(credit-based delivery) {
+  push_to_archive(ascending_integers_slices);
+  auto first = ascending_integers_slices[0]->offset();
+  auto xs = make_ids({{first, first + 160}});
+  MESSAGE("grant credit for a single row");
+  self->send(a, system::credit_atom::value, uint64_t{1});
+  self->send(a, xs);
+  run();
+  size_t rows = 0;
+  bool done = false;
+  auto fetch = [&] {
+    bool running = true;
+    self->receive_while(running)(
+      [&](vast::system::done_atom, const caf::error& err) {
+        REQUIRE(!err);
+        done = true;
+      },
+      [&](table_slice_ptr slice) { rows += slice->rows(); },
+      after(std::chrono::seconds(0)) >> [&] { running = false; });
+  };
+  fetch();
+  // The workers may overdraw the credit by the slices they have in flight.
+  CHECK_GREATER(rows, 0u);
+  CHECK_LESS(rows, 160u);
+  CHECK(!done);
+  MESSAGE("grant credit for the remaining rows");
+  self->send(a, system::credit_atom::value, uint64_t{1000});
+  run();
+  fetch();
+  CHECK_EQUAL(rows, 160u);
+  CHECK(done);
+  self->send_exit(a, exit_reason::user_shutdown);
+}
+
+TEST(archive worker) {
+  auto worker = sys.spawn(system::archive_worker);
+  auto receiver = actor_cast<system::table_slice_receiver_type>(self);
+  auto& slice = zeek_conn_log_slices[1];
+  auto read = [](table_slice_ptr x) -> vast::store::lookup::reader {
+    return [=]() -> caf::expected<std::vector<table_slice_ptr>> {
+      return std::vector<table_slice_ptr>{x};
+    };
+  };
+  MESSAGE("select rows of a table slice");
+  self->send(worker, read(slice), make_ids({{10, 13}}), receiver);
+  run();
+  collect();
+  CHECK_EQUAL(shipped, 3u);
+  REQUIRE_EQUAL(received.size(), 1u);
+  CHECK_EQUAL(received[0]->offset(), 10u);
+  CHECK_EQUAL(received[0]->rows(), 3u);
+  MESSAGE("project the selected rows onto a field");
+  received.clear();
+  shipped = 0;
+  self->send(worker, read(slice), make_ids({{10, 13}}),
+             std::vector<std::string>{"id.orig_h"}, receiver);
+  run();
+  collect();
+  CHECK_EQUAL(shipped, 3u);
+  REQUIRE_EQUAL(received.size(), 1u);
+  CHECK_EQUAL(received[0]->columns(), 1u);
+  CHECK_EQUAL(received[0]->at(0, 0), slice->at(2, 2));
+  MESSAGE("fail on table slices that do not decode");
+  received.clear();
+  std::vector<char> buf;
+  caf::binary_serializer sink{nullptr, buf};
+  REQUIRE_EQUAL(slice->serialize(sink), caf::none);
+  buf.resize(buf.size() / 2);
+  auto corrupt = default_table_slice::make(slice->header());
+  REQUIRE_EQUAL(corrupt.unshared().load(chunk::make(std::move(buf))),
+                caf::none);
+  self->send(worker, read(corrupt), make_ids({{10, 13}}), receiver);
+  run();
+  bool failed = false;
+  self->receive([&](const caf::error& err) { failed = err != caf::none; },
+                after(std::chrono::seconds(0)) >> [] {});
+  CHECK(failed);
+  collect();
+  CHECK(received.empty());
+  self->send_exit(worker, exit_reason::user_shutdown);
+  self->send_exit(a, exit_reason::user_shutdown);
+}
+
+TEST(round-robin dispatch) {
+  push_to_archive(zeek_conn_log_slices);
+  auto w1 = sys.spawn(mock_worker, false);
+  auto w2 = sys.spawn(mock_worker, false);
+  replace_workers({w1, w2});
+  self->send(a, make_ids({{0, 20}}));
+  MESSAGE("keep at most as many slices in flight as there are workers");
+  while (sched.run_once())
+    for (auto& x : state().sessions)
+      CHECK_LESS_EQUAL(x.in_flight, 2u);
+  collect();
+  CHECK(completed);
+  CHECK(!result);
+  CHECK(state().sessions.empty());
+  MESSAGE("hand the 3 slices to alternating workers");
+  CHECK_EQUAL(deref<mock_worker_actor>(w1).state.slices, 2u);
+  CHECK_EQUAL(deref<mock_worker_actor>(w2).state.slices, 1u);
+  self->send_exit(a, exit_reason::user_shutdown);
+}
+
+TEST(worker failure) {
+  push_to_archive(zeek_conn_log_slices);
+  auto w1 = sys.spawn(mock_worker, true);
+  auto w2 = sys.spawn(mock_worker, false);
+  replace_workers({w1, w2});
+  self->send(a, make_ids({{0, 20}}));
+  run();
+  collect();
+  MESSAGE("the lookup fails with the error of the worker");
+  CHECK(completed);
+  CHECK_EQUAL(result, ec::unspecified);
+  CHECK(state().sessions.empty());
+  // The second slice was in flight when the first one failed, but the
+  // lookup extracts no third slice.
+  CHECK_EQUAL(deref<mock_worker_actor>(w1).state.slices, 1u);
+  CHECK_EQUAL(deref<mock_worker_actor>(w2).state.slices, 1u);
+  self->send_exit(a, exit_reason::user_shutdown);
+}
+
+TEST(aggregation with an untailorable expression) {
+  push_to_archive(zeek_conn_log_slices);
+  auto& layout = zeek_conn_log_slices[0]->layout();
+  // The compiled expressions of the workers support no nested fields.
+  auto expr = expression{
+    predicate{data_extractor{layout, offset{0, 0}}, equal, data{count{0}}}};
+  self->send(a, make_ids({{0, 20}}), expr,
+             aggregation{{}, {aggregate{aggregate_function::count, {}}}});
+  run();
+  collect();
+  MESSAGE("the lookup fails instead of skipping the slice");
+  CHECK(completed);
+  CHECK_EQUAL(result, ec::invalid_query);
+  CHECK_EQUAL(aggregations, 0u);
+  CHECK(state().sessions.empty());
+  self->send_exit(a, exit_reason::user_shutdown);
+}
+
 FIXTURE_SCOPE_END()
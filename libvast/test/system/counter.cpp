@@ -18,14 +18,17 @@
 #include "vast/test/fixtures/actor_system_and_events.hpp"
 #include "vast/test/test.hpp"
 
+#include "vast/aliases.hpp"
 #include "vast/concept/parseable/to.hpp"
 #include "vast/concept/parseable/vast/expression.hpp"
 #include "vast/concept/parseable/vast/uuid.hpp"
+#include "vast/default_table_slice_builder.hpp"
 #include "vast/defaults.hpp"
 #include "vast/detail/spawn_container_source.hpp"
 #include "vast/ids.hpp"
 #include "vast/system/archive.hpp"
 #include "vast/system/atoms.hpp"
+#include "vast/system/enumerator.hpp"
 #include "vast/system/index.hpp"
 #include "vast/table_slice.hpp"
 #include "vast/uuid.hpp"
@@ -41,6 +44,7 @@ using vast::expression;
 using vast::ids;
 using vast::make_ids;
 using vast::uuid;
+using vast::system::distinct_atom;
 using vast::system::done_atom;
 using vast::system::erase_atom;
 using vast::system::run_atom;
@@ -49,6 +53,7 @@ namespace {
 
 struct mock_client_state {
   uint64_t count = 0;
+  value_counts distinct;
   bool received_done = false;
   static inline constexpr const char* name = "mock-client";
 };
@@ -60,6 +65,10 @@ caf::behavior mock_client(mock_client_actor* self) {
             CHECK(!self->state.received_done);
             self->state.count += x;
           },
+          [=](value_counts& xs) {
+            CHECK(!self->state.received_done);
+            self->state.distinct = std::move(xs);
+          },
           [=](done_atom) { self->state.received_done = true; }};
 }
 
@@ -71,7 +80,8 @@ struct fixture : fixtures::deterministic_actor_system_and_events {
                         defaults::system::table_slice_size, 100, 3, 1);
     archive = self->spawn(system::archive, directory / "archive",
                           defaults::system::segments,
-                          defaults::system::max_segment_size);
+                          defaults::system::max_segment_size,
+                          compression::null);
     client = sys.spawn(mock_client);
     // Fill the INDEX with 400 rows from the Zeek conn log.
     detail::spawn_container_source(sys, take(zeek_full_conn_log_slices, 4),
@@ -88,11 +98,12 @@ struct fixture : fixtures::deterministic_actor_system_and_events {
   }
 
   // @pre index != nullptr
-  void spawn_aut(std::string_view query, bool skip_candidate_check) {
+  void spawn_aut(std::string_view query, bool skip_candidate_check,
+                 std::string distinct_key = {}) {
     if (index == nullptr)
       FAIL("cannot start AUT without INDEX");
     aut = sys.spawn(counter, unbox(to<expression>(query)), index, archive,
-                    skip_candidate_check);
+                    skip_candidate_check, std::move(distinct_key));
     run();
     anon_send(aut, run_atom::value, client);
     sched.run_once();
@@ -140,4 +151,72 @@ TEST(count IP point query with candidate check) {
   CHECK_EQUAL(client_state.received_done, true);
 }
 
+TEST(count distinct ports of IP point query) {
+  MESSAGE("spawn the COUNTER for distinct values of 'id.resp_p'");
+  spawn_aut(":addr == 192.168.1.104", true, "id.resp_p");
+  expect((distinct_atom, expression, std::string), from(aut).to(index));
+  run();
+  // The distinct counts come straight from the INDEX and therefore add up to
+  // the number of index hits.
+  auto& client_state = deref<mock_client_actor>(client).state;
+  CHECK(!client_state.distinct.empty());
+  auto total = count{0};
+  for (auto& [value, n] : client_state.distinct) {
+    CHECK(caf::holds_alternative<port>(value));
+    total += n;
+  }
+  CHECK_EQUAL(total, 133u);
+  CHECK_EQUAL(client_state.received_done, true);
+}
+
+TEST(distinct counts fail on INDEX errors) {
+  MESSAGE("spawn an ENUMERATOR whose INDEX fails to provide partitions");
+  auto failing_index = sys.spawn([]() -> caf::behavior {
+    return {
+      [](distinct_atom, const expression&, const std::vector<uuid>&,
+         const std::string&)
+        -> caf::result<std::vector<caf::actor>, std::vector<caf::actor>> {
+        return make_error(ec::unspecified, "failed to load partitions");
+      },
+    };
+  });
+  auto expr = unbox(to<expression>(":addr == 192.168.1.104"));
+  auto hdl = sys.spawn(enumerator, failing_index, expr, "id.resp_p",
+                       std::vector{uuid::random(), uuid::random()}, 1u);
+  caf::error result;
+  sys.spawn([&](caf::event_based_actor* client) {
+    client->request(hdl, caf::infinite, run_atom::value)
+      .then([&](value_counts&) { FAIL("ENUMERATOR ignored the error"); },
+            [&](const caf::error& err) { result = err; });
+  });
+  run();
+  CHECK_EQUAL(result, ec::unspecified);
+}
+
+TEST(count real point query with adaptive binning) {
+  MESSAGE("ingest 4 rows into a column that bins after sampling 2 values");
+  auto t = real_type{}.attributes({{"index", "adaptive"},
+                                   {"binning-sample", "2"}});
+  auto layout = record_type{{"x", t}}.name("adaptive");
+  auto builder = default_table_slice_builder::make(layout);
+  // The sample chooses one fractional digit, so 1.52 shares the bucket of
+  // 1.5 and the INDEX reports it as a hit for 'x == 1.5'.
+  for (auto x : {1.5, 2.5, 1.52, 1.5})
+    CHECK(builder->add(make_data_view(x)));
+  auto slice = builder->finish();
+  REQUIRE(slice != nullptr);
+  slice.unshared().offset(400);
+  detail::spawn_container_source(sys, std::vector{slice}, index);
+  detail::spawn_container_source(sys, std::vector{slice}, archive);
+  run();
+  MESSAGE("spawn the COUNTER for query 'x == 1.5'");
+  spawn_aut("x == 1.5", false);
+  expect((expression), from(aut).to(index));
+  run();
+  // The candidate check filters the other value of the bucket.
+  auto& client_state = deref<mock_client_actor>(client).state;
+  CHECK_EQUAL(client_state.count, 2u);
+  CHECK_EQUAL(client_state.received_done, true);
+}
+
 FIXTURE_SCOPE_END()
@@ -34,6 +34,7 @@ using namespace caf;
 using namespace vast;
 
 using std::string;
+using std::string_literals::operator""s;
 using std::chrono_literals::operator""ms;
 
 namespace {
@@ -59,7 +60,8 @@ struct fixture : fixture_base {
   }
 
   void spawn_archive() {
-    archive = self->spawn(system::archive, directory / "archive", 1, 1024);
+    archive = self->spawn(system::archive, directory / "archive", 1, 1024,
+                          compression::null);
   }
 
   void spawn_importer() {
@@ -71,8 +73,9 @@ struct fixture : fixture_base {
     consensus = self->spawn(system::dummy_consensus, directory / "consensus");
   }
 
-  void spawn_exporter(query_options opts) {
-    exporter = self->spawn(system::exporter, expr, opts);
+  void spawn_exporter(query_options opts,
+                      std::vector<std::string> fields = {}) {
+    exporter = self->spawn(system::exporter, expr, opts, std::move(fields));
   }
 
   void importer_setup() {
@@ -87,8 +90,9 @@ struct fixture : fixture_base {
     run();
   }
 
-  void exporter_setup(query_options opts) {
-    spawn_exporter(opts);
+  void exporter_setup(query_options opts,
+                      std::vector<std::string> fields = {}) {
+    spawn_exporter(opts, std::move(fields));
     send(exporter, archive);
     send(exporter, system::index_atom::value, index);
     send(exporter, system::sink_atom::value, self);
@@ -168,6 +172,86 @@ TEST(historical query with importer) {
   CHECK_EQUAL(results.back().id(), 19u);
 }
 
+TEST(historical query with projection) {
+  MESSAGE("spawn index and archive");
+  spawn_index();
+  spawn_archive();
+  run();
+  MESSAGE("ingest conn.log into archive and index");
+  vast::detail::spawn_container_source(sys, zeek_conn_log_slices, index,
+                                       archive);
+  run();
+  MESSAGE("project in the exporter for type extractors");
+  exporter_setup(historical, {"ts", "id.orig_h"});
+  auto results = fetch_results();
+  REQUIRE_EQUAL(results.size(), 5u);
+  std::sort(results.begin(), results.end());
+  CHECK_EQUAL(results.front().id(), 10u);
+  CHECK_EQUAL(results.back().id(), 19u);
+  for (auto& x : results) {
+    auto& layout = caf::get<record_type>(x.type());
+    CHECK_EQUAL(layout.name(), "zeek.conn");
+    REQUIRE_EQUAL(layout.fields.size(), 2u);
+    CHECK_EQUAL(layout.fields[0].name, "ts");
+    CHECK_EQUAL(layout.fields[1].name, "id.orig_h");
+  }
+  MESSAGE("push the projection down to the archive for key extractors");
+  self->send_exit(exporter, exit_reason::user_shutdown);
+  expr = unbox(to<expression>("service == \"dns\" "
+                              "&& id.resp_h == 192.168.1.1"));
+  exporter_setup(historical);
+  auto expected = fetch_results();
+  std::sort(expected.begin(), expected.end());
+  self->send_exit(exporter, exit_reason::user_shutdown);
+  exporter_setup(historical, {"uid"});
+  results = fetch_results();
+  std::sort(results.begin(), results.end());
+  REQUIRE_EQUAL(results.size(), expected.size());
+  for (size_t i = 0; i < results.size(); ++i) {
+    CHECK_EQUAL(results[i].id(), expected[i].id());
+    auto& layout = caf::get<record_type>(results[i].type());
+    REQUIRE_EQUAL(layout.fields.size(), 1u);
+    CHECK_EQUAL(layout.fields[0].name, "uid");
+  }
+}
+
+TEST(historical query sorted by time) {
+  MESSAGE("spawn index and archive");
+  spawn_index();
+  spawn_archive();
+  run();
+  MESSAGE("ingest conn.log into archive and index");
+  vast::detail::spawn_container_source(sys, zeek_conn_log_slices, index,
+                                       archive);
+  run();
+  auto ts = [](const event& x) {
+    return caf::get<vast::time>(caf::get<vector>(x.data())[0]);
+  };
+  MESSAGE("fetch all results");
+  exporter_setup(historical);
+  auto expected = fetch_results();
+  REQUIRE_EQUAL(expected.size(), 5u);
+  std::sort(expected.begin(), expected.end(),
+            [&](auto& x, auto& y) { return ts(x) > ts(y); });
+  expected.resize(3);
+  self->send_exit(exporter, exit_reason::user_shutdown);
+  MESSAGE("fetch the latest results");
+  spawn_exporter(historical);
+  send(exporter, system::limit_atom::value, "ts"s, uint64_t{3});
+  send(exporter, archive);
+  send(exporter, system::index_atom::value, index);
+  send(exporter, system::sink_atom::value, self);
+  send(exporter, system::run_atom::value);
+  send(exporter, system::extract_atom::value);
+  run();
+  auto results = fetch_results();
+  REQUIRE_EQUAL(results.size(), 3u);
+  for (size_t i = 0; i < results.size(); ++i) {
+    CHECK_EQUAL(results[i].id(), expected[i].id());
+    CHECK_EQUAL(ts(results[i]), ts(expected[i]));
+  }
+}
+
 TEST(continuous query with exporter only) {
   MESSAGE("prepare exporter for continuous query");
   spawn_exporter(continuous);
@@ -20,11 +20,15 @@
 
 #include "vast/concept/parseable/to.hpp"
 #include "vast/concept/parseable/vast/expression.hpp"
+#include "vast/concept/parseable/vast/time.hpp"
 #include "vast/concept/printable/std/chrono.hpp"
 #include "vast/concept/printable/to_string.hpp"
 #include "vast/concept/printable/vast/event.hpp"
+#include "vast/concept/printable/vast/uuid.hpp"
 #include "vast/default_table_slice.hpp"
 #include "vast/event.hpp"
+#include "vast/expression.hpp"
+#include "vast/filesystem.hpp"
 #include "vast/ids.hpp"
 #include "vast/query_options.hpp"
 #include "vast/system/atoms.hpp"
@@ -221,4 +225,33 @@ TEST(iterable zeek conn log query result) {
   }
 }
 
+TEST(retention) {
+  MESSAGE("ingest conn.log slices");
+  detail::spawn_container_source(sys, zeek_conn_log_slices, index);
+  run();
+  REQUIRE(state().unpersisted.empty());
+  auto cutoff = unbox(to<time>("2009-11-18+08:13:20"));
+  auto expr = unbox(to<expression>("#timestamp < 2009-11-18+08:13:20"));
+  MESSAGE("query all events older than the cutoff");
+  auto [query_id, hits, scheduled] = query("#timestamp < 2009-11-18+08:13:20");
+  auto expected_result = receive_result(query_id, hits, scheduled);
+  CHECK_EQUAL(rank(expected_result), 9u);
+  auto candidates = state().meta_idx.lookup(expr);
+  REQUIRE_EQUAL(candidates.size(), 2u);
+  MESSAGE("drop all events older than the cutoff");
+  ids result;
+  self->send(index, system::erase_atom::value, cutoff);
+  run();
+  self->receive([&](ids& xs) { result = std::move(xs); },
+                after(0s) >> [&] { FAIL("INDEX did not respond"); });
+  CHECK_EQUAL(rank(result), 9u);
+  CHECK_EQUAL(rank(result & expected_result), 9u);
+  MESSAGE("only the partition that straddles the cutoff remains");
+  auto remaining = state().meta_idx.lookup(expr);
+  REQUIRE_EQUAL(remaining.size(), 1u);
+  auto dropped = candidates[0] == remaining[0] ? candidates[1] : candidates[0];
+  CHECK(!exists(directory / "index" / to_string(dropped)));
+  CHECK(!state().lru_partitions.contains(dropped));
+}
+
 FIXTURE_SCOPE_END()
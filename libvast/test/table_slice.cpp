@@ -18,9 +18,14 @@
 #include "vast/test/fixtures/table_slices.hpp"
 #include "vast/test/test.hpp"
 
+#include <caf/binary_deserializer.hpp>
+#include <caf/binary_serializer.hpp>
 #include <caf/make_copy_on_write.hpp>
 #include <caf/test/dsl.hpp>
 
+#include <numeric>
+
+#include "vast/chunk.hpp"
 #include "vast/default_table_slice.hpp"
 #include "vast/default_table_slice_builder.hpp"
 #include "vast/ids.hpp"
@@ -217,6 +222,34 @@ TEST(truncate) {
   CHECK_EQUAL(truncated_events(1), to_events(*sut, 0, 1));
 }
 
+TEST(project) {
+  auto sut = zeek_conn_log_slices.front();
+  sut.unshared().offset(100);
+  auto& layout = sut->layout();
+  MESSAGE("resolve keys as suffixes in the order of the keys");
+  auto columns = resolve_columns(layout, {"id.resp_h", "ts", "orig_h", "ts"});
+  REQUIRE_EQUAL(columns.size(), 3u);
+  CHECK_EQUAL(layout.fields[columns[0]].name, "id.resp_h");
+  CHECK_EQUAL(layout.fields[columns[1]].name, "ts");
+  CHECK_EQUAL(layout.fields[columns[2]].name, "id.orig_h");
+  CHECK(resolve_columns(layout, {"nonexistent"}).empty());
+  MESSAGE("project onto the resolved columns");
+  auto projected = project(sut, columns);
+  REQUIRE(projected != nullptr);
+  CHECK_EQUAL(projected->layout().name(), layout.name());
+  CHECK_EQUAL(projected->columns(), 3u);
+  CHECK_EQUAL(projected->rows(), sut->rows());
+  CHECK_EQUAL(projected->offset(), 100u);
+  for (size_t row = 0; row < sut->rows(); ++row)
+    for (size_t i = 0; i < columns.size(); ++i)
+      CHECK_EQUAL(projected->at(row, i), sut->at(row, columns[i]));
+  MESSAGE("projecting onto all or no columns needs no copy");
+  std::vector<size_t> all(sut->columns());
+  std::iota(all.begin(), all.end(), size_t{0});
+  CHECK(project(sut, all) == sut);
+  CHECK(project(sut, {}) == nullptr);
+}
+
 TEST(split) {
   auto sut = zeek_conn_log_slices.front();
   REQUIRE_EQUAL(sut->rows(), 8u);
@@ -245,4 +278,54 @@ TEST(split) {
   CHECK_EQUAL(split_sut(7), manual_split_sut(7));
 }
 
+TEST(load rows from chunk) {
+  auto layout = record_type{{"x", count_type{}}, {"y", string_type{}}};
+  auto slice = default_table_slice::make(layout, {vector{1u, "a"},
+                                                  vector{2u, "b"}});
+  std::vector<char> buf;
+  caf::binary_serializer sink{nullptr, buf};
+  REQUIRE_EQUAL(slice->serialize(sink), caf::none);
+  auto load = [&](size_t rows, std::vector<char> bytes) {
+    auto x = default_table_slice::make(table_slice_header{layout, rows, 0});
+    if (auto err = x.unshared().load(chunk::make(std::move(bytes))))
+      return err;
+    return x->decode();
+  };
+  CHECK_EQUAL(load(2, buf), caf::none);
+  MESSAGE("reject rows that do not match the header when loading");
+  CHECK_NOT_EQUAL(load(3, buf), caf::none);
+  MESSAGE("reject truncated rows when decoding");
+  buf.resize(buf.size() / 2);
+  auto x = default_table_slice::make(table_slice_header{layout, 2, 0});
+  REQUIRE_EQUAL(x.unshared().load(chunk::make(buf)), caf::none);
+  CHECK_NOT_EQUAL(x->decode(), caf::none);
+  MESSAGE("replace the rows of corrupt slices with nil values");
+  CHECK_EQUAL(x->rows(), 2u);
+  CHECK(caf::holds_alternative<caf::none_t>(x->at(1, 1)));
+}
+
+TEST(interned layout) {
+  auto layout = record_type{{"x", count_type{}}}.name("foo");
+  auto builder = default_table_slice_builder::make(layout);
+  REQUIRE(builder->add(count{42}));
+  auto x = builder->finish();
+  REQUIRE(x != nullptr);
+  CHECK_EQUAL(x->interned_layout(), type{layout});
+  MESSAGE("slices without an entry point intern on first access");
+  auto y = default_table_slice::make(table_slice_header{layout, 0, 0});
+  CHECK(y->interned_layout().raw_ptr() == x->interned_layout().raw_ptr());
+  MESSAGE("copies share the interned layout");
+  auto z = x;
+  CHECK(z.unshared().interned_layout().raw_ptr()
+        == x->interned_layout().raw_ptr());
+  MESSAGE("deserialized slices share the interned layout");
+  std::vector<char> buf;
+  caf::binary_serializer sink{nullptr, buf};
+  REQUIRE_EQUAL(inspect(sink, x), caf::none);
+  table_slice_ptr w;
+  caf::binary_deserializer source{nullptr, buf};
+  REQUIRE_EQUAL(inspect(source, w), caf::none);
+  CHECK(w->interned_layout().raw_ptr() == x->interned_layout().raw_ptr());
+}
+
 FIXTURE_SCOPE_END()
@@ -32,6 +32,7 @@
 #include "vast/save.hpp"
 
 #include <string_view>
+#include <thread>
 
 #include "type_test.hpp"
 
@@ -668,6 +669,37 @@ TEST(hashable) {
   CHECK_EQUAL(to_digest(x), std::to_string(hash(type{x})));
 }
 
+TEST(interning) {
+  auto x = record_type{{"x", integer_type{}}, {"y", string_type{}}};
+  auto y = intern(x);
+  auto z = intern(x);
+  MESSAGE("equal types share a canonical instance");
+  CHECK(y.raw_ptr() == z.raw_ptr());
+  CHECK(intern(y).raw_ptr() == y.raw_ptr());
+  CHECK_EQUAL(y, type{x});
+  CHECK_NOT_EQUAL(y, intern(record_type{{"x", integer_type{}}}));
+  CHECK(!intern(type{}));
+  MESSAGE("interning preserves the digest");
+  CHECK_EQUAL(y.digest(), uhash<xxhash64>{}(type{x}));
+  CHECK_EQUAL(std::hash<type>{}(y), std::hash<type>{}(type{x}));
+  MESSAGE("modifying an interned type leaves the canonical instance intact");
+  auto named = y;
+  named.name("foo");
+  CHECK(named.raw_ptr() != y.raw_ptr());
+  CHECK_EQUAL(z.name(), "");
+  CHECK_NOT_EQUAL(named, z);
+  CHECK(intern(named).raw_ptr() != z.raw_ptr());
+  auto copy = caf::get<record_type>(y);
+  copy.fields.pop_back();
+  CHECK_NOT_EQUAL(type{copy}, y);
+  CHECK(intern(copy).raw_ptr() != y.raw_ptr());
+  MESSAGE("all threads share the canonical instances");
+  const abstract_type* other = nullptr;
+  std::thread t{[&] { other = intern(x).raw_ptr(); }};
+  t.join();
+  CHECK(other == y.raw_ptr());
+}
+
 TEST(json) {
   auto e = enumeration_type{{"foo", "bar", "baz"}};
   e = e.name("e");
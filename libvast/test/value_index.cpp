@@ -30,8 +30,11 @@
 #include "vast/table_slice.hpp"
 #include "vast/value_index_factory.hpp"
 
+#include <caf/binary_serializer.hpp>
 #include <caf/test/dsl.hpp>
 
+#include <array>
+
 using namespace vast;
 using namespace std::string_literals;
 
@@ -139,6 +142,76 @@ TEST(floating-point with custom binner) {
   CHECK_EQUAL(to_string(unbox(result)), "1110111");
 }
 
+TEST(floating-point with adaptive binning) {
+  caf::settings opts;
+  opts["binning-sample"] = 4;
+  auto t = real_type{}.attributes({{"index", "adaptive"}});
+  auto idx = factory<value_index>::make(t, std::move(opts));
+  REQUIRE_NOT_EQUAL(idx, nullptr);
+  MESSAGE("append");
+  REQUIRE(idx->append(make_data_view(1.5)));
+  REQUIRE(idx->append(make_data_view(2.25)));
+  REQUIRE(idx->append(make_data_view(3.125)));
+  REQUIRE(idx->append(make_data_view(42.0)));
+  // The sample is complete and the binner now keeps three fractional digits.
+  REQUIRE(idx->append(make_data_view(7.0)));
+  REQUIRE(idx->append(make_data_view(3.1254)));
+  MESSAGE("lookup");
+  auto result = idx->lookup(equal, make_data_view(3.125));
+  CHECK_EQUAL(to_string(unbox(result)), "001001");
+  result = idx->lookup(less, make_data_view(3.0));
+  CHECK_EQUAL(to_string(unbox(result)), "110000");
+  result = idx->lookup(greater, make_data_view(5.0));
+  CHECK_EQUAL(to_string(unbox(result)), "000110");
+  // A strict inequality includes the bucket of the value itself.
+  result = idx->lookup(greater, make_data_view(3.125));
+  CHECK_EQUAL(to_string(unbox(result)), "001111");
+  MESSAGE("inequality keeps other values of the same bucket");
+  result = idx->lookup(not_equal, make_data_view(3.125));
+  CHECK_EQUAL(to_string(unbox(result)), "111111");
+  auto xs = vector{3.125, 42.0};
+  result = idx->lookup(not_in, make_data_view(xs));
+  CHECK_EQUAL(to_string(unbox(result)), "111111");
+  MESSAGE("serialization");
+  std::vector<char> buf;
+  CHECK_EQUAL(save(nullptr, buf, idx), caf::none);
+  value_index_ptr idx2;
+  REQUIRE_EQUAL(load(nullptr, buf, idx2), caf::none);
+  result = idx2->lookup(less, make_data_view(3.0));
+  CHECK_EQUAL(to_string(unbox(result)), "110000");
+  REQUIRE(idx2->append(make_data_view(2.0)));
+  result = idx2->lookup(less, make_data_view(3.0));
+  CHECK_EQUAL(to_string(unbox(result)), "1100001");
+}
+
+TEST(count with adaptive binning before sample is complete) {
+  caf::settings opts;
+  opts["binning"] = "adaptive";
+  auto idx = factory<value_index>::make(count_type{}, std::move(opts));
+  REQUIRE_NOT_EQUAL(idx, nullptr);
+  REQUIRE(idx->append(make_data_view(count{10})));
+  REQUIRE(idx->append(make_data_view(count{20})));
+  REQUIRE(idx->append(make_data_view(count{30})));
+  // Lookups evaluate the partial sample without fitting the binner.
+  auto result = idx->lookup(greater, make_data_view(count{15}));
+  CHECK_EQUAL(to_string(unbox(result)), "011");
+  result = idx->lookup(not_equal, make_data_view(count{20}));
+  CHECK_EQUAL(to_string(unbox(result)), "101");
+  REQUIRE(idx->append(make_data_view(count{40})));
+  result = idx->lookup(less_equal, make_data_view(count{30}));
+  CHECK_EQUAL(to_string(unbox(result)), "1110");
+  MESSAGE("serialization keeps the partial sample");
+  std::vector<char> buf;
+  CHECK_EQUAL(save(nullptr, buf, idx), caf::none);
+  value_index_ptr idx2;
+  REQUIRE_EQUAL(load(nullptr, buf, idx2), caf::none);
+  result = idx2->lookup(less_equal, make_data_view(count{30}));
+  CHECK_EQUAL(to_string(unbox(result)), "1110");
+  REQUIRE(idx2->append(make_data_view(count{50})));
+  result = idx2->lookup(greater, make_data_view(count{35}));
+  CHECK_EQUAL(to_string(unbox(result)), "00011");
+}
+
 TEST(duration) {
   using namespace std::chrono;
   caf::settings opts;
@@ -321,6 +394,12 @@ TEST(address) {
   y = {*to<address>("192.168.0.64"), 26};
   bm = idx.lookup(not_in, make_data_view(y));
   CHECK(to_string(unbox(bm)) == "11111111101");
+  y = {*to<address>("192.0.0.0"), 8};
+  bm = idx.lookup(in, make_data_view(y));
+  CHECK(to_string(unbox(bm)) == "11111111111");
+  y = {*to<address>("10.0.0.0"), 8};
+  bm = idx.lookup(in, make_data_view(y));
+  CHECK(to_string(unbox(bm)) == "00000000000");
   auto xs = vector{*to<address>("192.168.0.1"), *to<address>("192.168.0.2")};
   auto multi = unbox(idx.lookup(in, make_data_view(xs)));
   CHECK_EQUAL(to_string(multi), "11011100000");
@@ -338,6 +417,92 @@ TEST(address) {
   CHECK_EQUAL(to_string(unbox(idx2.lookup(equal, make_data_view(x)))), str);
 }
 
+TEST(address - mixed families) {
+  address_index idx{address_type{}};
+  for (auto x : {"10.0.0.1", "2001:db8::1", "10.1.2.3", "2001:db8:1::1",
+                 "fe80::1", "10.0.0.1"})
+    REQUIRE(idx.append(make_data_view(unbox(to<address>(x)))));
+  auto lookup = [&](relational_operator op, const auto& x) {
+    return to_string(unbox(idx.lookup(op, make_data_view(x))));
+  };
+  MESSAGE("address equality");
+  CHECK_EQUAL(lookup(equal, unbox(to<address>("10.0.0.1"))), "100001");
+  CHECK_EQUAL(lookup(equal, unbox(to<address>("2001:db8::1"))), "010000");
+  CHECK_EQUAL(lookup(not_equal, unbox(to<address>("fe80::1"))), "111101");
+  MESSAGE("prefix membership");
+  CHECK_EQUAL(lookup(in, unbox(to<subnet>("10.0.0.0/8"))), "101001");
+  CHECK_EQUAL(lookup(in, unbox(to<subnet>("10.0.0.0/16"))), "100001");
+  CHECK_EQUAL(lookup(in, unbox(to<subnet>("10.1.2.0/23"))), "001000");
+  CHECK_EQUAL(lookup(in, unbox(to<subnet>("2001:db8::/32"))), "010100");
+  CHECK_EQUAL(lookup(in, unbox(to<subnet>("2001:db8::/48"))), "010000");
+  CHECK_EQUAL(lookup(in, unbox(to<subnet>("fe80::/10"))), "000010");
+  CHECK_EQUAL(lookup(not_in, unbox(to<subnet>("2000::/3"))), "101011");
+  MESSAGE("IPv6 networks containing IPv4-mapped addresses");
+  CHECK_EQUAL(lookup(in, unbox(to<subnet>("::/64"))), "101001");
+}
+
+TEST(address - footprint) {
+  // Addresses scattered across all /16 networks must not produce a sparse
+  // bitmap per network.
+  address_index idx{address_type{}};
+  auto n = size_t{0};
+  for (auto i = 0u; i < 256; ++i) {
+    for (auto j = 0u; j < 256; ++j, ++n) {
+      uint8_t bytes[4] = {static_cast<uint8_t>(i), static_cast<uint8_t>(j), 0,
+                          1};
+      auto x = address::v4(bytes, address::network);
+      REQUIRE(idx.append(make_data_view(x)));
+    }
+  }
+  std::vector<char> buf;
+  REQUIRE_EQUAL(save(nullptr, buf, idx), caf::none);
+  CHECK_LESS(buf.size(), 2 * n);
+  auto y = unbox(to<subnet>("10.20.0.0/16"));
+  auto result = unbox(idx.lookup(in, make_data_view(y)));
+  CHECK_EQUAL(rank(result), 1u);
+  CHECK_EQUAL(select(result, -1), id{10 * 256 + 20});
+}
+
+TEST(address - legacy format) {
+  // The legacy format held a bitslice-coded index per address byte and a
+  // bitmap of all IPv4 addresses.
+  using byte_index = bitmap_index<uint8_t, bitslice_coder<ewah_bitmap>>;
+  using type_index = bitmap_index<bool, singleton_coder<ewah_bitmap>>;
+  std::array<byte_index, 16> bytes;
+  bytes.fill(byte_index{8});
+  type_index v4;
+  address_index idx{address_type{}};
+  auto append = [&](const char* str, id pos) {
+    auto x = unbox(to<address>(str));
+    REQUIRE(idx.append(make_data_view(x), pos));
+    for (auto i = 0u; i < 16; ++i) {
+      bytes[i].skip(pos - bytes[i].size());
+      bytes[i].append(x.data()[i]);
+    }
+    v4.skip(pos - v4.size());
+    v4.append(x.is_v4());
+  };
+  append("10.0.0.1", 0);
+  append("2001:db8::1", 1);
+  append("10.1.2.3", 2);
+  append("fe80::1", 5);
+  std::vector<char> buf;
+  caf::binary_serializer sink{nullptr, buf};
+  auto& base = static_cast<const value_index&>(idx);
+  REQUIRE_EQUAL(base.value_index::serialize(sink), caf::none);
+  REQUIRE_EQUAL(sink(bytes, v4), caf::none);
+  address_index legacy{address_type{}};
+  REQUIRE_EQUAL(load(nullptr, buf, legacy), caf::none);
+  auto lookup = [&](relational_operator op, const auto& x) {
+    return to_string(unbox(legacy.lookup(op, make_data_view(x))));
+  };
+  CHECK_EQUAL(lookup(equal, unbox(to<address>("10.0.0.1"))), "100000");
+  CHECK_EQUAL(lookup(equal, unbox(to<address>("2001:db8::1"))), "010000");
+  CHECK_EQUAL(lookup(in, unbox(to<subnet>("10.0.0.0/8"))), "101000");
+  CHECK_EQUAL(lookup(in, unbox(to<subnet>("fe80::/10"))), "000001");
+  CHECK_EQUAL(lookup(not_in, unbox(to<subnet>("10.1.0.0/16"))), "110101");
+}
+
 TEST(subnet) {
   subnet_index idx{subnet_type{}};
   auto s0 = *to<subnet>("192.168.0.0/24");
@@ -489,6 +654,44 @@ TEST(set) {
   CHECK_EQUAL(to_string(*idx2->lookup(ni, make_data_view(42))), "1001");
 }
 
+TEST(element set) {
+  auto t = vector_type{address_type{}}.attributes({{"index", "elements"}});
+  auto idx = factory<value_index>::make(t, caf::settings{});
+  REQUIRE_NOT_EQUAL(idx, nullptr);
+  REQUIRE(dynamic_cast<element_set_index*>(idx.get()) != nullptr);
+  MESSAGE("append");
+  auto a = unbox(to<address>("1.2.3.4"));
+  auto b = unbox(to<address>("5.6.7.8"));
+  auto c = unbox(to<address>("::1"));
+  auto xs = vector{a, b, a};
+  REQUIRE(idx->append(make_data_view(xs)));
+  xs = vector{};
+  REQUIRE(idx->append(make_data_view(xs)));
+  xs = vector{c, c, c, c, c, c, c, c, c, b};
+  REQUIRE(idx->append(make_data_view(xs)));
+  REQUIRE(idx->append(make_data_view(caf::none)));
+  xs = vector{a};
+  REQUIRE(idx->append(make_data_view(xs), 6));
+  MESSAGE("lookup");
+  auto lookup = [&](relational_operator op, const address& x) {
+    return to_string(unbox(idx->lookup(op, make_data_view(x))));
+  };
+  CHECK_EQUAL(lookup(ni, a), "1000001");
+  CHECK_EQUAL(lookup(ni, b), "1010000");
+  CHECK_EQUAL(lookup(ni, c), "0010000");
+  CHECK_EQUAL(lookup(not_ni, c), "1100001");
+  CHECK_EQUAL(lookup(ni, unbox(to<address>("10.0.0.1"))), "0000000");
+  CHECK(!idx->lookup(equal, make_data_view(a)));
+  MESSAGE("serialization");
+  std::vector<char> buf;
+  CHECK_EQUAL(save(nullptr, buf, idx), caf::none);
+  value_index_ptr idx2;
+  REQUIRE_EQUAL(load(nullptr, buf, idx2), caf::none);
+  REQUIRE_NOT_EQUAL(idx2, nullptr);
+  CHECK_EQUAL(to_string(unbox(idx2->lookup(ni, make_data_view(b)))),
+              "1010000");
+}
+
 TEST(none values - string) {
   auto idx = factory<value_index>::make(string_type{}, caf::settings{});
   REQUIRE_NOT_EQUAL(idx, nullptr);
@@ -539,6 +742,60 @@ TEST(none values - arithmetic) {
   CHECK_EQUAL(to_string(unbox(bm)), "00100");
 }
 
+TEST(distinct values) {
+  MESSAGE("ports");
+  port_index ports{port_type{}};
+  REQUIRE(ports.append(make_data_view(port(80, port::tcp))));
+  REQUIRE(ports.append(make_data_view(port(443, port::tcp))));
+  REQUIRE(ports.append(make_data_view(port(53, port::udp))));
+  REQUIRE(ports.append(make_data_view(port(80, port::tcp))));
+  REQUIRE(ports.append(make_data_view(port(80, port::udp))));
+  REQUIRE(ports.append(make_data_view(caf::none)));
+  auto xs = unbox(ports.distinct(make_ids({{0, 6}})));
+  auto expected = value_counts{{port(80, port::tcp), 2},
+                               {port(443, port::tcp), 1},
+                               {port(53, port::udp), 1},
+                               {port(80, port::udp), 1},
+                               {caf::none, 1}};
+  CHECK(xs == expected);
+  xs = unbox(ports.distinct(make_ids({1, 3}, 6)));
+  expected = value_counts{{port(80, port::tcp), 1}, {port(443, port::tcp), 1}};
+  CHECK(xs == expected);
+  MESSAGE("integers");
+  auto integers = factory<value_index>::make(integer_type{}, caf::settings{});
+  REQUIRE_NOT_EQUAL(integers, nullptr);
+  auto max = std::numeric_limits<integer>::max();
+  REQUIRE(integers->append(make_data_view(integer{-5})));
+  REQUIRE(integers->append(make_data_view(integer{7})));
+  REQUIRE(integers->append(make_data_view(integer{-5})));
+  REQUIRE(integers->append(make_data_view(max)));
+  xs = unbox(integers->distinct(make_ids({{0, 4}})));
+  expected = value_counts{{integer{-5}, 2}, {integer{7}, 1}, {max, 1}};
+  CHECK(xs == expected);
+  MESSAGE("booleans");
+  auto bools = factory<value_index>::make(bool_type{}, caf::settings{});
+  REQUIRE_NOT_EQUAL(bools, nullptr);
+  REQUIRE(bools->append(make_data_view(true)));
+  REQUIRE(bools->append(make_data_view(false)));
+  REQUIRE(bools->append(make_data_view(true)));
+  xs = unbox(bools->distinct(make_ids({{0, 3}})));
+  expected = value_counts{{true, 2}, {false, 1}};
+  CHECK(xs == expected);
+  MESSAGE("enumerations");
+  enumeration_index enums{enumeration_type{{"foo", "bar", "baz"}}};
+  REQUIRE(enums.append(make_data_view(enumeration{2})));
+  REQUIRE(enums.append(make_data_view(enumeration{0})));
+  REQUIRE(enums.append(make_data_view(enumeration{2})));
+  xs = unbox(enums.distinct(make_ids({0, 2}, 3)));
+  expected = value_counts{{enumeration{2}, 2}};
+  CHECK(xs == expected);
+  MESSAGE("strings cannot enumerate their values");
+  auto strings = factory<value_index>::make(string_type{}, caf::settings{});
+  REQUIRE_NOT_EQUAL(strings, nullptr);
+  REQUIRE(strings->append(make_data_view("foo")));
+  CHECK(!strings->distinct(make_ids({0})));
+}
+
 // This test uncovered a regression that ocurred when computing the rank of a
 // bitmap representing conn.log events. The culprit was the EWAH bitmap
 // encoding, because swapping out ewah_bitmap for null_bitmap in address_index
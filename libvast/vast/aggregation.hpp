@@ -0,0 +1,158 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+#pragma once
+
+#include "vast/data.hpp"
+#include "vast/fwd.hpp"
+#include "vast/ids.hpp"
+#include "vast/type.hpp"
+
+#include <caf/expected.hpp>
+#include <caf/meta/type_name.hpp>
+#include <caf/optional.hpp>
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace vast {
+
+/// A function that an aggregation computes per group.
+enum class aggregate_function : uint8_t { count, sum, min, max };
+
+/// @relates aggregate_function
+const char* to_string(aggregate_function x);
+
+/// A function over the values of a field.
+struct aggregate {
+  aggregate_function function = aggregate_function::count;
+
+  /// The key of the field. A `count` without field counts rows.
+  std::string field;
+};
+
+/// @relates aggregate
+bool operator==(const aggregate& x, const aggregate& y);
+
+/// @relates aggregate
+inline bool operator!=(const aggregate& x, const aggregate& y) {
+  return !(x == y);
+}
+
+/// Renders an aggregate as in `sum(orig_bytes)`.
+/// @relates aggregate
+std::string to_string(const aggregate& x);
+
+/// Parses an aggregate of the form `count`, `count(key)`, `sum(key)`,
+/// `min(key)`, or `max(key)`.
+/// @relates aggregate
+caf::expected<aggregate> make_aggregate(std::string_view str);
+
+/// @relates aggregate
+template <class Inspector>
+auto inspect(Inspector& f, aggregate& x) {
+  return f(caf::meta::type_name("vast::aggregate"), x.function, x.field);
+}
+
+/// Computes aggregates per group of rows with equal values in a set of
+/// fields. Because all aggregate functions are associative, aggregations over
+/// disjoint sets of rows merge into the aggregation over their union. This
+/// allows for computing partial aggregations where the data resides and
+/// shipping only the groups.
+class aggregation {
+public:
+  // -- member types -----------------------------------------------------------
+
+  /// The values of the group-by fields of a group, with `nil` for absent
+  /// fields.
+  using key_type = std::vector<data>;
+
+  /// The results of the aggregate functions of a group.
+  using value_type = std::vector<data>;
+
+  /// Maps groups to their aggregates.
+  using group_map = std::map<key_type, value_type>;
+
+  // -- constructors, destructors, and assignment operators --------------------
+
+  aggregation() = default;
+
+  /// Constructs an empty aggregation.
+  /// @param group_by The keys of the fields to group by.
+  /// @param aggregates The functions to compute per group.
+  aggregation(std::vector<std::string> group_by,
+              std::vector<aggregate> aggregates);
+
+  // -- modifiers --------------------------------------------------------------
+
+  /// Aggregates all rows of a table slice.
+  void add(const table_slice& slice);
+
+  /// Aggregates the rows of a table slice that *selection* contains.
+  /// @param slice The table slice.
+  /// @param selection The IDs of the rows to aggregate.
+  void add(const table_slice& slice, const ids& selection);
+
+  /// Merges the groups of an aggregation over another set of rows.
+  /// @pre `group_by() == other.group_by() && aggregates() == other.aggregates()`
+  void merge(const aggregation& other);
+
+  // -- properties -------------------------------------------------------------
+
+  /// @returns the keys of the group-by fields.
+  const std::vector<std::string>& group_by() const {
+    return group_by_;
+  }
+
+  /// @returns the aggregate functions.
+  const std::vector<aggregate>& aggregates() const {
+    return aggregates_;
+  }
+
+  /// @returns all groups with their aggregates.
+  const group_map& groups() const {
+    return groups_;
+  }
+
+  // -- concepts ---------------------------------------------------------------
+
+  template <class Inspector>
+  friend auto inspect(Inspector& f, aggregation& x) {
+    return f(caf::meta::type_name("vast::aggregation"), x.group_by_,
+             x.aggregates_, x.groups_);
+  }
+
+private:
+  /// The columns of the group-by fields and the aggregated fields in a layout.
+  struct columns {
+    std::vector<caf::optional<size_t>> keys;
+    std::vector<caf::optional<size_t>> values;
+  };
+
+  const columns& resolve(const record_type& layout);
+
+  void add_row(const table_slice& slice, const columns& cols, size_t row);
+
+  std::vector<std::string> group_by_;
+  std::vector<aggregate> aggregates_;
+  group_map groups_;
+
+  /// Caches the resolved columns per layout.
+  std::unordered_map<type, columns> columns_;
+};
+
+} // namespace vast
@@ -51,6 +51,9 @@ using set = detail::steady_set<data>;
 /// An associative array with ::data as both key and value.
 using map = detail::steady_map<data, data>;
 
+/// Maps distinct values to their number of occurrences.
+using value_counts = std::map<data, count>;
+
 /// Default bitstream implementation.
 using default_bitstream = ewah_bitstream;
 
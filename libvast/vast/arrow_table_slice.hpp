@@ -70,6 +70,9 @@ public:
   void
   append_column_to_index(size_type col, vast::value_index& idx) const override;
 
+  ids evaluate_column(size_type col, relational_operator op,
+                      const data_view& rhs) const override;
+
   caf::atom_value implementation_id() const noexcept override;
 
   vast::data_view at(size_type row, size_type col) const override;
@@ -17,8 +17,11 @@
 #include <cmath>
 #include <cstddef>
 #include <type_traits>
+#include <vector>
 
+#include "vast/detail/assert.hpp"
 #include "vast/detail/math.hpp"
+#include "vast/detail/operators.hpp"
 
 namespace vast {
 
@@ -104,6 +107,122 @@ constexpr uint64_t precision_binner<P, N>::digits10;
 template <size_t P, size_t N>
 constexpr uint64_t precision_binner<P, N>::digits2;
 
+/// A binning policy with buckets of width 10^e, where an index chooses the
+/// exponent *e* at runtime after looking at a sample of its data. A positive
+/// exponent truncates integral values like decimal_binner, and a negative
+/// exponent rounds floating-point values to *-e* fractional digits like
+/// precision_binner.
+class adaptive_binner : detail::equality_comparable<adaptive_binner> {
+public:
+  /// The number of significant decimal digits that the buckets retain across
+  /// the central 80% of a sample.
+  static constexpr int significant_digits = 4;
+
+  /// The number of distinct values in a sample up to which the binner keeps
+  /// all of them apart.
+  static constexpr size_t max_exact_cardinality = 1024;
+
+  /// The largest absolute exponent.
+  static constexpr int max_exponent = 18;
+
+  adaptive_binner() = default;
+
+  explicit adaptive_binner(int exponent) : exponent_{exponent} {
+    VAST_ASSERT(-max_exponent <= exponent && exponent <= max_exponent);
+  }
+
+  /// Chooses the bucket width for a sample of values.
+  /// @param xs The sampled values.
+  /// @returns A binner that retains all values of a sample with few distinct
+  ///          values, and otherwise #significant_digits of the spread of the
+  ///          central 80% of the sample.
+  template <class T>
+  static adaptive_binner fit(std::vector<T> xs) {
+    if (xs.empty())
+      return adaptive_binner{};
+    std::sort(xs.begin(), xs.end());
+    auto lo = static_cast<double>(xs[xs.size() / 10]);
+    auto hi = static_cast<double>(xs[xs.size() - 1 - xs.size() / 10]);
+    xs.erase(std::unique(xs.begin(), xs.end()), xs.end());
+    if constexpr (std::is_floating_point_v<T>) {
+      // Find the smallest number of fractional digits that retains all values
+      // of the sample, if such a number exists.
+      auto retains = [&](int e) {
+        for (auto x : xs) {
+          auto y = x / bucket_width(e);
+          if (!(std::abs(y) < 0x1p53) || std::abs(y - std::round(y)) > 1e-6)
+            return false;
+        }
+        return true;
+      };
+      for (auto e = 0; e >= -max_exponent; --e)
+        if (retains(e))
+          return adaptive_binner{e};
+    } else {
+      if (xs.size() <= max_exact_cardinality)
+        return adaptive_binner{};
+    }
+    if (!(hi > lo))
+      return adaptive_binner{};
+    auto e = static_cast<int>(std::floor(std::log10(hi - lo)))
+             - significant_digits + 1;
+    if constexpr (std::is_integral_v<T>)
+      e = std::max(e, 0);
+    return adaptive_binner{std::clamp(e, -max_exponent, max_exponent)};
+  }
+
+  template <class T>
+  auto bin(T x) const {
+    if constexpr (std::is_integral_v<T>) {
+      if (exponent_ <= 0)
+        return x;
+      return static_cast<T>(x / static_cast<T>(bucket_width(exponent_)));
+    } else if constexpr (std::is_floating_point_v<T>) {
+      // The outermost buckets absorb values beyond the integral range.
+      constexpr auto limit = static_cast<T>(int64_t{1} << 62);
+      auto y = std::round(x / bucket_width(exponent_));
+      return static_cast<int64_t>(std::clamp(y, -limit, limit));
+    } else {
+      static_assert(!std::is_same_v<T, T>,
+                    "T is neither integral nor a float");
+    }
+  }
+
+  /// Checks whether the binner maps distinct values of type `T` into the same
+  /// bucket.
+  template <class T>
+  bool lossy() const {
+    return std::is_floating_point_v<T> || exponent_ > 0;
+  }
+
+  int exponent() const {
+    return exponent_;
+  }
+
+  friend bool operator==(const adaptive_binner& x, const adaptive_binner& y) {
+    return x.exponent_ == y.exponent_;
+  }
+
+  template <class Inspector>
+  friend auto inspect(Inspector& f, adaptive_binner& x) {
+    return f(x.exponent_);
+  }
+
+private:
+  /// @returns 10^e for e in [-18, 18].
+  static double bucket_width(int e) {
+    static constexpr double powers[] = {
+      1e-18, 1e-17, 1e-16, 1e-15, 1e-14, 1e-13, 1e-12, 1e-11, 1e-10, 1e-9,
+      1e-8, 1e-7, 1e-6, 1e-5, 1e-4, 1e-3, 1e-2, 1e-1, 1e0, 1e1, 1e2, 1e3,
+      1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+      1e16, 1e17, 1e18
+    };
+    return powers[e + max_exponent];
+  }
+
+  int exponent_ = 0;
+};
+
 namespace detail {
 
 template <class T>
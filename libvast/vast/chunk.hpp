@@ -134,6 +134,16 @@ public:
   /// @pre `start + length < size()`
   chunk_ptr slice(size_type start, size_type length = 0) const;
 
+  /// Hints the operating system that a range of the chunk will be read soon.
+  /// For memory-mapped chunks, this schedules an asynchronous readahead of
+  /// the underlying file pages. The hint is best-effort and has no effect on
+  /// the chunk contents.
+  /// @param start The offset from the beginning of the range.
+  /// @param length The length of the range. If 0, the range extends to the
+  ///               end of the chunk.
+  /// @pre `start + length <= size()`
+  void prefetch(size_type start = 0, size_type length = 0) const;
+
   /// Adds an additional step for deleting this chunk.
   /// @param f Function object that gets called after all previous deletion
   ///          steps ran.
@@ -69,6 +69,10 @@ public:
   /// @pre `init()` was called previously.
   caf::expected<bitmap> lookup(relational_operator op, data_view rhs);
 
+  /// Counts the occurrences of each distinct value at a set of event IDs.
+  /// @pre `init()` was called previously.
+  caf::expected<value_counts> distinct(const ids& selection);
+
   /// @returns the file name for loading and storing the index.
   const path& filename() const {
     return filename_;
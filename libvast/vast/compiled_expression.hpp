@@ -0,0 +1,152 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+#pragma once
+
+#include "vast/data.hpp"
+#include "vast/expression.hpp"
+#include "vast/fwd.hpp"
+#include "vast/ids.hpp"
+#include "vast/operator.hpp"
+#include "vast/type.hpp"
+#include "vast/view.hpp"
+
+#include <caf/expected.hpp>
+#include <caf/settings.hpp>
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace vast {
+
+/// An expression [tailored](@ref tailor) to a layout and compiled into a flat
+/// program for candidate checks. Predicates in the program refer to columns
+/// by offset and test values with closures over pre-built constants, e.g.,
+/// compiled regular expressions or sorted sets, so that evaluating a table
+/// slice needs no visitation of the expression tree.
+class compiled_expression {
+public:
+  /// A test for a single value of a column.
+  using value_test = std::function<bool(const data_view&)>;
+
+  /// The instruction kinds of a program.
+  enum class opcode { constant, predicate, conjunction, disjunction, negation };
+
+  /// A single instruction. The instructions of a program appear in prefix
+  /// order, i.e., connectives precede their operands.
+  struct instruction {
+    opcode code;
+
+    /// The number of instructions of the subtree rooted at this instruction.
+    size_t size = 1;
+
+    /// The number of operands of a connective.
+    size_t arity = 0;
+
+    /// The result of a constant.
+    bool value = false;
+
+    /// The column of a predicate.
+    size_t column = 0;
+
+    /// The operator of a predicate.
+    relational_operator op = equal;
+
+    /// The RHS of a predicate. Shared such that views into it remain valid.
+    std::shared_ptr<const data> rhs;
+
+    /// The test of a predicate.
+    value_test test;
+
+    /// Whether *test* is faster than `table_slice::evaluate_column`.
+    bool specialized = false;
+
+    /// Whether the value indexes answer the subtree rooted at this
+    /// instruction without false positives, i.e., whether all index hits
+    /// satisfy it.
+    bool exact = false;
+  };
+
+  /// Default-constructs an empty program that matches nothing.
+  compiled_expression() = default;
+
+  /// Tailors an expression to a layout and compiles it.
+  /// @param expr The expression to compile.
+  /// @param layout The layout of the table slices to evaluate.
+  /// @param index_opts The options of the value indexes for *layout*, which
+  ///                   determine whether index lookups are exact.
+  /// @returns The compiled expression or an error if *expr* is invalid for
+  ///          *layout*.
+  static caf::expected<compiled_expression>
+  make(const expression& expr, const record_type& layout,
+       const caf::settings& index_opts = {});
+
+  /// Evaluates all rows of a table slice.
+  /// @param slice The table slice for evaluation.
+  /// @returns a bitmap containing all IDs of matching rows.
+  /// @pre `slice.layout() == layout()`
+  ids operator()(const table_slice& slice) const;
+
+  /// Evaluates a selection of rows of a table slice.
+  /// @param slice The table slice for evaluation.
+  /// @param selection The IDs of the rows to evaluate.
+  /// @returns a bitmap containing the IDs of matching rows in *selection*.
+  /// @pre `slice.layout() == layout()`
+  ids operator()(const table_slice& slice, const ids& selection) const;
+
+  /// Evaluates a single row of a table slice.
+  /// @param slice The table slice for evaluation.
+  /// @param row The row to evaluate.
+  /// @returns `true` if the row matches.
+  /// @pre `slice.layout() == layout() && row < slice.rows()`
+  bool operator()(const table_slice& slice, size_t row) const;
+
+  /// @returns `true` if all index hits satisfy the expression, such that
+  ///          hits need no candidate check.
+  bool exact() const;
+
+  /// Computes the part of the expression that index hits may not satisfy.
+  /// For a conjunction, the residual consists of the inexact operands only,
+  /// e.g., predicates answered by a hash index or substring searches. The
+  /// residual of an exact expression matches all rows.
+  /// @returns the residual program for checking index hits.
+  compiled_expression residual() const;
+
+  /// @returns the tailored expression.
+  const expression& expr() const {
+    return expr_;
+  }
+
+  /// @returns the layout of the program.
+  const record_type& layout() const {
+    return layout_;
+  }
+
+  /// @returns the program.
+  const std::vector<instruction>& program() const {
+    return program_;
+  }
+
+private:
+  bool run(const table_slice& slice, size_t row, size_t pc) const;
+
+  ids run(const table_slice& slice, size_t pc) const;
+
+  expression expr_;
+  record_type layout_;
+  std::vector<instruction> program_;
+};
+
+} // namespace vast
@@ -13,11 +13,13 @@
 
 #pragma once
 
+#include <mutex>
 #include <vector>
 
 #include <caf/atom.hpp>
 
 #include "vast/aliases.hpp"
+#include "vast/chunk.hpp"
 #include "vast/data.hpp"
 #include "vast/fwd.hpp"
 #include "vast/table_slice.hpp"
@@ -42,6 +44,10 @@ public:
   static table_slice_ptr make(record_type layout,
                               const std::vector<vector>& rows);
 
+  // -- constructors, destructors, and assignment operators --------------------
+
+  default_table_slice(const default_table_slice& other);
+
   // -- factory functions ------------------------------------------------------
 
   default_table_slice* copy() const final;
@@ -52,11 +58,21 @@ public:
 
   caf::error deserialize(caf::deserializer& source) final;
 
+  /// Keeps a reference to *chunk* and defers deserializing the rows until
+  /// the first access to the data.
+  /// @returns an error if *chunk* does not hold as many rows as the header.
+  caf::error load(chunk_ptr chunk) final;
+
+  caf::error decode() const final;
+
   // -- visitation -------------------------------------------------------------
 
   /// Applies all values in column `col` to `idx`.
   void append_column_to_index(size_type col, value_index& idx) const final;
 
+  ids evaluate_column(size_type col, relational_operator op,
+                      const data_view& rhs) const final;
+
   // -- properties -------------------------------------------------------------
 
   data_view at(size_type row, size_type col) const final;
@@ -64,15 +80,26 @@ public:
   caf::atom_value implementation_id() const noexcept override;
 
   /// @returns the container for storing table slice rows.
-  const vector& container() const noexcept {
-    return xs_;
-  }
+  const vector& container() const;
 
 protected:
   explicit default_table_slice(table_slice_header header);
 
 private:
-  vector xs_;
+  /// Deserializes the rows from the backing chunk, if any.
+  void decode_rows() const;
+
+  /// The rows of the slice. Empty until decoded if the slice has a chunk.
+  mutable vector xs_;
+
+  /// The serialized rows that `load` received, released after decoding.
+  mutable chunk_ptr chunk_;
+
+  /// Guards concurrent decoding of shared slices.
+  mutable std::once_flag decoded_;
+
+  /// The reason for replacing the rows with nil values, if any.
+  mutable caf::error error_;
 };
 
 /// @relates default_table_slice
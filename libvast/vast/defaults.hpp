@@ -275,6 +275,10 @@ constexpr size_t max_string_size = 1024;
 /// or table).
 constexpr size_t max_container_elements = 256;
 
+/// The number of values an arithmetic index with adaptive binning samples
+/// before choosing its binner and base.
+constexpr size_t binning_sample_size = 65'536;
+
 } // namespace index
 
 // -- constants for the entire system ------------------------------------------
@@ -321,12 +325,40 @@ constexpr size_t taste_partitions = 5;
 /// Maximum number of concurrent INDEX queries.
 constexpr size_t num_query_supervisors = 10;
 
+/// Maximum number of concurrent ARCHIVE lookups per EXPORTER.
+constexpr size_t max_archive_lookups = 4;
+
 /// Number of cached ARCHIVE segments.
 constexpr size_t segments = 10;
 
 /// Maximum size of ARCHIVE segments in MB.
 constexpr size_t max_segment_size = 128;
 
+/// Number of rows that an EXPORTER lets the ARCHIVE ship ahead of its SINK.
+constexpr uint64_t archive_credit = 65536;
+
+/// Number of ARCHIVE workers for processing extracted table slices.
+constexpr size_t archive_workers = 4;
+
+/// Compression method for table slices in ARCHIVE segments.
+constexpr std::string_view segment_compression = "null";
+
+/// Whether ARCHIVE segments store table slices column by column.
+constexpr bool columnar_segments = false;
+
+/// Minimum number of entries in the journal of the ARCHIVE before it gets
+/// folded into a checkpoint of the segment meta data.
+constexpr size_t min_journal_entries = 1024;
+
+/// Minimum fraction of erased events for the ARCHIVE to compact a segment. A
+/// value of 0 disables compaction.
+constexpr double compaction_threshold = 0.5;
+
+/// Interval between two runs of the retention policy, which erases all events
+/// older than `system.retention`.
+constexpr std::chrono::milliseconds retention_interval
+  = std::chrono::hours{1};
+
 /// Number of initial IDs to request in the IMPORTER.
 constexpr size_t initially_requested_ids = 128;
 
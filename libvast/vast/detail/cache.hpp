@@ -14,6 +14,7 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <list>
 #include <unordered_map>
@@ -24,6 +25,7 @@
 #include "vast/error.hpp"
 
 #include "vast/detail/assert.hpp"
+#include "vast/detail/frequency_sketch.hpp"
 #include "vast/detail/operators.hpp"
 #include "vast/detail/type_traits.hpp"
 
@@ -31,7 +33,17 @@ namespace vast::detail {
 
 struct lru;
 
-/// A direct-mapped cache with fixed capacity.
+/// Counters for the effectiveness of a cache.
+struct cache_statistics {
+  uint64_t hits = 0;       ///< Lookups that found an element.
+  uint64_t misses = 0;     ///< Lookups that found no element.
+  uint64_t evictions = 0;  ///< Elements evicted to make room for others.
+  uint64_t rejections = 0; ///< Insertions that the policy declined.
+};
+
+/// A direct-mapped cache with fixed capacity. The capacity limits the total
+/// weight of all elements, where each element weighs 1 unless the cache has
+/// a function for weighing its elements, e.g., by their size in bytes.
 template <class Key, class Value, class Policy = lru>
 class cache : equality_comparable<cache<Key, Value, Policy>> {
 public:
@@ -47,10 +59,16 @@ public:
   /// The callback to invoke for evicted elements.
   using evict_callback = std::function<void(key_type&, mapped_type&)>;
 
-  /// Constructs an LRU cache with a maximum number of elements.
-  /// @param capacity The maximum number of elements in the cache.
+  /// The function that computes the weight of an element.
+  using weigh_function = std::function<size_t(const mapped_type&)>;
+
+  /// Constructs a cache with a maximum total weight.
+  /// @param capacity The maximum total weight of the elements in the cache.
+  /// @param weigh The function for weighing elements, or none for counting
+  ///              each element with weight 1.
   /// @pre `capacity > 0`
-  cache(size_t capacity = 100) : capacity_{capacity} {
+  cache(size_t capacity = 100, weigh_function weigh = {})
+    : weigh_{std::move(weigh)}, capacity_{capacity} {
     VAST_ASSERT(capacity_ > 0);
   }
 
@@ -69,15 +87,17 @@ public:
     VAST_ASSERT(!empty());
     auto i = tracker_.find(xs_.front().first);
     VAST_ASSERT(i != tracker_.end());
+    weight_ -= i->second.weight;
     tracker_.erase(i);
     auto victim = std::move(xs_.front());
     xs_.pop_front();
+    ++statistics_.evictions;
     if (on_evict_)
       on_evict_(const_cast<key_type&>(victim.first), victim.second);
     return victim;
   }
 
-  /// Retrieves the maximum number elements the cache can hold.
+  /// Retrieves the maximum total weight the cache can hold.
   /// @returns The cache's capacity.
   size_t capacity() const {
     return capacity_;
@@ -90,8 +110,7 @@ public:
   void capacity(size_t c) {
     VAST_ASSERT(c > 0);
     capacity_ = c;
-    auto n = size();
-    for (auto i = c; i < n; ++i)
+    while (weight_ > capacity_)
       evict();
   }
 
@@ -101,12 +120,23 @@ public:
     return xs_.size();
   }
 
+  /// Retrieves the total weight of the elements in the cache.
+  /// @returns The sum of the weights of all elements.
+  size_t weight() const {
+    return weight_;
+  }
+
   /// Checks whether the cache is empty.
   /// @returns `true` iff the cache holds no elements.
   bool empty() const {
     return xs_.empty();
   }
 
+  /// @returns the hit, miss, eviction, and rejection counters.
+  const cache_statistics& statistics() const {
+    return statistics_;
+  }
+
   // -- iterators -----------------------------------------------------------
 
   auto begin() {
@@ -148,20 +178,22 @@ public:
   /// @param key The key to lookup.
   /// @returns The value corresponding to *key*.
   mapped_type& operator[](const key_type& x) {
-    auto i = tracker_.find(x);
-    if (i == tracker_.end())
-      return insert({x, {}}).first->second;
-    policy::access(xs_, i->second);
+    auto i = find(x);
+    if (i == end())
+      return insert(value_type{x, {}}).first->second;
     return i->second;
   }
 
   // -- modifiers -----------------------------------------------------------
 
-  /// Inserts a fresh entry in the cache.
+  /// Inserts a fresh entry in the cache, evicting other entries if the new
+  /// one exceeds the capacity. The policy may decline the new entry instead
+  /// of evicting others.
   /// @param key The key mapping to *value*.
   /// @param value The value for *key*.
   /// @returns An pair of an iterator and boolean flag that indicates whether
-  ///          the entry has been added successfully.
+  ///          the entry has been added successfully. The iterator is `end()`
+  ///          if the cache declined the entry.
   template <class T>
   auto insert(T&& x)
   -> std::enable_if_t<
@@ -170,13 +202,19 @@ public:
   > {
     auto i = tracker_.find(x.first);
     if (i != tracker_.end()) {
-      policy::access(xs_, i->second);
-      return {i->second, false};
+      policy_.access(xs_, i->second.position);
+      return {i->second.position, false};
     }
-    if (size() == capacity_)
+    auto w = weigh(x.second);
+    if (!admit(x.first, w)) {
+      ++statistics_.rejections;
+      return {xs_.end(), false};
+    }
+    while (weight_ + w > capacity_)
       evict();
-    auto j = policy::insert(xs_, std::forward<T>(x));
-    tracker_.emplace(j->first, j);
+    auto j = policy_.insert(xs_, std::forward<T>(x));
+    tracker_.emplace(j->first, entry{j, w});
+    weight_ += w;
     return {j, true};
   }
 
@@ -192,50 +230,60 @@ public:
     auto i = tracker_.find(x);
     if (i == tracker_.end())
       return 0;
-    xs_.erase(i->second);
+    weight_ -= i->second.weight;
+    xs_.erase(i->second.position);
     tracker_.erase(i);
     return 1;
   }
 
   /// Removes an entry for a given key without invoking the eviction callback.
   void erase(iterator i) {
-    auto j = tracker_.begin();
-    while (j != tracker_.end()) {
-      if (j->second == i)
-        j = tracker_.erase(j);
-      else
-        ++j;
-    }
-    xs_.erase(i);
+    erase(i->first);
   }
 
   /// Removes all elements from the cache.
   void clear() {
     xs_.clear();
     tracker_.clear();
+    weight_ = 0;
   }
 
   // -- lookup --------------------------------------------------------------
 
+  /// Looks up an element and counts the lookup as an access. Insertions do
+  /// not count as accesses, since they usually follow an unsuccessful lookup.
   auto find(const key_type& x) {
+    policy_.record(x);
     auto i = tracker_.find(x);
-    if (i == tracker_.end())
+    if (i == tracker_.end()) {
+      ++statistics_.misses;
       return xs_.end();
-    policy::access(xs_, i->second);
-    return i->second;
+    }
+    ++statistics_.hits;
+    policy_.access(xs_, i->second.position);
+    return i->second.position;
   }
 
   size_t count(const key_type& x) {
     return find(x) == end() ? 0 : 1;
   }
 
+  /// Checks whether the cache holds an element without counting an access.
+  bool contains(const key_type& x) const {
+    return tracker_.count(x) > 0;
+  }
+
   // -- concepts ------------------------------------------------------------
 
   template <class Inspector>
   friend auto inspect(Inspector& f, cache& c) {
     auto load = [&]() -> error {
-      for (auto i = c.xs_.begin(); i != c.xs_.end(); ++i)
-        c.tracker_.emplace(i->first, i);
+      c.weight_ = 0;
+      for (auto i = c.xs_.begin(); i != c.xs_.end(); ++i) {
+        auto w = c.weigh(i->second);
+        c.tracker_.emplace(i->first, entry{i, w});
+        c.weight_ += w;
+      }
       return {};
     };
     return f(c.xs_, c.capacity_, caf::meta::load_callback(load));
@@ -246,10 +294,38 @@ public:
   }
 
 private:
+  struct entry {
+    iterator position;
+    size_t weight;
+  };
+
+  size_t weigh(const mapped_type& x) const {
+    return weigh_ ? weigh_(x) : 1;
+  }
+
+  // Checks whether a new entry may replace the entries in front of the
+  // eviction order that make room for it.
+  bool admit(const key_type& x, size_t w) const {
+    if (w > capacity_)
+      return false;
+    auto freed = size_t{0};
+    for (auto i = xs_.begin(); weight_ + w > capacity_ + freed; ++i) {
+      VAST_ASSERT(i != xs_.end());
+      if (!policy_.admit(x, i->first))
+        return false;
+      freed += tracker_.find(i->first)->second.weight;
+    }
+    return true;
+  }
+
   std::list<value_type> xs_;
-  std::unordered_map<key_type, iterator> tracker_;
+  std::unordered_map<key_type, entry> tracker_;
   evict_callback on_evict_;
+  weigh_function weigh_;
   size_t capacity_;
+  size_t weight_ = 0;
+  Policy policy_;
+  cache_statistics statistics_;
 };
 
 /// A *least recently used* (LRU) cache eviction policy.
@@ -263,6 +339,16 @@ struct lru {
   static auto insert(List& xs, T&& x) {
     return xs.insert(xs.end(), std::forward<T>(x));
   }
+
+  template <class Key>
+  static void record(const Key&) {
+    // nop
+  }
+
+  template <class Key>
+  static bool admit(const Key&, const Key&) {
+    return true;
+  }
 };
 
 /// A *most recently used* (MRU) cache eviction policy.
@@ -276,7 +362,46 @@ struct mru {
   static auto insert(List& xs, T&& x) {
     return xs.insert(xs.begin(), std::forward<T>(x));
   }
+
+  template <class Key>
+  static void record(const Key&) {
+    // nop
+  }
+
+  template <class Key>
+  static bool admit(const Key&, const Key&) {
+    return true;
+  }
 };
 
-} // namespace vast::detail
+/// A scan-resistant *TinyLFU* policy that evicts in LRU order, but admits a
+/// new element only if it was accessed recently at least as often as each
+/// element it would evict. A sketch tracks the access frequencies of all
+/// keys, including those not in the cache. Thus, a scan over many elements
+/// that are accessed once cannot displace elements that are accessed
+/// repeatedly.
+class tiny_lfu : public lru {
+public:
+  /// Constructs the policy.
+  /// @param width The width of the frequency sketch, which should exceed the
+  ///              number of elements in the cache.
+  explicit tiny_lfu(size_t width = 1024) : sketch_{width} {
+    // nop
+  }
+
+  template <class Key>
+  void record(const Key& x) {
+    sketch_.add(std::hash<Key>{}(x));
+  }
+
+  template <class Key>
+  bool admit(const Key& candidate, const Key& victim) const {
+    return sketch_.estimate(std::hash<Key>{}(candidate))
+           >= sketch_.estimate(std::hash<Key>{}(victim));
+  }
 
+private:
+  frequency_sketch sketch_;
+};
+
+} // namespace vast::detail
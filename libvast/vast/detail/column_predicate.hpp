@@ -0,0 +1,67 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+#pragma once
+
+#include "vast/address.hpp"
+#include "vast/aliases.hpp"
+#include "vast/detail/type_traits.hpp"
+#include "vast/operator.hpp"
+#include "vast/port.hpp"
+#include "vast/subnet.hpp"
+#include "vast/time.hpp"
+#include "vast/view.hpp"
+
+#include <caf/sum_type.hpp>
+
+#include <string_view>
+
+namespace vast::detail {
+
+/// Dispatches a relational operator and its right-hand side once per column
+/// instead of once per row. The function *f* receives a unary predicate over
+/// values of type `T` that behaves like `evaluate_view(x, op, rhs)`. If `T` is
+/// a basic type, *rhs* has type `T`, and *op* is a comparison, the predicate
+/// compares values directly; otherwise it falls back to `evaluate_view`.
+/// @param op The relational operator.
+/// @param rhs The RHS of the predicate.
+/// @param f The function that consumes the predicate.
+template <class T, class F>
+void with_column_predicate(relational_operator op, const data_view& rhs,
+                           F f) {
+  if constexpr (is_any_v<T, bool, integer, count, real, duration, time,
+                         std::string_view, address, subnet, port>) {
+    if (auto y = caf::get_if<T>(&rhs)) {
+      auto x = *y;
+      switch (op) {
+        default:
+          break;
+        case equal:
+          return f([&](const T& lhs) { return lhs == x; });
+        case not_equal:
+          return f([&](const T& lhs) { return lhs != x; });
+        case less:
+          return f([&](const T& lhs) { return lhs < x; });
+        case less_equal:
+          return f([&](const T& lhs) { return lhs <= x; });
+        case greater:
+          return f([&](const T& lhs) { return lhs > x; });
+        case greater_equal:
+          return f([&](const T& lhs) { return lhs >= x; });
+      }
+    }
+  }
+  f([&](const T& lhs) { return evaluate_view(data_view{lhs}, op, rhs); });
+}
+
+} // namespace vast::detail
@@ -0,0 +1,64 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace vast::detail {
+
+/// A count-min sketch with small saturating counters that estimates how
+/// often a hash value occurred recently. After a number of additions
+/// proportional to its width, the sketch halves all counters such that the
+/// estimates favor recent over past occurrences.
+class frequency_sketch {
+public:
+  /// The number of hash functions, i.e., the rows of the sketch.
+  static constexpr size_t depth = 4;
+
+  /// The maximum value of a counter.
+  static constexpr uint8_t max_count = 15;
+
+  /// Constructs a sketch.
+  /// @param width The number of counters per row, rounded up to the next
+  ///              power of two.
+  explicit frequency_sketch(size_t width = 1024);
+
+  /// Records an occurrence of a hash value.
+  /// @param digest The hash value.
+  void add(size_t digest);
+
+  /// Estimates the number of recent occurrences of a hash value.
+  /// @param digest The hash value.
+  /// @returns An upper bound of the number of recent occurrences of
+  ///          *digest*, but at most `max_count`.
+  uint8_t estimate(size_t digest) const;
+
+  /// @returns the number of additions since the last halving.
+  size_t samples() const {
+    return samples_;
+  }
+
+private:
+  size_t index(size_t digest, size_t row) const;
+
+  void age();
+
+  size_t width_;
+  size_t samples_ = 0;
+  std::vector<uint8_t> counters_;
+};
+
+} // namespace vast::detail
@@ -16,6 +16,7 @@
 #include "vast/detail/assert.hpp"
 #include "vast/error.hpp"
 #include "vast/expression.hpp"
+#include "vast/ids.hpp"
 #include "vast/offset.hpp"
 #include "vast/operator.hpp"
 #include "vast/time.hpp"
@@ -195,6 +196,39 @@ struct table_slice_row_evaluator {
   relational_operator op_;
 };
 
+/// Evaluates an entire table slice over a [resolved](@ref type_extractor)
+/// expression, one column at a time. Every predicate yields a bitmap for its
+/// column, and the connectives combine these bitmaps.
+struct table_slice_evaluator {
+  table_slice_evaluator(const table_slice& slice);
+
+  ids operator()(caf::none_t);
+  ids operator()(const conjunction& c);
+  ids operator()(const disjunction& d);
+  ids operator()(const negation& n);
+  ids operator()(const predicate& p);
+  ids operator()(const attribute_extractor& e, const data& d);
+  ids operator()(const key_extractor&, const data&);
+  ids operator()(const type_extractor&, const data&);
+  ids operator()(const data_extractor& e, const data& d);
+
+  template <class T>
+  ids operator()(const data& d, const T& x) {
+    return (*this)(x, d);
+  }
+
+  template <class T, class U>
+  ids operator()(const T&, const U&) {
+    return constant(false);
+  }
+
+  /// @returns a bitmap that has the same value for all rows of the slice.
+  ids constant(bool x) const;
+
+  const table_slice& slice_;
+  relational_operator op_;
+};
+
 /// Evaluates a single row of a table slice over a [resolved](@ref
 /// type_extractor) expression.
 /// @param slice The table slice for evaluation.
@@ -212,6 +246,16 @@ bool evaluate_at(const table_slice& slice, size_t row, const expression& expr);
 /// @returns a bitmap containing all IDs of matching rows.
 ids evaluate(const table_slice& slice, const expression& expr);
 
+/// Evaluates a selection of rows in a table slice over a [resolved](@ref
+/// type_extractor) expression. Sparse selections are evaluated row by row and
+/// dense selections column by column.
+/// @param slice The table slice for evaluation.
+/// @param expr A resolved expression for evaluating the selected rows.
+/// @param selection The IDs of the rows to evaluate.
+/// @returns a bitmap containing the IDs of all matching rows in *selection*.
+ids evaluate(const table_slice& slice, const expression& expr,
+             const ids& selection);
+
 /// Checks whether a [resolved](@ref type_extractor) expression matches a given
 /// type. That is, this visitor tests whether an expression consists of a
 /// viable set of predicates for a type. For conjunctions, all operands must
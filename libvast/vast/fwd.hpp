@@ -22,6 +22,7 @@ namespace vast {
 
 class abstract_type;
 class address;
+class aggregation;
 class arrow_table_slice;
 class arrow_table_slice_builder;
 class bitmap;
@@ -56,6 +57,7 @@ class value_index;
 // -- structs ------------------------------------------------------------------
 
 struct address_type;
+struct aggregate;
 struct alias_type;
 struct attribute_extractor;
 struct bool_type;
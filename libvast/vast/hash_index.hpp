@@ -13,15 +13,20 @@
 
 #pragma once
 
+#include "vast/chunk.hpp"
 #include "vast/concept/hashable/uhash.hpp"
 #include "vast/concept/hashable/xxhash.hpp"
 #include "vast/data.hpp"
 #include "vast/detail/assert.hpp"
+#include "vast/detail/flat_map.hpp"
+#include "vast/detail/narrow.hpp"
 #include "vast/detail/steady_map.hpp"
 #include "vast/detail/type_traits.hpp"
 #include "vast/value_index.hpp"
 #include "vast/view.hpp"
+#include "vast/word.hpp"
 
+#include <caf/binary_deserializer.hpp>
 #include <caf/deserializer.hpp>
 #include <caf/expected.hpp>
 #include <caf/optional.hpp>
@@ -33,7 +38,7 @@
 #include <cstring>
 #include <string>
 #include <type_traits>
-#include <unordered_set>
+#include <utility>
 #include <vector>
 
 namespace vast {
@@ -42,11 +47,14 @@ namespace vast {
 /// hash_index computes a digest of the input data and concatenates all digests
 /// in a sequence. Optionally, it chops off the values after a fixed number of
 /// bytes for a more space-efficient representation, at the cost of more false
-/// positives. A separate "satellite structure" keeps track of hash collision
-/// to make the index exact. The additional state to build this satellite
-/// structure only exists during the construction of the index. Upon
-/// descruction, this extra state ceases to exist and it will not be possible
-/// to append further values when deserializing an existing index.
+/// positives. An open-addressing table keeps track of the digests in use to
+/// resolve hash collisions: each slot stores the full 64-bit fingerprint of
+/// the value owning a digest, and a colliding value rehashes with a new seed
+/// until it finds a free digest. Only the seeds of colliding values survive
+/// serialization, so it will not be possible to append further values when
+/// deserializing an existing index. Since neither digests nor fingerprints
+/// identify a value uniquely, lookups may yield false positives and the index
+/// is never exact.
 template <size_t Bytes>
 class hash_index : public value_index {
   static_assert(Bytes > 0, "cannot use 0 bytes to store a digest");
@@ -63,6 +71,14 @@ class hash_index : public value_index {
   /// The maximum number of hash rounds to try to find a new digest.
   static constexpr size_t max_hash_rounds = 32;
 
+  /// The initial number of slots in the digest table.
+  static constexpr size_t initial_slots = 1024;
+
+  /// The version of the serialization format. Version 0 denotes the legacy
+  /// format that stored the digests as a sequence, followed by the seeds
+  /// keyed by value.
+  static constexpr uint8_t format_version = 1;
+
 public:
   using hasher_type = xxhash64;
   using digest_type = std::array<byte, Bytes>;
@@ -75,10 +91,7 @@ public:
   /// @param seed The seed to use during the hash.
   /// @returns The chopped digest.
   static digest_type hash(data_view x, size_t seed = 0) {
-    digest_type result;
-    auto digest = uhash<hasher_type>{seed}(x);
-    std::memcpy(result.data(), &digest, Bytes);
-    return result;
+    return chop(uhash<hasher_type>{seed}(x));
   }
 
   /// Constructs a hash index for a particular type and digest cutoff.
@@ -88,92 +101,185 @@ public:
     : value_index{std::move(t), std::move(opts)} {
   }
 
+  bool exact(relational_operator, data_view) const override {
+    // Distinct values may share a digest, and a fingerprint collision during
+    // construction may even assign a value the digest of another one.
+    return false;
+  }
+
   caf::error serialize(caf::serializer& sink) const override {
-    // Prune unneeded seeds.
-    decltype(seeds_) non_null_seeds;
-    for (auto& [k, v] : seeds_)
-      if (v > 0)
-        non_null_seeds.emplace(k, v);
+    // The legacy format begins with the sequence of digests, which is only
+    // empty for an empty index. We begin with an empty sequence followed by
+    // the format version instead. The digests are a flat byte sequence,
+    // which we write in one go.
+    auto marker = size_t{0};
+    auto version = format_version;
+    auto n = uint64_t{num_values()};
+    auto ptr = const_cast<byte*>(digest_bytes());
     return caf::error::eval([&] { return value_index::serialize(sink); },
-                            [&] { return sink(digests_, non_null_seeds); });
+                            [&] { return sink.begin_sequence(marker); },
+                            [&] { return sink.end_sequence(); },
+                            [&] { return sink(version, seeds_, n); },
+                            [&] { return sink.apply_raw(n * Bytes, ptr); });
   }
 
   caf::error deserialize(caf::deserializer& source) override {
-    return caf::error::eval([&] { return value_index::deserialize(source); },
-                            [&] { return source(digests_, seeds_); });
+    uint64_t n = 0;
+    if (auto err = deserialize_header(source, n))
+      return err;
+    digests_.resize(n);
+    return source.apply_raw(n * Bytes, digests_.data());
+  }
+
+  /// Loads the index from a chunk without copying the digests, which remain
+  /// in the chunk. Indexes in the legacy format still get copied.
+  caf::error load(chunk_ptr chunk) override {
+    VAST_ASSERT(chunk != nullptr);
+    caf::binary_deserializer source{nullptr, chunk->data(), chunk->size()};
+    uint64_t n = 0;
+    if (auto err = deserialize_header(source, n))
+      return err;
+    if (n == 0)
+      return caf::none;
+    if (n * Bytes > source.remaining())
+      return make_error(ec::format_error, "hash index lacks digests");
+    auto offset = chunk->size() - source.remaining();
+    auto length = n * Bytes == source.remaining() ? 0 : n * Bytes;
+    chunk_ = chunk->slice(offset, length);
+    return caf::none;
   }
 
 private:
-  struct key {
-    friend bool operator==(key x, digest_type y) {
-      return std::memcmp(x.bytes.data(), y.data(), y.size()) == 0;
-    }
+  /// A slot in the digest table. The fingerprint 0 marks an empty slot.
+  struct slot {
+    uint64_t digest = 0;
+    uint64_t fingerprint = 0;
+  };
 
-    friend bool operator!=(key x, digest_type y) {
-      return !(x == y);
-    }
+  /// Chops a hash value into a digest.
+  static digest_type chop(hasher_type::result_type x) {
+    digest_type result;
+    std::memcpy(result.data(), &x, Bytes);
+    return result;
+  }
 
-    friend bool operator==(digest_type x, key y) {
-      return y == x;
-    }
+  /// Widens a digest into an integer for comparison.
+  static uint64_t widen(const digest_type& x) {
+    auto result = uint64_t{0};
+    std::memcpy(&result, x.data(), Bytes);
+    return result;
+  }
 
-    friend bool operator!=(digest_type x, key y) {
-      return !(x == y);
-    }
+  /// Computes the fingerprint that identifies a value in the digest table.
+  static uint64_t fingerprint(data_view x) {
+    auto result = uint64_t{uhash<hasher_type>{}(x)};
+    return result != 0 ? result : 1;
+  }
 
-    friend bool operator==(key x, key y) {
-      return x == y.bytes;
+  /// Reads everything up to the digests. An index in the legacy format is
+  /// read entirely.
+  /// @param source The deserializer to read from.
+  /// @param n Receives the number of digests that remain to be read.
+  caf::error deserialize_header(caf::deserializer& source, uint64_t& n) {
+    n = 0;
+    size_t legacy_digests = 0;
+    if (auto err = value_index::deserialize(source))
+      return err;
+    if (auto err = source.begin_sequence(legacy_digests))
+      return err;
+    if (legacy_digests > 0) {
+      digests_.resize(legacy_digests);
+      for (auto& digest : digests_)
+        if (auto err = source(digest))
+          return err;
+      detail::steady_map<data, size_t> legacy_seeds;
+      if (auto err = caf::error::eval([&] { return source.end_sequence(); },
+                                      [&] { return source(legacy_seeds); }))
+        return err;
+      for (auto& [x, seed] : legacy_seeds)
+        seeds_.emplace(fingerprint(make_view(x)),
+                       detail::narrow_cast<uint8_t>(seed));
+      return caf::none;
     }
+    // An empty index in the legacy format ends with an empty sequence of
+    // seeds, which reads as version 0.
+    auto version = uint8_t{0};
+    if (auto err = caf::error::eval([&] { return source.end_sequence(); },
+                                    [&] { return source(version); }))
+      return err;
+    if (version == 0)
+      return caf::none;
+    if (version > format_version)
+      return make_error(ec::version_error, "unsupported hash index version",
+                        version);
+    return source(seeds_, n);
+  }
 
-    friend bool operator!=(key x, key y) {
-      return !(x == y);
-    }
+  /// @returns the number of digests, which equals the number of values.
+  size_t num_values() const {
+    return chunk_ ? chunk_->size() / Bytes : digests_.size();
+  }
 
-    digest_type bytes;
-  };
+  /// @returns a pointer to the contiguous digests.
+  const byte* digest_bytes() const {
+    if (chunk_)
+      return reinterpret_cast<const byte*>(chunk_->data());
+    return reinterpret_cast<const byte*>(digests_.data());
+  }
 
-  struct key_hasher {
-    auto operator()(const key& x) const {
-      auto result = uint64_t{0};
-      std::memcpy(&result, x.bytes.data(), x.bytes.size());
-      return result;
-    }
-  };
+  /// Locates the slot that holds a digest, or the empty slot where it belongs.
+  slot& probe(uint64_t digest) {
+    // The digests are uniformly distributed, so their low bits suffice to
+    // select a slot.
+    auto mask = slots_.size() - 1;
+    auto i = digest & mask;
+    while (slots_[i].fingerprint != 0 && slots_[i].digest != digest)
+      i = (i + 1) & mask;
+    return slots_[i];
+  }
 
-  // TODO: remove this function as of C++20.
-  auto find_seed(data_view x) const {
-    auto pred = [&](const auto& xs) { return is_equal(xs.first, x); };
-    auto& xs = as_vector(seeds_);
-    return std::find_if(xs.begin(), xs.end(), pred);
+  /// Doubles the capacity of the digest table once it exceeds a load factor
+  /// of 0.7.
+  void reserve_slot() {
+    if (slots_.empty()) {
+      slots_.resize(initial_slots);
+      return;
+    }
+    if ((num_digests_ + 1) * 10 <= slots_.size() * 7)
+      return;
+    auto old = std::exchange(slots_, std::vector<slot>(slots_.size() * 2));
+    for (auto& x : old)
+      if (x.fingerprint != 0)
+        probe(x.digest) = x;
   }
 
   // Retrieves the unique digest for a given input or generates a new one.
-  caf::optional<key> make_digest(data_view x) {
+  caf::optional<digest_type> make_digest(data_view x) {
+    reserve_slot();
+    auto fp = fingerprint(x);
     for (size_t i = 0; i < max_hash_rounds; ++i) {
-      // Compute a hash digest.
       auto digest = hash(x, i);
-      auto k = key{digest};
-      // If we have never seen this digest before, we're adding it to the list
-      // of seen digests and are done.
-      if (unique_digests_.count(k) == 0) {
-        auto materialized = materialize(x);
-        VAST_ASSERT(seeds_.count(materialized) == 0);
-        seeds_.emplace(std::move(materialized), i);
-        unique_digests_.insert(k);
-        return k;
-      };
-      // If we have seen the digest, check whether we also have a known
-      // preimage.
-      if (auto it = find_seed(x); it != seeds_.end())
-        return key{hash(x, it->second)};
+      auto& s = probe(widen(digest));
+      // If we have never seen this digest before, the value claims it.
+      // Otherwise the digest either belongs to this value already, or we
+      // have a collision and try again with the next seed.
+      if (s.fingerprint == 0) {
+        s = {widen(digest), fp};
+        ++num_digests_;
+        if (i > 0)
+          seeds_.emplace(fp, static_cast<uint8_t>(i));
+        return digest;
+      }
+      if (s.fingerprint == fp)
+        return digest;
     }
     return caf::none;
   }
 
   /// Locates the digest for a given input.
-  key find_digest(data_view x) const {
-    auto i = find_seed(x);
-    return key{i != seeds_.end() ? hash(x, i->second) : hash(x, 0)};
+  digest_type find_digest(data_view x) const {
+    auto i = seeds_.find(fingerprint(x));
+    return hash(x, i != seeds_.end() ? i->second : 0);
   }
 
   bool append_impl(data_view x, id) override {
@@ -183,81 +289,110 @@ private:
     auto digest = make_digest(x);
     if (!digest)
       return false;
-    digests_.push_back(digest->bytes);
+    digests_.push_back(*digest);
     return true;
   }
 
+  /// Scans all digests for the given keys. The comparison processes one
+  /// 64-bit block of digests at a time and is free of branches, which allows
+  /// the compiler to vectorize it.
+  /// @param keys The widened digests to look for.
+  /// @returns The IDs of all values whose digest equals one of *keys*.
+  ids scan(const std::vector<uint64_t>& keys) const {
+    using block_type = ewah_bitmap::block_type;
+    using word_type = word<block_type>;
+    constexpr auto width = size_t{word_type::width};
+    auto num_digests = num_values();
+    VAST_ASSERT(rank(this->mask()) == num_digests);
+    ewah_bitmap result;
+    auto rng = select(this->mask());
+    if (rng.done())
+      return result;
+    // If the values occupy a contiguous ID range, the digest positions map
+    // directly to IDs and we can append entire blocks.
+    auto first = rng.get();
+    auto contiguous = this->mask().size() - first == num_digests;
+    if (contiguous)
+      result.append_bits(false, first);
+    auto bytes = digest_bytes();
+    for (size_t i = 0, last_match = 0; i < num_digests; i += width) {
+      auto n = std::min(num_digests - i, width);
+      auto block = block_type{0};
+      for (size_t j = 0; j < n; ++j) {
+        auto digest = uint64_t{0};
+        std::memcpy(&digest, bytes + (i + j) * Bytes, Bytes);
+        auto match = block_type{0};
+        for (auto key : keys)
+          match |= block_type{digest == key};
+        block |= match << j;
+      }
+      if (contiguous) {
+        result.append_block(block, n);
+        continue;
+      }
+      for (; block != 0; block &= block - 1) {
+        auto k = i + word_type::count_trailing_zeros(block);
+        if (k > last_match)
+          rng.next(k - last_match);
+        result.append_bits(false, rng.get() - result.size());
+        result.append_bit(true);
+        last_match = k;
+      }
+    }
+    return result;
+  }
+
   caf::expected<ids>
   lookup_impl(relational_operator op, data_view x) const override {
-    VAST_ASSERT(rank(this->mask()) == digests_.size());
-    // Implementation of the one-pass search algorithm that computes the
-    // resulting ID set. The predicate depends on the operator and RHS.
-    auto scan = [&](auto predicate) -> ids {
-      ewah_bitmap result;
-      auto rng = select(this->mask());
-      if (rng.done())
-        return result;
-      for (size_t i = 0, last_match = 0; i < digests_.size(); ++i) {
-        if (predicate(digests_[i])) {
-          auto digests_since_last_match = i - last_match;
-          if (digests_since_last_match > 0)
-            rng.next(digests_since_last_match);
-          result.append_bits(false, rng.get() - result.size());
-          result.append_bit(true);
-          last_match = i;
-        }
-      }
-      return result;
-    };
+    std::vector<uint64_t> keys;
     if (op == equal || op == not_equal) {
-      auto k = find_digest(x);
-      auto eq = [=](const digest_type& digest) { return k == digest; };
-      auto ne = [=](const digest_type& digest) { return k != digest; };
-      return op == equal ? scan(eq) : scan(ne);
-    }
-    if (op == in || op == not_in) {
-      // Ensure that the RHS is a list of strings.
-      auto keys = caf::visit(
-        detail::overload([&](auto xs) -> caf::expected<std::vector<key>> {
-          using view_type = decltype(xs);
-          if constexpr (detail::is_any_v<view_type, view<set>, view<vector>>) {
-            std::vector<key> result;
-            result.reserve(xs.size());
-            for (auto x : xs)
-              result.emplace_back(find_digest(x));
-            return result;
-          } else {
-            return make_error(ec::type_clash, "expected set or vector on RHS",
-                              materialize(x));
-          }
-        }),
-        x);
-      if (!keys)
-        return keys.error();
-      // We're good to go with: create the set predicates an run the scan.
-      auto in_pred = [&](const digest_type& digest) {
-        auto cmp = [=](auto& k) { return k == digest; };
-        return std::any_of(keys->begin(), keys->end(), cmp);
-      };
-      auto not_in_pred = [&](const digest_type& digest) {
-        auto cmp = [=](auto& k) { return k == digest; };
-        return std::none_of(keys->begin(), keys->end(), cmp);
+      keys.push_back(widen(find_digest(x)));
+    } else if (op == in || op == not_in) {
+      // Ensure that the RHS is a list of values.
+      auto f = [&](auto xs) -> caf::error {
+        using view_type = decltype(xs);
+        if constexpr (detail::is_any_v<view_type, view<set>, view<vector>>) {
+          keys.reserve(xs.size());
+          for (auto x : xs)
+            keys.push_back(widen(find_digest(x)));
+          return caf::none;
+        } else {
+          return make_error(ec::type_clash, "expected set or vector on RHS",
+                            materialize(x));
+        }
       };
-      return op == in ? scan(in_pred) : scan(not_in_pred);
+      if (auto err = caf::visit(f, x))
+        return err;
+    } else {
+      return make_error(ec::unsupported_operator, op);
+    }
+    auto result = scan(keys);
+    if (op == not_equal || op == not_in) {
+      // The caller masks out the positions of nil values afterwards.
+      result.append_bits(false, this->mask().size() - result.size());
+      result.flip();
     }
-    return make_error(ec::unsupported_operator, op);
+    return result;
   }
 
   bool immutable() const {
-    return unique_digests_.empty() && !digests_.empty();
+    return chunk_ != nullptr || (slots_.empty() && !digests_.empty());
   }
 
   std::vector<digest_type> digests_;
-  std::unordered_set<key, key_hasher> unique_digests_;
 
-  // TODO: Once we can use C++20 and have a standard library that implements
-  // key equivalence properly, we can switch to std::unordered_map.
-  detail::steady_map<data, size_t> seeds_;
+  /// The digests of an index loaded from a chunk, in place of `digests_`.
+  chunk_ptr chunk_;
+
+  /// The open-addressing table of all digests in use. It only exists while
+  /// building the index.
+  std::vector<slot> slots_;
+
+  /// The number of occupied slots in the digest table.
+  size_t num_digests_ = 0;
+
+  /// The seeds of all values whose digest collided, keyed by fingerprint.
+  detail::flat_map<uint64_t, uint8_t> seeds_;
 };
 
 } // namespace vast
@@ -15,14 +15,17 @@
 
 #include "vast/fwd.hpp"
 #include "vast/synopsis.hpp"
+#include "vast/time.hpp"
 #include "vast/type.hpp"
 #include "vast/uuid.hpp"
 
 #include <caf/fwd.hpp>
+#include <caf/optional.hpp>
 #include <caf/settings.hpp>
 
 #include <functional>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -40,11 +43,30 @@ public:
   /// @param partition The partition ID that *slice* belongs to.
   void add(const uuid& partition, const table_slice& slice);
 
+  /// Removes all data of a partition from the index.
+  /// @param partition The partition ID.
+  void erase(const uuid& partition);
+
   /// Retrieves the list of candidate partition IDs for a given expression.
   /// @param expr The expression to lookup.
   /// @returns A vector of UUIDs representing candidate partitions.
   std::vector<uuid> lookup(const expression& expr) const;
 
+  /// Retrieves the latest point in time of a partition for a key.
+  /// @param partition The partition ID.
+  /// @param key The key of the time fields, interpreted as field name suffix.
+  /// @returns The maximum of all time synopses for fields matching *key* or
+  ///          `none` if the partition has no such synopsis.
+  caf::optional<time> upper_bound(const uuid& partition,
+                                  std::string_view key) const;
+
+  /// Retrieves the latest event timestamp of a partition.
+  /// @param partition The partition ID.
+  /// @returns The maximum of all time synopses for fields with the
+  ///          `timestamp` attribute, or `none` if a layout of the partition
+  ///          has no such synopsis.
+  caf::optional<time> upper_bound(const uuid& partition) const;
+
   /// Gets the options for the synopsis factory.
   /// @returns A reference to the synopsis options.
   caf::settings& factory_options();
@@ -72,11 +94,11 @@ private:
   // Synopsis structures for a given layout.
   using table_synopsis = std::vector<synopsis_ptr>;
 
-  /// Contains synopses per table layout.
-  using partition_synopsis = std::unordered_map<record_type, table_synopsis>;
+  /// Contains synopses per interned table layout.
+  using partition_synopsis = std::unordered_map<type, table_synopsis>;
 
-  /// Layouts for which we cannot generate a synopsis structure.
-  std::unordered_set<record_type> blacklisted_layouts_;
+  /// Interned layouts for which we cannot generate a synopsis structure.
+  std::unordered_set<type> blacklisted_layouts_;
 
   /// Maps a partition ID to the synopses for that partition.
   std::unordered_map<uuid, partition_synopsis> partition_synopses_;
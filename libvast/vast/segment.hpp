@@ -15,8 +15,10 @@
 
 #include <cstdint>
 #include <memory>
+#include <string>
 #include <vector>
 
+#include <caf/atom.hpp>
 #include <caf/expected.hpp>
 #include <caf/fwd.hpp>
 #include <caf/intrusive_ptr.hpp>
@@ -24,9 +26,12 @@
 
 #include "vast/aliases.hpp"
 #include "vast/chunk.hpp"
+#include "vast/compression.hpp"
+#include "vast/data.hpp"
 #include "vast/fwd.hpp"
 #include "vast/ids.hpp"
 #include "vast/segment_header.hpp"
+#include "vast/type.hpp"
 #include "vast/uuid.hpp"
 
 namespace vast {
@@ -58,6 +63,13 @@ using segment_ptr = caf::intrusive_ptr<segment>;
 ///               .                                         . v
 ///               +-----------------------------------------+
 ///
+/// A table slice is either stored as a whole or, in a *columnar* segment, as
+/// one separately addressable chunk per column. Either way, the meta data of a
+/// table slice refers to its layout in a per-segment dictionary that holds
+/// every distinct layout only once. The meta data of a columnar table slice
+/// also carries the minimum and maximum value of each column of a basic type,
+/// which allows ::lookup to skip table slices that cannot match an
+/// expression.
 class segment : public caf::ref_counted {
   friend segment_builder;
 
@@ -68,7 +80,20 @@ public:
   static inline constexpr segment_magic_type magic = 0x2a547ea8;
 
   /// The current version of the segment format.
-  static inline constexpr segment_version_type version = 1;
+  /// Version 2 added per-slice compression.
+  /// Version 3 added columnar table slices.
+  /// Version 4 moved the layouts of all table slices into a dictionary.
+  static inline constexpr segment_version_type version = 4;
+
+  /// Per-column meta data of a columnar table slice.
+  struct column_synopsis {
+    int64_t start;    ///< The byte offset from the beginning of the payload.
+    int64_t end;      ///< The byte offset to one past the end of the column.
+    compression method = compression::null; ///< The codec of the column bytes.
+    uint64_t bytes = 0; ///< The number of uncompressed bytes of the column.
+    data min;         ///< The smallest non-nil value, if of a basic type.
+    data max;         ///< The largest non-nil value, if of a basic type.
+  };
 
   /// Per-slice meta data.
   struct table_slice_synopsis {
@@ -76,11 +101,17 @@ public:
     int64_t end;      ///< The byte offset to one past the end of the slice.
     id offset;        ///< The offset in the ID space where the slice starts.
     uint64_t size;    ///< The number of rows in the slice.
+    compression method = compression::null; ///< The codec of the slice bytes.
+    uint64_t bytes = 0; ///< The number of uncompressed bytes of the slice.
+    uint32_t layout = 0; ///< The index of the layout in the dictionary.
+    caf::atom_value implementation = caf::atom(""); ///< The slice type.
+    std::vector<column_synopsis> columns; ///< Empty unless columnar.
   };
 
   /// Meta data for a segment.
   struct meta_data {
     std::vector<table_slice_synopsis> slices;
+    std::vector<record_type> layouts; ///< The dictionary of slice layouts.
   };
 
   /// Constructs a segment.
@@ -97,12 +128,61 @@ public:
   /// @returns the number of tables slices in the segment.
   size_t num_slices() const;
 
-  /// Locates the table slices for a given set of IDs.
+  /// Locates the table slices for a given set of IDs. Slices that contain
+  /// erased events get cut such that the result contains no erased events.
   /// @param xs The IDs to lookup.
   /// @returns The table slices according to *xs*.
   caf::expected<std::vector<table_slice_ptr>>
   lookup(const ids& xs) const;
 
+  /// Locates the table slices for a given set of IDs, reading only what is
+  /// necessary from columnar table slices.
+  /// @param xs The IDs to lookup.
+  /// @param expr Skips columnar table slices whose column statistics rule out
+  ///             any match. An empty expression skips nothing.
+  /// @param keys Restricts the result to the columns matching one of the
+  ///             keys as suffix. An empty list keeps all columns.
+  /// @returns The table slices according to *xs*, without slices that have
+  ///          no column matching *keys*.
+  caf::expected<std::vector<table_slice_ptr>>
+  lookup(const ids& xs, const expression& expr,
+         const std::vector<std::string>& keys) const;
+
+  /// Locates the table slices that ::lookup reads for a given set of IDs
+  /// without reading them.
+  /// @param xs The IDs to lookup.
+  /// @param expr Skips columnar table slices whose column statistics rule out
+  ///             any match. An empty expression skips nothing.
+  /// @returns The positions of the table slices in the meta data.
+  std::vector<size_t> locate(const ids& xs, const expression& expr) const;
+
+  /// Reads a table slice that ::locate returned. Unlike ::lookup, this
+  /// touches no state that ::erase modifies, and may thus run concurrently.
+  /// @param slice The position of the table slice in the meta data.
+  /// @param keys Restricts the result to the columns matching one of the
+  ///             keys as suffix. An empty list keeps all columns.
+  /// @param tombstones The IDs of erased events to cut from the slice.
+  /// @returns The table slice without erased events, or nothing if it has
+  ///          no column matching *keys*.
+  caf::expected<std::vector<table_slice_ptr>>
+  extract(size_t slice, const std::vector<std::string>& keys,
+          const ids& tombstones) const;
+
+  /// Marks events as erased without rewriting the segment, such that
+  /// ::lookup no longer returns them.
+  /// @param xs The IDs of the erased events.
+  void erase(const ids& xs);
+
+  /// @returns the IDs of the events that have been erased from the segment.
+  const ids& tombstones() const {
+    return tombstones_;
+  }
+
+  /// Hints the operating system to read the table slices for a given set of
+  /// IDs ahead, such that a subsequent ::lookup finds them in memory.
+  /// @param xs The IDs to lookup later.
+  void prefetch(const ids& xs) const;
+
   /// @returns the meta data for the segment.
   const auto& meta() const {
     return meta_;
@@ -121,21 +201,41 @@ private:
   caf::expected<table_slice_ptr>
   make_slice(const table_slice_synopsis& slice) const;
 
+  caf::expected<table_slice_ptr>
+  make_slice(const table_slice_synopsis& slice,
+             const std::vector<std::string>& keys) const;
+
+  caf::expected<chunk_ptr> read(int64_t start, int64_t end,
+                                compression method, uint64_t bytes) const;
+
+  /// Interns all layouts of the dictionary, such that the table slices of
+  /// this segment share their canonical instances.
+  void intern_layouts();
+
   meta_data meta_;
+  std::vector<type> interned_layouts_;
   chunk_ptr chunk_;
   segment_header header_;
+  ids tombstones_;
 };
 
+/// @relates segment::column_synopsis
+template <class Inspector>
+auto inspect(Inspector& f, segment::column_synopsis& x) {
+  return f(x.start, x.end, x.method, x.bytes, x.min, x.max);
+}
+
 /// @relates segment::table_slice_synopsis
 template <class Inspector>
 auto inspect(Inspector& f, segment::table_slice_synopsis& x) {
-  return f(x.start, x.end, x.offset, x.size);
+  return f(x.start, x.end, x.offset, x.size, x.method, x.bytes, x.layout,
+           x.implementation, x.columns);
 }
 
 /// @relates segment::meta_data
 template <class Inspector>
 auto inspect(Inspector& f, segment::meta_data& x) {
-  return f(x.slices);
+  return f(x.slices, x.layouts);
 }
 
 /// @relates segment::meta_data
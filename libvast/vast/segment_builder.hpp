@@ -14,13 +14,18 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <caf/expected.hpp>
 #include <caf/fwd.hpp>
 
 #include "vast/aliases.hpp"
+#include "vast/compression.hpp"
 #include "vast/segment.hpp"
+#include "vast/type.hpp"
 #include "vast/uuid.hpp"
 
 namespace vast {
@@ -30,7 +35,11 @@ namespace vast {
 class segment_builder {
 public:
   /// Constructs a segment builder.
-  segment_builder();
+  /// @param method The compression method for the serialized table slices.
+  /// @param columnar Whether to store each column of a table slice as a
+  ///                 separate chunk.
+  explicit segment_builder(compression method = compression::null,
+                           bool columnar = false);
 
   /// Adds a table slice to the segment.
   /// @returns An error if adding the table slice failed.
@@ -52,6 +61,12 @@ public:
   /// @returns The UUID for the segment under construction.
   const uuid& id() const;
 
+  /// @returns The compression method for table slices.
+  compression method() const;
+
+  /// @returns Whether the builder stores table slices column by column.
+  bool columnar() const;
+
   /// @returns The number of bytes of the current segment.
   size_t table_slice_bytes() const;
 
@@ -64,12 +79,29 @@ public:
   void reset();
 
 private:
+  // Serializes into the table slice buffer by invoking `f` with a serializer,
+  // compressing the bytes if possible. Returns the effective compression
+  // method and the uncompressed size.
+  template <class F>
+  caf::expected<std::pair<compression, uint64_t>> append(F f);
+
+  // Returns the index of `layout` in the layout dictionary of the segment,
+  // adding the layout if necessary.
+  uint32_t intern(const record_type& layout);
+
+  // Adds a table slice column by column.
+  caf::error add_columns(const table_slice& x);
+
   // Segment state
+  compression method_;
+  bool columnar_;
   segment::meta_data meta_;
+  std::unordered_map<type_digest, uint32_t> layouts_;
   uuid id_;
   // Table slice state
   vast::id min_table_slice_offset_;
   std::vector<char> table_slice_buffer_;
+  std::vector<char> compression_buffer_;
   // Lookup cache
   std::vector<table_slice_ptr> slices_;
 };
@@ -13,6 +13,9 @@
 
 #pragma once
 
+#include <unordered_map>
+#include <vector>
+
 #include <caf/fwd.hpp>
 
 #include "vast/filesystem.hpp"
@@ -38,16 +41,22 @@ public:
   /// Constructs a segment store.
   /// @param dir The directory where to store state.
   /// @param max_segment_size The maximum segment size in bytes.
-  /// @param in_memory_segments The number of semgents to cache in memory.
+  /// @param in_memory_segments The number of semgents to cache in memory. The
+  ///        cache weighs every segment at most `max_segment_size` bytes.
+  /// @param method The compression method for table slices in new segments.
+  /// @param columnar Whether new segments store table slices column by column.
   /// @pre `max_segment_size > 0`
   static segment_store_ptr make(path dir, size_t max_segment_size,
-                                size_t in_memory_segments);
+                                size_t in_memory_segments,
+                                compression method = compression::null,
+                                bool columnar = false);
 
   ~segment_store();
 
   /// @cond PRIVATE
 
-  segment_store(path dir, uint64_t max_segment_size, size_t in_memory_segments);
+  segment_store(path dir, uint64_t max_segment_size, size_t in_memory_segments,
+                compression method, bool columnar);
 
   /// @endcond
 
@@ -58,11 +67,22 @@ public:
     return dir_ / "meta";
   }
 
+  /// @returns the path for the journal of changes to the meta information
+  ///          since the last checkpoint at ::meta_path.
+  path journal_path() const {
+    return dir_ / "journal";
+  }
+
   /// @returns the path for storing the segments.
   path segment_path() const {
     return dir_ / "segments";
   }
 
+  /// @returns the path for storing the deletion bitmaps of segments.
+  path tombstone_path() const {
+    return dir_ / "tombstones";
+  }
+
   /// @returns whether the store has no unwritten data pending.
   bool dirty() const noexcept {
     return builder_.table_slice_bytes() != 0;
@@ -75,7 +95,7 @@ public:
 
   /// @returns whether `x` is currently a cached segment.
   bool cached(const uuid& x) const noexcept {
-    return cache_.count(x) != 0;
+    return cache_.contains(x);
   }
 
   // -- cache management -------------------------------------------------------
@@ -85,29 +105,115 @@ public:
     cache_.clear();
   }
 
+  // -- compaction -------------------------------------------------------------
+
+  /// Rewrites a segment whose fraction of erased events is at least
+  /// `threshold`, such that the segment no longer occupies space for them.
+  /// @param threshold The minimum fraction of erased events in a segment.
+  /// @returns whether more segments qualify for compaction.
+  caf::expected<bool> compact(double threshold);
+
   // -- implementation of store ------------------------------------------------
 
+  using store::extract;
+  using store::get;
+
   error put(table_slice_ptr xs) override;
 
-  std::unique_ptr<store::lookup> extract(const ids& xs) const override;
+  std::unique_ptr<store::lookup>
+  extract(const ids& xs, const expression& expr,
+          const std::vector<std::string>& keys) const override;
 
   caf::error erase(const ids& xs) override;
 
-  caf::expected<std::vector<table_slice_ptr>> get(const ids& xs) override;
+  caf::expected<std::vector<table_slice_ptr>>
+  get(const ids& xs, const expression& expr,
+      const std::vector<std::string>& keys) override;
 
   caf::error flush() override;
 
   void inspect_status(caf::settings& dict) override;
 
 private:
+  // -- member types -----------------------------------------------------------
+
+  /// A change to the mapping of IDs to segments.
+  struct journal_entry {
+    enum class action : uint8_t { inject, erase };
+
+    /// The kind of change.
+    action op;
+
+    /// The first ID of an injected range.
+    id first;
+
+    /// One past the last ID of an injected range.
+    id last;
+
+    /// The affected segment.
+    uuid segment;
+
+    template <class Inspector>
+    friend auto inspect(Inspector& f, journal_entry& x) {
+      return f(x.op, x.first, x.last, x.segment);
+    }
+  };
+
+  // -- meta data management ---------------------------------------------------
+
+  /// Associates the IDs *[first, last)* with a segment and records the change
+  /// for the journal.
+  /// @returns `true` on success.
+  bool inject(id first, id last, const uuid& segment);
+
+  /// Removes all IDs of a segment and records the change for the journal.
+  void erase_segment(const uuid& segment);
+
+  /// Applies a change from the journal, possibly for a second time.
+  void apply(const journal_entry& x);
+
+  /// Appends all unwritten changes to the journal, or folds them into a new
+  /// checkpoint once the journal would outgrow the mapping itself. Afterwards,
+  /// removes the deletion bitmaps of segments that no longer exist.
+  caf::error sync_meta();
+
+  /// Writes the unwritten changes to the journal or a new checkpoint.
+  caf::error write_meta();
+
+  /// Writes the mapping of IDs to segments to ::meta_path and truncates the
+  /// journal.
+  caf::error checkpoint();
+
   // -- utility functions ------------------------------------------------------
 
   caf::expected<segment_ptr> load_segment(uuid id) const;
 
+  /// Maps a segment that is neither active nor cached and hints the operating
+  /// system to read the table slices for `xs` ahead asynchronously.
+  /// @returns the mapped segment, or `nullptr` if there is nothing to
+  ///          prefetch.
+  segment_ptr prefetch_segment(const uuid& id, const ids& xs) const;
+
   /// Fills `candidates` with all segments that qualify for `selection`.
   caf::error select_segments(const ids& selection,
                              std::vector<uuid>& candidates) const;
 
+  /// Writes the deletion bitmap of a persisted segment to disk and then
+  /// marks the events as erased in the segment.
+  /// @param x The segment to erase from.
+  /// @param xs The IDs of the events to erase.
+  /// @returns The number of erased events, or an error if writing the
+  ///          deletion bitmap failed.
+  caf::expected<uint64_t> tombstone(segment& x, const ids& xs);
+
+  /// Replaces a segment or the segment-under-construction with a segment that
+  /// holds only the events not in `xs`.
+  /// @param x The segment to rewrite.
+  /// @param xs The IDs of the events to erase.
+  /// @returns The number of erased events.
+  template <class Segment>
+  uint64_t rewrite(Segment& x, const ids& xs);
+
   /// Drops an entire segment and erases its content from disk.
   /// @param x The segment to drop.
   /// @returns The number of events in `x`.
@@ -130,8 +236,29 @@ private:
   /// Maps event IDs to candidate segments.
   detail::range_map<id, uuid> segments_;
 
+  /// Changes to ::segments_ that have not been written to the journal yet.
+  std::vector<journal_entry> unwritten_;
+
+  /// The number of entries in the journal.
+  size_t journal_size_ = 0;
+
+  /// Maps segments to the IDs of their erased events.
+  std::unordered_map<uuid, ids> tombstones_;
+
+  /// Segments whose deletion bitmaps we may remove from disk once the meta
+  /// data no longer refers to them.
+  std::vector<uuid> stale_tombstones_;
+
+  /// Counts the modifications of persisted segments, such that lookups can
+  /// tell whether a segment they mapped ahead of time is outdated.
+  uint64_t erasures_ = 0;
+
   /// Optimizes access times into segments by keeping some segments in memory.
-  mutable detail::cache<uuid, segment_ptr> cache_;
+  /// The cache weighs segments by their size in bytes and admits a segment
+  /// only if it was requested at least as often as the segments it displaces,
+  /// so that one-off scans over old data do not flush frequently used
+  /// segments.
+  mutable detail::cache<uuid, segment_ptr, detail::tiny_lfu> cache_;
 
   /// Serializes table slices into contiguous chunks of memory.
   segment_builder builder_;
@@ -19,6 +19,11 @@
 
 #include "vast/fwd.hpp"
 
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
 namespace vast {
 
 /// A key-value store for events.
@@ -26,6 +31,12 @@ class store {
 public:
   /// A session type for managing the state of a lookup.
   struct lookup {
+    /// Reads the table slices of a part of a lookup session. It touches only
+    /// data that the store no longer modifies, and may thus run on any
+    /// thread.
+    using reader
+      = std::function<caf::expected<std::vector<table_slice_ptr>>()>;
+
     virtual ~lookup();
 
     /// Obtains the next slice containing events pertaining
@@ -33,6 +44,12 @@ public:
     /// @returns caf::no_error when finished.
     /// @returns A new table slice upon every invocation.
     virtual caf::expected<table_slice_ptr> next() = 0;
+
+    /// Obtains the next part of this lookup session without reading its
+    /// table slices, such that the caller can read them elsewhere.
+    /// @returns caf::no_error when finished.
+    /// @returns A reader for the next table slices upon every invocation.
+    virtual caf::expected<reader> next_reader() = 0;
   };
 
   virtual ~store();
@@ -46,7 +63,21 @@ public:
   /// @param xs The IDs for the events to retrieve.
   /// @returns A pointer to lookup session.
   /// @relates lookup
-  virtual std::unique_ptr<lookup> extract(const ids& xs) const = 0;
+  std::unique_ptr<lookup> extract(const ids& xs) const;
+
+  /// Starts an iterative extraction session that may skip data the caller
+  /// does not need.
+  /// @param xs The IDs for the events to retrieve.
+  /// @param expr The query that the caller checks events against. The
+  ///             session may omit table slices without any matching event.
+  /// @param keys The keys of the fields that the caller needs, or nothing for
+  ///             all fields. The session may omit the columns of other fields
+  ///             and table slices without any of these fields.
+  /// @returns A pointer to lookup session.
+  /// @relates lookup
+  virtual std::unique_ptr<lookup>
+  extract(const ids& xs, const expression& expr,
+          const std::vector<std::string>& keys) const = 0;
 
   /// Erases events from the store.
   /// @param xs The set of IDs to erase.
@@ -56,7 +87,19 @@ public:
   /// Retrieves a set of events.
   /// @param xs The IDs for the events to retrieve.
   /// @returns The table slice according to *xs*.
-  virtual caf::expected<std::vector<table_slice_ptr>> get(const ids& xs) = 0;
+  caf::expected<std::vector<table_slice_ptr>> get(const ids& xs);
+
+  /// Retrieves a set of events, possibly skipping data the caller does not
+  /// need.
+  /// @param xs The IDs for the events to retrieve.
+  /// @param expr The query that the caller checks events against.
+  /// @param keys The keys of the fields that the caller needs, or nothing for
+  ///             all fields.
+  /// @returns The table slice according to *xs*.
+  /// @see extract
+  virtual caf::expected<std::vector<table_slice_ptr>>
+  get(const ids& xs, const expression& expr,
+      const std::vector<std::string>& keys) = 0;
 
   /// Flushes in-memory state to persistent storage.
   /// @returns No error on success.
@@ -0,0 +1,26 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+#pragma once
+
+#include "vast/command.hpp"
+
+#include <caf/fwd.hpp>
+
+namespace vast::system {
+
+/// Starts an AGGREGATOR actor and prints its result for a given query.
+caf::message
+aggregate_command(const command::invocation& invocation, caf::actor_system& sys);
+
+} // namespace vast::system
@@ -0,0 +1,83 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+#pragma once
+
+#include "vast/aggregation.hpp"
+#include "vast/expression.hpp"
+#include "vast/fwd.hpp"
+#include "vast/system/archive.hpp"
+#include "vast/system/query_processor.hpp"
+
+#include <caf/fwd.hpp>
+
+namespace vast::system {
+
+class aggregator_state : public system::query_processor {
+public:
+  // -- member types -----------------------------------------------------------
+
+  using super = system::query_processor;
+
+  // -- constants --------------------------------------------------------------
+
+  static inline constexpr const char* name = "aggregator";
+
+  // -- constructors, destructors, and assignment operators --------------------
+
+  aggregator_state(caf::event_based_actor* self);
+
+  void init(expression expr, aggregation spec, caf::actor index,
+            system::archive_type archive);
+
+protected:
+  // -- implementation hooks ---------------------------------------------------
+
+  void process_hits(const ids& hits) override;
+
+  void process_end_of_hits() override;
+
+private:
+  // -- member variables -------------------------------------------------------
+
+  /// Stores the user-defined query.
+  expression expr_;
+
+  /// Merges the partial aggregations of the ARCHIVE.
+  aggregation result_;
+
+  /// Points to the ARCHIVE for computing partial aggregations.
+  system::archive_type archive_;
+
+  /// Points to the client actor that launched the query.
+  caf::actor client_;
+
+  /// Stores how many pending requests remain for the ARCHIVE.
+  size_t pending_archive_requests_ = 0;
+};
+
+/// Computes an aggregation over the results of a query. The ARCHIVE
+/// aggregates the hits of each INDEX lookup, and the AGGREGATOR merges the
+/// partial results. Once done, the AGGREGATOR sends the final aggregation to
+/// its client and terminates. If the ARCHIVE fails to aggregate hits, the
+/// AGGREGATOR terminates with the error instead.
+/// @param self The actor handle.
+/// @param expr The query.
+/// @param spec An empty aggregation that defines the groups and aggregates.
+/// @param index The INDEX for looking up the hits of *expr*.
+/// @param archive The ARCHIVE for computing the partial aggregations.
+caf::behavior
+aggregator(caf::stateful_actor<aggregator_state>* self, expression expr,
+           aggregation spec, caf::actor index, system::archive_type archive);
+
+} // namespace vast::system
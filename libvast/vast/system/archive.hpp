@@ -14,7 +14,10 @@
 #pragma once
 
 #include <chrono>
+#include <deque>
 #include <memory>
+#include <string>
+#include <unordered_map>
 #include <unordered_set>
 #include <utility>
 #include <vector>
@@ -24,11 +27,17 @@
 #include <caf/stateful_actor.hpp>
 #include <caf/typed_actor.hpp>
 #include <caf/typed_event_based_actor.hpp>
+#include <caf/typed_response_promise.hpp>
 
+#include "vast/aggregation.hpp"
+#include "vast/compression.hpp"
+#include "vast/expression.hpp"
 #include "vast/fwd.hpp"
 #include "vast/ids.hpp"
 #include "vast/store.hpp"
+#include "vast/type.hpp"
 #include "vast/system/accountant.hpp"
+#include "vast/system/archive_worker.hpp"
 #include "vast/system/atoms.hpp"
 #include "vast/system/instrumentation.hpp"
 
@@ -39,19 +48,127 @@ namespace vast::system {
 using archive_type = caf::typed_actor<
   caf::reacts_to<caf::stream<table_slice_ptr>>,
   caf::reacts_to<exporter_atom, caf::actor>,
+  caf::reacts_to<credit_atom, uint64_t>,
   caf::replies_to<ids>::with<done_atom, caf::error>,
+  caf::replies_to<ids, std::vector<std::string>>::with<done_atom, caf::error>,
+  caf::replies_to<ids, expression, aggregation>::with<done_atom, caf::error>,
   caf::replies_to<status_atom>::with<caf::dictionary<caf::config_value>>,
   caf::reacts_to<telemetry_atom>,
-  caf::reacts_to<erase_atom, ids>
+  caf::reacts_to<erase_atom, ids>,
+  caf::reacts_to<compact_atom>,
+  caf::reacts_to<extract_atom>
 >;
 // clang-format on
 
 /// @relates archive
 struct archive_state {
+  /// The receiver of the table slices of a lookup.
+  using receiver_type = table_slice_receiver_type;
+
+  /// A lookup in progress.
+  struct session {
+    /// Identifies the session in responses of workers.
+    uint64_t id = 0;
+
+    /// The receiver of the table slices.
+    receiver_type requester;
+
+    /// The promise for signaling completion to the requester.
+    caf::typed_response_promise<done_atom, caf::error> promise;
+
+    /// The IDs to extract.
+    ids xs;
+
+    /// The keys of the fields to keep, or nothing to keep all fields.
+    std::vector<std::string> fields;
+
+    /// The extraction session of the store.
+    std::unique_ptr<store::lookup> lookup;
+
+    /// The partial aggregation of the lookup, if any. Aggregating lookups
+    /// fold the matching rows into the aggregation and ship only the result
+    /// instead of the table slices.
+    caf::optional<aggregation> partial;
+
+    /// The query that rows must satisfy for an aggregating lookup.
+    expression expr;
+
+    /// The number of table slices that workers currently process.
+    size_t in_flight = 0;
+
+    /// Indicates whether the store has no more table slices for the lookup,
+    /// or whether the lookup failed.
+    bool exhausted = false;
+
+    /// The error that terminated the lookup, if any.
+    caf::error error;
+  };
+
   void send_report();
+
+  /// Locates the next table slices of the first session that has capacity
+  /// for more slices in flight, hands reading them to a worker, and moves
+  /// the session to the back of the queue.
+  void advance();
+
+  /// Hands reading and processing table slices of a session to the next
+  /// worker.
+  void dispatch(session& x, store::lookup::reader read);
+
+  /// Accounts for a worker having processed a table slice of a session, and
+  /// completes the session if it has no more slices in flight.
+  /// @param id The ID of the session.
+  void finish_slice(uint64_t id);
+
+  /// Deducts shipped rows from the credit of a requester.
+  void consume_credit(const caf::actor_addr& requester, uint64_t rows);
+
+  /// @returns whether the requester of a session may receive more rows.
+  bool has_credit(const session& x) const;
+
+  /// Delivers the result of a session without slices in flight once the
+  /// store has no more slices for it.
+  /// @returns `true` if the session completed.
+  bool try_complete(session& x);
+
+  /// @returns the session with the given ID or `nullptr` if none exists.
+  session* find_session(uint64_t id);
+
   archive_type::stateful_pointer<archive_state> self;
   std::unique_ptr<vast::store> store;
   std::unordered_set<caf::actor_addr> active_exporters;
+
+  /// The number of rows that requesters are willing to receive. Requesters
+  /// opt into credit-based flow control by granting credit, and the ARCHIVE
+  /// extracts slices for them only while they have credit left. The credit
+  /// becomes negative when workers ship more rows than granted.
+  std::unordered_map<caf::actor_addr, int64_t> credit;
+
+  /// Stores all lookups in progress. The ARCHIVE locates one table slice per
+  /// message to interleave lookups with each other and with incoming data.
+  std::deque<session> sessions;
+
+  /// The ID of the next session.
+  uint64_t next_session_id = 0;
+
+  /// Processes extracted table slices in parallel.
+  std::vector<archive_worker_type> workers;
+
+  /// The index of the next worker in round-robin order.
+  size_t next_worker = 0;
+
+  /// Indicates whether an `extract_atom` message for advancing the sessions
+  /// is underway.
+  bool advancing = false;
+
+  /// The minimum fraction of erased events for compacting a segment, or 0 if
+  /// compaction is disabled.
+  double compaction_threshold = 0;
+
+  /// Indicates whether a `compact_atom` message for compacting segments is
+  /// underway.
+  bool compacting = false;
+
   vast::system::measurement measurement;
   accountant_type accountant;
   static inline const char* name = "archive";
@@ -62,9 +179,10 @@ struct archive_state {
 /// @param dir The root directory of the archive.
 /// @param capacity The number of segments to cache in memory.
 /// @param max_segment_size The maximum segment size in bytes.
+/// @param method The compression method for table slices in segments.
 /// @pre `max_segment_size > 0`
 archive_type::behavior_type
 archive(archive_type::stateful_pointer<archive_state> self, path dir,
-        size_t capacity, size_t max_segment_size);
+        size_t capacity, size_t max_segment_size, compression method);
 
 } // namespace vast::system
@@ -0,0 +1,82 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+#pragma once
+
+#include "vast/aggregation.hpp"
+#include "vast/compiled_expression.hpp"
+#include "vast/expression.hpp"
+#include "vast/fwd.hpp"
+#include "vast/ids.hpp"
+#include "vast/store.hpp"
+#include "vast/system/atoms.hpp"
+#include "vast/type.hpp"
+
+#include <caf/allowed_unsafe_message_type.hpp>
+#include <caf/replies_to.hpp>
+#include <caf/stateful_actor.hpp>
+#include <caf/typed_actor.hpp>
+#include <caf/typed_event_based_actor.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Readers travel only between the ARCHIVE and its workers.
+CAF_ALLOW_UNSAFE_MESSAGE_TYPE(vast::store::lookup::reader)
+
+namespace vast::system {
+
+/// The receiver of the table slices of an ARCHIVE lookup.
+using table_slice_receiver_type
+  = caf::typed_actor<caf::reacts_to<table_slice_ptr>>;
+
+// clang-format off
+/// @relates archive_worker
+using archive_worker_type = caf::typed_actor<
+  caf::replies_to<store::lookup::reader, ids, table_slice_receiver_type>
+    ::with<uint64_t>,
+  caf::replies_to<store::lookup::reader, ids, std::vector<std::string>,
+                  table_slice_receiver_type>
+    ::with<uint64_t>,
+  caf::replies_to<store::lookup::reader, ids, expression, aggregation>
+    ::with<aggregation>
+>;
+// clang-format on
+
+/// @relates archive_worker
+struct archive_worker_state {
+  /// The expression and layout of the most recently compiled checker, which
+  /// consecutive table slices of a lookup tend to share.
+  expression expr;
+  type layout;
+
+  /// The residual of *expr* for *layout*.
+  compiled_expression checker;
+
+  static inline const char* name = "archive-worker";
+};
+
+/// Reads and processes the table slices that the ARCHIVE locates for a
+/// lookup. The worker decompresses and deserializes the slices, and then
+/// either selects their rows, optionally projects them onto a set of fields,
+/// ships the result to the receiver, and responds with the number of shipped
+/// rows, or folds the rows that satisfy the residual of an expression into
+/// an empty aggregation that it returns. Doing so outside of the ARCHIVE
+/// lets lookups scale with the number of cores and keeps the ARCHIVE
+/// responsive to incoming data.
+/// @param self The actor handle.
+archive_worker_type::behavior_type archive_worker(
+  archive_worker_type::stateful_pointer<archive_worker_state> self);
+
+} // namespace vast::system
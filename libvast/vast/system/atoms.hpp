@@ -34,11 +34,14 @@ using caf::subscribe_atom;
 using accept_atom = caf::atom_constant<caf::atom("accept")>;
 using announce_atom = caf::atom_constant<caf::atom("announce")>;
 using batch_atom = caf::atom_constant<caf::atom("batch")>;
+using compact_atom = caf::atom_constant<caf::atom("compact")>;
 using continuous_atom = caf::atom_constant<caf::atom("continuous")>;
 using cpu_atom = caf::atom_constant<caf::atom("cpu")>;
+using credit_atom = caf::atom_constant<caf::atom("credit")>;
 using data_atom = caf::atom_constant<caf::atom("data")>;
 using disable_atom = caf::atom_constant<caf::atom("disable")>;
 using disconnect_atom = caf::atom_constant<caf::atom("disconnect")>;
+using distinct_atom = caf::atom_constant<caf::atom("distinct")>;
 using done_atom = caf::atom_constant<caf::atom("done")>;
 using election_atom = caf::atom_constant<caf::atom("election")>;
 using empty_atom = caf::atom_constant<caf::atom("empty")>;
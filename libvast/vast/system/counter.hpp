@@ -13,6 +13,7 @@
 
 #pragma once
 
+#include "vast/compiled_expression.hpp"
 #include "vast/expression.hpp"
 #include "vast/fwd.hpp"
 #include "vast/ids.hpp"
@@ -21,6 +22,7 @@
 
 #include <caf/fwd.hpp>
 
+#include <string>
 #include <unordered_map>
 
 namespace vast::system {
@@ -40,7 +42,7 @@ public:
   counter_state(caf::event_based_actor* self);
 
   void init(expression expr, caf::actor index, system::archive_type archive,
-            bool skip_candidate_check);
+            bool skip_candidate_check, std::string distinct_key);
 
 protected:
   // -- implementation hooks ---------------------------------------------------
@@ -70,12 +72,22 @@ private:
   /// Caches INDEX hits for evaluating candidates from the ARCHIVE.
   ids hits_;
 
-  /// Caches expr_ tailored to different layouts.
-  std::unordered_map<type, expression> checkers_;
+  /// Caches the residuals of expr_ compiled for different layouts.
+  std::unordered_map<type, compiled_expression> checkers_;
 };
 
+/// Counts the hits of a query.
+/// @param self The actor handle.
+/// @param expr The query.
+/// @param index The INDEX for looking up the hits of *expr*.
+/// @param archive The ARCHIVE for performing candidate checks.
+/// @param skip_candidate_check Whether to report index hits without checking
+///        them, which yields an upper bound.
+/// @param distinct_key The key of a field whose distinct values the COUNTER
+///        counts, or the empty string to count all hits. The INDEX answers
+///        distinct counts from its value indexes without candidate checks.
 caf::behavior counter(caf::stateful_actor<counter_state>* self, expression expr,
                       caf::actor index, system::archive_type archive,
-                      bool skip_candidate_check);
+                      bool skip_candidate_check, std::string distinct_key);
 
 } // namespace vast::system
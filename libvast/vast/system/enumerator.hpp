@@ -0,0 +1,81 @@
+/******************************************************************************
+ *                    _   _____   __________                                  *
+ *                   | | / / _ | / __/_  __/     Visibility                   *
+ *                   | |/ / __ |_\ \  / /          Across                     *
+ *                   |___/_/ |_/___/ /_/       Space and Time                 *
+ *                                                                            *
+ * This file is part of VAST. It is subject to the license terms in the       *
+ * LICENSE file found in the top-level directory of this distribution and at  *
+ * http://vast.io/license. No part of VAST, including this file, may be       *
+ * copied, modified, propagated, or distributed except according to the terms *
+ * contained in the LICENSE file.                                             *
+ ******************************************************************************/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <caf/actor.hpp>
+#include <caf/fwd.hpp>
+#include <caf/typed_response_promise.hpp>
+
+#include "vast/aliases.hpp"
+#include "vast/expression.hpp"
+#include "vast/ids.hpp"
+#include "vast/uuid.hpp"
+
+namespace vast::system {
+
+/// @relates enumerator
+struct enumerator_state {
+  /// Spawns the EVALUATOR actors and provides the INDEXER actors for a batch
+  /// of partitions.
+  caf::actor index;
+
+  /// The query that selects the events.
+  expression expr;
+
+  /// The key of the field whose distinct values we count.
+  std::string key;
+
+  /// The candidate partitions that we did not evaluate yet.
+  std::vector<uuid> partitions;
+
+  /// The maximum number of partitions per batch.
+  size_t batch_size;
+
+  /// Accumulates the hits of the EVALUATOR actors for the current batch.
+  ids hits;
+
+  /// Accumulates the counts of all INDEXER actors.
+  value_counts result;
+
+  /// Stores the number of requests that did not receive a response yet.
+  size_t pending = 0;
+
+  /// Allows us to respond to the client after counting all values.
+  caf::typed_response_promise<value_counts> promise;
+
+  /// Gives this actor a recognizable name in logging output.
+  static inline const char* name = "enumerator";
+};
+
+/// Counts the distinct values of a field among the hits of a query, without
+/// touching the ARCHIVE. For each batch of candidate partitions, the
+/// ENUMERATOR first collects the hits of the query and then asks the INDEXER
+/// actors of the field to intersect the hits with the positions of each
+/// value. Only then does it request the next batch from the INDEX.
+/// @param self The actor handle.
+/// @param index The INDEX that owns the partitions.
+/// @param expr The query.
+/// @param key The key of the field.
+/// @param partitions The candidate partitions for *expr*.
+/// @param batch_size The maximum number of partitions per batch.
+/// @returns the behavior of the ENUMERATOR, which responds to a `run_atom`
+///          with the counts or the first error and terminates afterwards.
+caf::behavior enumerator(caf::stateful_actor<enumerator_state>* self,
+                         caf::actor index, expression expr, std::string key,
+                         std::vector<uuid> partitions, size_t batch_size);
+
+} // namespace vast::system
@@ -16,12 +16,19 @@
 #include <chrono>
 #include <deque>
 #include <memory>
+#include <string>
 #include <unordered_map>
+#include <vector>
+
+#include <caf/optional.hpp>
 
 #include "vast/aliases.hpp"
+#include "vast/compiled_expression.hpp"
 #include "vast/expression.hpp"
 #include "vast/ids.hpp"
 #include "vast/query_options.hpp"
+#include "vast/table_slice.hpp"
+#include "vast/time.hpp"
 #include "vast/uuid.hpp"
 
 #include "vast/system/accountant.hpp"
@@ -30,6 +37,27 @@
 
 namespace vast::system {
 
+/// A row of a sorted export.
+struct top_k_entry {
+  /// The value of the sort key.
+  time key;
+
+  /// The ID of the row.
+  id row;
+
+  /// The table slice that contains the row.
+  table_slice_ptr slice;
+};
+
+/// Orders entries of a sorted export such that the heap functions of the
+/// standard library maintain a min-heap, i.e., the front entry has the
+/// earliest point in time.
+struct top_k_order {
+  bool operator()(const top_k_entry& x, const top_k_entry& y) const {
+    return x.key > y.key;
+  }
+};
+
 struct exporter_state {
   /// -- constants -------------------------------------------------------------
 
@@ -60,12 +88,25 @@ struct exporter_state {
   /// Stores hits from the INDEX.
   ids hits;
 
-  /// Caches tailored candidate checkers.
-  std::unordered_map<type, expression> checkers;
+  /// Stores hits from the INDEX that wait for a free ARCHIVE lookup slot.
+  std::deque<ids> pending_lookups;
+
+  /// Caches compiled candidate checkers per layout.
+  std::unordered_map<type, compiled_expression> checkers;
+
+  /// Caches the residuals of the candidate checkers per layout, which suffice
+  /// for checking slices that the ARCHIVE delivers for index hits.
+  std::unordered_map<type, compiled_expression> residuals;
+
+  /// Caches the columns to ship per layout if the query has a projection.
+  std::unordered_map<type, std::vector<size_t>> projections;
 
   /// Caches results for the SINK.
   std::vector<table_slice_ptr> results;
 
+  /// The number of rows that the ARCHIVE may still ship to us.
+  int64_t archive_credit = 0;
+
   /// Stores the time point for when this actor got started via 'run'.
   std::chrono::steady_clock::time_point start;
 
@@ -81,6 +122,30 @@ struct exporter_state {
 
   /// Stores the user-defined export query.
   expression expr;
+
+  /// Stores the keys of the fields to ship, or nothing to ship all fields.
+  std::vector<std::string> fields;
+
+  /// Stores the keys of the fields to fetch from the ARCHIVE, i.e., *fields*
+  /// and the keys for the candidate check, or nothing to fetch all fields.
+  std::vector<std::string> archive_fields;
+
+  /// Stores the key of the time field to sort by, or nothing for unsorted
+  /// exports.
+  std::string sort_key;
+
+  /// Stores the number of results of a sorted export.
+  uint64_t limit = 0;
+
+  /// Stores the rows with the latest points in time as a min-heap ordered by
+  /// `top_k_order`.
+  std::vector<top_k_entry> top_k;
+
+  /// Caches the column of the sort key per layout, if any.
+  std::unordered_map<type, caf::optional<size_t>> sort_columns;
+
+  /// Indicates whether we wait for the INDEX to prune partitions.
+  bool pruning = false;
 };
 
 /// The EXPORTER receives index hits, looks up the corresponding events in the
@@ -89,7 +154,9 @@ struct exporter_state {
 /// @param self The actor handle.
 /// @param ast The AST of query.
 /// @param qos The query options.
+/// @param fields The keys of the fields to ship, or nothing to ship all fields.
 caf::behavior exporter(caf::stateful_actor<exporter_state>* self,
-                       expression expr, query_options opts);
+                       expression expr, query_options opts,
+                       std::vector<std::string> fields = {});
 
 } // namespace vast::system
@@ -152,6 +152,16 @@ struct index_state {
   ///          partition matches.
   partition* find_unpersisted(const uuid& id);
 
+  /// @returns the partition matching `id`, loading it into the LRU cache if
+  ///          it is neither active nor unpersisted.
+  partition* fetch_partition(const uuid& id);
+
+  /// Removes a partition from the meta index, the LRU cache, all pending
+  /// queries, and the file system.
+  /// @returns the IDs of all events in the dropped partition.
+  /// @pre *id* refers to neither the active nor an unpersisted partition.
+  ids drop_partition(const uuid& id);
+
   /// Prepares a subset of partitions from the lookup_state for evaluation.
   pending_query_map
   build_query_map(lookup_state& lookup, uint32_t num_partitions);
@@ -100,9 +100,16 @@ public:
   /// @returns all INDEXER actors of all matching layouts.
   evaluation_map eval(const expression& expr);
 
+  /// @returns the INDEXER actors of the fields that match *key* as suffix,
+  ///          at most one per layout.
+  std::vector<caf::actor> indexers(const std::string& key);
+
   /// @returns all layouts in this partition.
   std::vector<record_type> layouts() const;
 
+  /// @returns the IDs of all events in this partition.
+  ids row_ids();
+
   /// @returns the directory for persistent state.
   path base_dir() const;
 
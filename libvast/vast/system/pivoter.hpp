@@ -56,9 +56,9 @@ struct pivoter_state {
   ///       string.
   std::unordered_set<std::string> requested_ids;
 
-  /// A cache for the connections between a source type and the target type,
-  /// to avoid multiple computations of those.
-  mutable std::unordered_map<record_type, caf::optional<record_field>> cache;
+  /// A cache for the connections between an interned source type and the
+  /// target type, to avoid multiple computations of those.
+  mutable std::unordered_map<type, caf::optional<record_field>> cache;
 
   /// A tracking counter of spawned exporters. Used for lifetime management.
   size_t running_exporters = 0;
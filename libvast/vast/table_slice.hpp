@@ -15,6 +15,8 @@
 
 #include <cstddef>
 #include <limits>
+#include <mutex>
+#include <string>
 #include <string_view>
 #include <vector>
 
@@ -25,6 +27,8 @@
 #include <caf/ref_counted.hpp>
 
 #include "vast/fwd.hpp"
+#include "vast/ids.hpp"
+#include "vast/operator.hpp"
 #include "vast/table_slice_header.hpp"
 #include "vast/type.hpp"
 #include "vast/view.hpp"
@@ -101,7 +105,7 @@ public:
 
   ~table_slice() override;
 
-  table_slice(const table_slice&) = default;
+  table_slice(const table_slice& other);
 
   /// Default-constructs an empty table slice.
   table_slice() = default;
@@ -130,11 +134,27 @@ public:
   /// @pre `chunk != nullptr`
   virtual caf::error load(chunk_ptr chunk);
 
+  /// Decodes the data that `load` deferred until the first access, if any.
+  /// Accessing data that fails to decode yields nil values, so callers that
+  /// must detect corrupt data decode explicitly first.
+  /// @returns An error if the data fails to decode and `none` otherwise.
+  virtual caf::error decode() const;
+
   // -- visitation -------------------------------------------------------------
 
   /// Appends all values in column `col` to `idx`.
   virtual void append_column_to_index(size_type col, value_index& idx) const;
 
+  /// Evaluates a predicate for all values in column `col`.
+  /// @param col The column offset.
+  /// @param op The relational operator.
+  /// @param rhs The RHS of the predicate.
+  /// @returns a bitmap of size `offset() + rows()` containing the IDs of all
+  ///          rows where `evaluate_view(x, op, rhs)` holds for the canonical
+  ///          value *x* in column `col`.
+  virtual ids evaluate_column(size_type col, relational_operator op,
+                              const data_view& rhs) const;
+
   // -- properties -------------------------------------------------------------
 
   /// @returns the table slice header.
@@ -147,6 +167,18 @@ public:
     return header_.layout;
   }
 
+  /// @returns the interned table layout, which hashes and compares in
+  ///          constant time and thus suits as key for per-layout lookups.
+  ///          Slices from builders, segments, and the deserializer receive
+  ///          it on creation; all others intern their layout on first access.
+  /// @see intern
+  const type& interned_layout() const;
+
+  /// Sets the interned table layout.
+  /// @param x The canonical instance of the layout.
+  /// @pre `x == intern(layout())` and no other thread accesses the slice.
+  void interned_layout(type x) noexcept;
+
   /// @returns an identifier for the implementing class.
   virtual caf::atom_value implementation_id() const noexcept = 0;
 
@@ -203,6 +235,10 @@ protected:
   // -- member variables -------------------------------------------------------
 
   table_slice_header header_;
+
+private:
+  mutable std::once_flag interned_layout_flag_;
+  mutable type interned_layout_;
 };
 
 // -- free functions -----------------------------------------------------------
@@ -239,6 +275,28 @@ void select(std::vector<table_slice_ptr>& result, const table_slice_ptr& xs,
 std::vector<table_slice_ptr> select(const table_slice_ptr& xs,
                                     const ids& selection);
 
+/// Resolves keys to the columns of a layout, interpreting each key as a
+/// suffix of the column names like a key extractor does.
+/// @param layout The layout of a table slice.
+/// @param keys The keys to resolve.
+/// @returns the offsets of all matching columns in the order of *keys*,
+///          without duplicates.
+std::vector<size_t> resolve_columns(const record_type& layout,
+                                    const std::vector<std::string>& keys);
+
+/// Projects a table slice onto a subset of its columns.
+/// @param slice The input table slice.
+/// @param columns The offsets of the columns to keep.
+/// @returns `slice` if *columns* selects all columns in order, `nullptr` if
+///          *columns* is empty, and a new table slice of the same
+///          implementation type as `slice` that keeps the name of the layout
+///          otherwise.
+/// @pre `slice != nullptr`
+/// @pre `std::all_of(columns.begin(), columns.end(),
+///                   [&](auto col) { return col < slice->columns(); })`
+table_slice_ptr project(const table_slice_ptr& slice,
+                        const std::vector<size_t>& columns);
+
 /// Selects the first `num_rows` rows of `slice`.
 /// @param slice The input table slice.
 /// @param num_rows The number of rows to keep.
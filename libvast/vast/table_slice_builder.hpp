@@ -92,8 +92,15 @@ protected:
   /// @returns `true` on success.
   virtual bool add_impl(data_view x) = 0;
 
+  /// @returns the interned table layout for handing to finished slices.
+  /// @see table_slice::interned_layout
+  const type& interned_layout() const noexcept {
+    return interned_layout_;
+  }
+
 private:
   record_type layout_;
+  type interned_layout_;
 };
 
 /// @relates table_slice_builder
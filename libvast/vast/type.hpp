@@ -158,6 +158,10 @@ public:
   /// @returns The attributes of the type.
   const std::vector<attribute>& attributes() const;
 
+  /// @returns the digest of the type, which interned types precompute.
+  /// @see intern
+  type_digest digest() const;
+
   /// @cond PRIVATE
 
   abstract_type_ptr ptr() const;
@@ -178,12 +182,30 @@ public:
   friend bool operator==(const type& x, const type& y);
   friend bool operator<(const type& x, const type& y);
 
+  friend type intern(type x);
+
 private:
   type(abstract_type_ptr x);
 
+  bool interned() const noexcept;
+
   abstract_type_ptr ptr_;
 };
 
+/// Retrieves the canonical instance of a type. All interned types that compare
+/// equal share a single instance with a precomputed digest, which turns
+/// hashing into reading an integer and equality comparison into comparing
+/// pointers. Canonical instances are immutable; modifying an interned type
+/// operates on a copy. Interned types live until the end of the process, so
+/// the memory footprint grows with the number of distinct types. Only intern
+/// types from a bounded set, such as the table layouts of a schema.
+/// @param x The type to intern.
+/// @returns the canonical instance of *x*.
+/// @note This function is thread-safe. Every thread caches the canonical
+///       instances it has retrieved, so repeated lookups do not synchronize.
+/// @relates type
+type intern(type x);
+
 /// Describes properties of a type.
 /// @relates type
 enum class type_flags : uint8_t {
@@ -242,13 +264,30 @@ public:
 
   /// @endcond
 
+  friend type intern(type x);
+
 protected:
+  abstract_type() = default;
+
+  // Copies never inherit the interning state, because they may change.
+  abstract_type(const abstract_type& other);
+
+  abstract_type(abstract_type&& other) noexcept;
+
+  abstract_type& operator=(const abstract_type& other);
+
+  abstract_type& operator=(abstract_type&& other) noexcept;
+
   virtual bool equals(const abstract_type& other) const;
 
   virtual bool less_than(const abstract_type& other) const;
 
   std::string name_;
   std::vector<attribute> attributes_;
+
+private:
+  type_digest digest_ = 0; // Only valid for interned types.
+  bool interned_ = false;
 };
 
 /// The base class for all concrete types.
@@ -982,7 +1021,13 @@ namespace std {
     }                                                                          \
   }
 
-VAST_DEFINE_HASH_SPECIALIZATION(type);
+template <>
+struct hash<vast::type> {
+  size_t operator()(const vast::type& x) const {
+    return x.digest();
+  }
+};
+
 VAST_DEFINE_HASH_SPECIALIZATION(none_type);
 VAST_DEFINE_HASH_SPECIALIZATION(bool_type);
 VAST_DEFINE_HASH_SPECIALIZATION(integer_type);
@@ -18,12 +18,18 @@
 #include "vast/concept/parseable/vast/base.hpp"
 #include "vast/concept/printable/vast/data.hpp"
 #include "vast/concept/printable/vast/operator.hpp"
+#include "vast/defaults.hpp"
 #include "vast/detail/assert.hpp"
+#include "vast/detail/bit.hpp"
+#include "vast/detail/flat_map.hpp"
+#include "vast/detail/order.hpp"
 #include "vast/detail/overload.hpp"
 #include "vast/die.hpp"
 #include "vast/error.hpp"
 #include "vast/ewah_bitmap.hpp"
+#include "vast/fwd.hpp"
 #include "vast/ids.hpp"
+#include "vast/logger.hpp"
 #include "vast/type.hpp"
 #include "vast/value_index_factory.hpp"
 #include "vast/view.hpp"
@@ -31,10 +37,12 @@
 #include <caf/deserializer.hpp>
 #include <caf/error.hpp>
 #include <caf/expected.hpp>
+#include <caf/optional.hpp>
 #include <caf/serializer.hpp>
 #include <caf/settings.hpp>
 
 #include <algorithm>
+#include <limits>
 #include <memory>
 #include <type_traits>
 
@@ -73,6 +81,21 @@ public:
   /// @returns The result of the lookup or an error upon failure.
   caf::expected<ids> lookup(relational_operator op, data_view x) const;
 
+  /// Counts the occurrences of each distinct value at a set of positions.
+  /// The positions of `nil` values count towards `nil`.
+  /// @param selection The positions to consider.
+  /// @returns the distinct values with their number of occurrences, or
+  ///          `ec::unimplemented` if the index cannot reconstruct its values.
+  caf::expected<value_counts> distinct(const ids& selection) const;
+
+  /// Checks whether a lookup has no false positives, i.e., whether all
+  /// positions in the result of `lookup(op, x)` hold values that satisfy the
+  /// predicate. Indexes that hash or bin their values are not exact.
+  /// @param op The relation operator.
+  /// @param x The value to lookup.
+  /// @returns `true` if the lookup needs no candidate check.
+  virtual bool exact(relational_operator op, data_view x) const;
+
   /// Merges another value index with this one.
   /// @param other The value index to merge.
   /// @returns `true` on success.
@@ -94,6 +117,14 @@ public:
 
   virtual caf::error deserialize(caf::deserializer& source);
 
+  /// Loads the index from a chunk. Implementations may reference the chunk
+  /// instead of copying its contents. The default implementation dispatches
+  /// to `deserialize` with a `caf::binary_deserializer`.
+  /// @param chunk The chunk holding the serialized index.
+  /// @returns An error if the operation fails and `none` otherwise.
+  /// @pre `chunk != nullptr`
+  virtual caf::error load(chunk_ptr chunk);
+
 protected:
   const ewah_bitmap& mask() const;
   const ewah_bitmap& none() const;
@@ -104,6 +135,9 @@ private:
   virtual caf::expected<ids>
   lookup_impl(relational_operator op, data_view x) const = 0;
 
+  /// Implements `distinct` for positions of non-`nil` values.
+  virtual caf::expected<value_counts> distinct_impl(const ids& selection) const;
+
   ewah_bitmap mask_;         ///< The position of all values excluding nil.
   ewah_bitmap none_;         ///< The positions of nil values.
   const vast::type type_;    ///< The type of this index.
@@ -171,6 +205,34 @@ container_lookup(const Index& idx, relational_operator op, view<set> xs) {
   return container_lookup_impl(idx, op, *xs);
 }
 
+/// Enumerates the distinct values of a range-coded bitmap index at a set of
+/// positions by bisecting the value domain. The bisection only descends into
+/// subranges that contain selected positions, so that the number of lookups
+/// grows with the number of distinct values rather than the domain size.
+/// @param bmi The bitmap index.
+/// @param selection The positions to consider.
+/// @param lo The smallest value of the domain.
+/// @param hi The largest value of the domain.
+/// @param f The function to invoke with each distinct value and the selected
+///          positions of the value.
+template <class BitmapIndex, class T, class F>
+void bisect(const BitmapIndex& bmi, const ids& selection, T lo, T hi, F& f) {
+  if (lo == hi) {
+    f(lo, selection);
+    return;
+  }
+  using unsigned_type = std::make_unsigned_t<T>;
+  auto delta = static_cast<unsigned_type>(hi) - static_cast<unsigned_type>(lo);
+  auto mid = static_cast<T>(lo + static_cast<T>(delta / 2));
+  ids left = bmi.lookup(less_equal, mid);
+  left &= selection;
+  auto right = selection - left;
+  if (any<1>(left))
+    bisect(bmi, left, lo, mid, f);
+  if (any<1>(right))
+    bisect(bmi, right, static_cast<T>(mid + 1), hi, f);
+}
+
 } // namespace detail
 
 /// An index for arithmetic values.
@@ -223,41 +285,260 @@ public:
 
   using bitmap_index_type = bitmap_index<value_type, coder_type, binner_type>;
 
+  /// Whether the index supports choosing binning and base from its data.
+  static constexpr bool supports_adaptive_binning
+    = std::is_same_v<coder_type, multi_level_range_coder>;
+
+  // clang-format off
+  using binned_type =
+    std::conditional_t<
+      std::is_floating_point_v<value_type>,
+      int64_t,
+      std::conditional_t<
+        std::is_same_v<value_type, bool>,
+        count,
+        value_type
+      >
+    >;
+  // clang-format on
+
+  /// The bitmap index in adaptive mode, which operates on values after
+  /// binning them with an ::adaptive_binner.
+  using binned_bitmap_index_type
+    = bitmap_index<binned_type, multi_level_range_coder>;
+
   /// Constructs an arithmetic index.
   /// @param t An arithmetic type.
-  /// @param opts Runtime context for index parameterization.
+  /// @param opts Runtime context for index parameterization. The option
+  ///             `binning` set to `adaptive` makes the index sample its first
+  ///             `binning-sample` values to choose a binner and a base. An
+  ///             explicit `base` takes precedence over the chosen base.
   explicit arithmetic_index(vast::type t, caf::settings opts = {})
     : value_index{std::move(t), std::move(opts)} {
     if constexpr (std::is_same_v<coder_type, multi_level_range_coder>) {
-      auto i = options().find("base");
-      if (i == options().end()) {
+      if (auto b = explicit_base())
+        bmi_ = bitmap_index_type{std::move(*b)};
+      else
         // Some early experiments found that 8 yields the best average
         // performance, presumably because it's a power of 2.
         bmi_ = bitmap_index_type{base::uniform<64>(8)};
-      } else {
-        auto str = caf::get<caf::config_value::string>(i->second);
-        auto b = to<base>(str);
-        VAST_ASSERT(b); // pre-condition is that this was validated
-        bmi_ = bitmap_index_type{base{std::move(*b)}};
+      auto binning = caf::get_if<caf::config_value::string>(&options(),
+                                                            "binning");
+      if (binning && *binning == "adaptive") {
+        sample_size_ = defaults::index::binning_sample_size;
+        if (auto n = caf::get_if<caf::config_value::integer>(&options(),
+                                                             "binning-sample"))
+          sample_size_ = static_cast<size_t>(*n);
       }
     }
   }
 
   caf::error serialize(caf::serializer& sink) const override {
+    if (!adaptive())
+      return caf::error::eval([&] { return value_index::serialize(sink); },
+                              [&] { return sink(bmi_); });
+    // An incomplete sample stays a sample, so that loading the index does not
+    // change the binning that later values receive.
     return caf::error::eval([&] { return value_index::serialize(sink); },
-                            [&] { return sink(bmi_); });
+                            [&] { return sink(fitted_); },
+                            [&] {
+                              return fitted_ ? sink(binner_, binned_bmi_)
+                                             : sink(sample_);
+                            });
   }
 
   caf::error deserialize(caf::deserializer& source) override {
+    if (!adaptive())
+      return caf::error::eval([&] { return value_index::deserialize(source); },
+                              [&] { return source(bmi_); });
     return caf::error::eval([&] { return value_index::deserialize(source); },
-                            [&] { return source(bmi_); });
+                            [&] { return source(fitted_); },
+                            [&] {
+                              return fitted_ ? source(binner_, binned_bmi_)
+                                             : source(sample_);
+                            });
+  }
+
+  bool exact(relational_operator op, data_view x) const override {
+    // An adaptive index only knows its binner once the sample is complete.
+    if constexpr (std::is_same_v<binner_type, identity_binner>) {
+      if (adaptive())
+        return false;
+      auto equality = op == equal || op == not_equal;
+      if constexpr (std::is_same_v<T, bool>)
+        return equality && caf::holds_alternative<view<bool>>(x);
+      else if constexpr (detail::is_any_v<T, integer, count>)
+        return (equality || op == less || op == less_equal || op == greater
+                || op == greater_equal)
+               && caf::holds_alternative<view<T>>(x);
+    }
+    return false;
+  }
+
+  /// @returns the binner that the index chose in adaptive mode, which is the
+  ///          identity until the sample is complete.
+  const adaptive_binner& binner() const {
+    return binner_;
   }
 
 private:
+  bool adaptive() const {
+    return sample_size_ > 0;
+  }
+
+  /// @returns the user-provided base, if any.
+  caf::optional<base> explicit_base() const {
+    auto i = options().find("base");
+    if (i == options().end())
+      return caf::none;
+    auto str = caf::get<caf::config_value::string>(i->second);
+    auto b = to<base>(str);
+    VAST_ASSERT(b); // pre-condition is that this was validated
+    return std::move(*b);
+  }
+
+  /// Chooses a base for binned values that vary in their *bits* low-order
+  /// bits: up to four components with a power-of-2 base of at most 16 cover
+  /// the varying bits, and components with base 16 cover the remaining
+  /// bits. The latter are (mostly) constant and compress well.
+  static base adaptive_base(size_t bits) {
+    constexpr size_t domain_bits = sizeof(binned_type) * 8;
+    auto k = std::clamp((bits + 3) / 4, size_t{1}, size_t{4});
+    base::vector_type xs;
+    auto covered = size_t{0};
+    for (; covered < bits; covered += k)
+      xs.push_back(size_t{1} << k);
+    for (; covered < domain_bits; covered += 4)
+      xs.push_back(16);
+    return base{std::move(xs)};
+  }
+
+  /// @returns whether the index maps distinct values into the same bucket.
+  bool lossy() const {
+    if constexpr (supports_adaptive_binning)
+      return adaptive() && fitted_ && binner_.lossy<value_type>();
+    return false;
+  }
+
+  /// Chooses binner and base from the complete sample and moves the sampled
+  /// values into the bitmap index.
+  void fit() {
+    if constexpr (supports_adaptive_binning) {
+      if (!adaptive() || fitted_)
+        return;
+      fitted_ = true;
+      std::vector<value_type> xs;
+      xs.reserve(sample_.size());
+      for (auto& x : sample_)
+        xs.push_back(x.first);
+      binner_ = adaptive_binner::fit(xs);
+      auto b = explicit_base();
+      if (!b) {
+        auto bits = size_t{0};
+        if (!xs.empty()) {
+          auto [lo, hi] = std::minmax_element(xs.begin(), xs.end());
+          auto span = detail::order(binner_.bin(*hi))
+                      - detail::order(binner_.bin(*lo));
+          bits = detail::log2p1(span);
+        }
+        b = adaptive_base(bits);
+      }
+      VAST_DEBUG_ANON(__func__, "chose binning exponent", binner_.exponent(),
+                      "and", b->size(), "base components from", xs.size(),
+                      "values");
+      binned_bmi_ = binned_bitmap_index_type{std::move(*b)};
+      for (auto& [x, pos] : sample_) {
+        binned_bmi_.skip(pos - binned_bmi_.size());
+        binned_bmi_.append(binner_.bin(x));
+      }
+      sample_ = {};
+    }
+  }
+
+  template <class U>
+  void append_value(U x, id pos) {
+    if constexpr (supports_adaptive_binning) {
+      if (adaptive()) {
+        if (!fitted_) {
+          sample_.emplace_back(x, pos);
+          if (sample_.size() == sample_size_)
+            fit();
+          return;
+        }
+        binned_bmi_.skip(pos - binned_bmi_.size());
+        binned_bmi_.append(binner_.bin(static_cast<value_type>(x)));
+        return;
+      }
+    }
+    bmi_.skip(pos - bmi_.size());
+    bmi_.append(x);
+  }
+
+  /// Evaluates a predicate on the values of an incomplete sample.
+  ids lookup_sample(relational_operator op, value_type x) const {
+    auto satisfies = [&](value_type y) {
+      switch (op) {
+        default:
+          return false;
+        case equal:
+          return y == x;
+        case not_equal:
+          return y != x;
+        case less:
+          return y < x;
+        case less_equal:
+          return y <= x;
+        case greater:
+          return y > x;
+        case greater_equal:
+          return y >= x;
+      }
+    };
+    ids result;
+    for (auto& [y, pos] : sample_) {
+      result.append_bits(false, pos - result.size());
+      result.append_bit(satisfies(y));
+    }
+    return result;
+  }
+
+  template <class U>
+  ids lookup_value(relational_operator op, U x) const {
+    if constexpr (supports_adaptive_binning) {
+      if (adaptive()) {
+        // Until the sample is complete, we answer lookups exactly.
+        if (!fitted_)
+          return lookup_sample(op, static_cast<value_type>(x));
+        // When multiple values share a bucket, a strict inequality must
+        // include the bucket of the value itself, and an inequality cannot
+        // rule out any row. False positives are filtered out in the
+        // candidate check at a later stage.
+        if (lossy()) {
+          if (op == greater)
+            op = greater_equal;
+          else if (op == less)
+            op = less_equal;
+          else if (op == not_equal)
+            return ids{binned_bmi_.size(), true};
+        }
+        return binned_bmi_.lookup(op, binner_.bin(static_cast<value_type>(x)));
+      }
+    }
+    return bmi_.lookup(op, x);
+  }
+
+  template <class Container>
+  caf::expected<ids>
+  lookup_container(relational_operator op, Container xs) const {
+    // Removing the buckets of the values would also remove other values.
+    if (op == not_in && lossy())
+      return ids{offset(), true};
+    return detail::container_lookup(*this, op, xs);
+  }
+
   bool append_impl(data_view d, id pos) override {
     auto append = [&](auto x) {
-      bmi_.skip(pos - bmi_.size());
-      bmi_.append(x);
+      append_value(x, pos);
       return true;
     };
     auto f = detail::overload([&](auto&&) { return false; },
@@ -280,22 +561,66 @@ private:
       [&](auto x) -> caf::expected<ids> {
         return make_error(ec::type_clash, value_type{}, materialize(x));
       },
-      [&](view<bool> x) -> caf::expected<ids> { return bmi_.lookup(op, x); },
-      [&](view<integer> x) -> caf::expected<ids> { return bmi_.lookup(op, x); },
-      [&](view<count> x) -> caf::expected<ids> { return bmi_.lookup(op, x); },
-      [&](view<real> x) -> caf::expected<ids> { return bmi_.lookup(op, x); },
+      [&](view<bool> x) -> caf::expected<ids> {
+        return lookup_value(op, x);
+      },
+      [&](view<integer> x) -> caf::expected<ids> {
+        return lookup_value(op, x);
+      },
+      [&](view<count> x) -> caf::expected<ids> {
+        return lookup_value(op, x);
+      },
+      [&](view<real> x) -> caf::expected<ids> {
+        return lookup_value(op, x);
+      },
       [&](view<duration> x) -> caf::expected<ids> {
-        return bmi_.lookup(op, x.count());
+        return lookup_value(op, x.count());
       },
       [&](view<time> x) -> caf::expected<ids> {
-        return bmi_.lookup(op, x.time_since_epoch().count());
+        return lookup_value(op, x.time_since_epoch().count());
       },
-      [&](view<vector> xs) { return detail::container_lookup(*this, op, xs); },
-      [&](view<set> xs) { return detail::container_lookup(*this, op, xs); });
+      [&](view<vector> xs) { return lookup_container(op, xs); },
+      [&](view<set> xs) { return lookup_container(op, xs); });
     return caf::visit(f, d);
   };
 
+  caf::expected<value_counts>
+  distinct_impl(const ids& selection) const override {
+    value_counts result;
+    if constexpr (std::is_same_v<T, bool>) {
+      auto trues = bmi_.lookup(equal, true) & selection;
+      if (auto n = rank(trues); n > 0)
+        result.emplace(true, n);
+      if (auto n = rank(selection - trues); n > 0)
+        result.emplace(false, n);
+      return result;
+    } else if constexpr (detail::is_any_v<T, integer, count>
+                         && std::is_same_v<binner_type, identity_binner>) {
+      if (!adaptive()) {
+        auto f = [&](value_type x, const ids& xs) {
+          result.emplace(x, rank(xs));
+        };
+        detail::bisect(bmi_, selection,
+                       std::numeric_limits<value_type>::min(),
+                       std::numeric_limits<value_type>::max(), f);
+        return result;
+      }
+    }
+    // Binned values cannot be reconstructed.
+    return value_index::distinct_impl(selection);
+  }
+
   bitmap_index_type bmi_;
+
+  /// The number of values to sample in adaptive mode, or 0 otherwise.
+  size_t sample_size_ = 0;
+
+  // The adaptive mode defers its choices until the sample is complete.
+
+  bool fitted_ = false;
+  std::vector<std::pair<value_type, id>> sample_;
+  adaptive_binner binner_;
+  binned_bitmap_index_type binned_bmi_;
 };
 
 /// An index for strings.
@@ -335,6 +660,8 @@ public:
 
   explicit enumeration_index(vast::type t, caf::settings opts = {});
 
+  bool exact(relational_operator op, data_view x) const override;
+
   caf::error serialize(caf::serializer& sink) const override;
 
   caf::error deserialize(caf::deserializer& source) override;
@@ -345,17 +672,37 @@ private:
   caf::expected<ids>
   lookup_impl(relational_operator op, data_view x) const override;
 
+  caf::expected<value_counts>
+  distinct_impl(const ids& selection) const override;
+
   index index_;
 };
 
-/// An index for IP addresses.
+/// An index for IP addresses. The index splits the network bits of an
+/// address into a prefix and a suffix, both relative to the address family.
+/// The leaves of a binary prefix trie hold the positions of all addresses
+/// sharing the same prefix, and a bitslice-coded byte index per suffix byte
+/// holds the rest. Looking up a network whose length does not exceed the
+/// prefix length amounts to combining a contiguous range of trie leaves.
+/// Leaves only exist for occupied prefixes, and a short prefix bounds their
+/// number, so that scattered addresses do not yield many sparse bitmaps.
 class address_index : public value_index {
 public:
   using byte_index = bitmap_index<uint8_t, bitslice_coder<ewah_bitmap>>;
-  using type_index = bitmap_index<bool, singleton_coder<ewah_bitmap>>;
+
+  /// The leaves of the prefix trie, keyed by the prefix bits and tagged with
+  /// the address family. Inner nodes are implicit: the leaves below a node
+  /// form a contiguous key range.
+  using prefix_index = detail::flat_map<uint32_t, ewah_bitmap>;
+
+  /// The number of network bits covered by the prefix trie. The trie has at
+  /// most `2^(prefix_bits + 1)` leaves.
+  static constexpr size_t prefix_bits = 8;
 
   explicit address_index(vast::type t, caf::settings opts = {});
 
+  bool exact(relational_operator op, data_view x) const override;
+
   caf::error serialize(caf::serializer& sink) const override;
 
   caf::error deserialize(caf::deserializer& source) override;
@@ -366,8 +713,20 @@ private:
   caf::expected<ids>
   lookup_impl(relational_operator op, data_view x) const override;
 
-  std::array<byte_index, 16> bytes_;
-  type_index v4_;
+  /// Retrieves the positions of all addresses in a network.
+  /// @param x The network address.
+  /// @param k The network length, relative to the address family of *x*.
+  /// @returns The positions of all addresses whose top *k* bits equal *x*.
+  ids lookup_prefix(const address& x, size_t k) const;
+
+  /// Restores the index from the legacy format, which consisted of one
+  /// bitslice-coded index per address byte and a bitmap of IPv4 addresses.
+  /// @param source The deserializer positioned after the size of the first
+  ///        byte index.
+  caf::error deserialize_legacy(caf::deserializer& source);
+
+  prefix_index prefixes_;
+  std::array<byte_index, 16 - prefix_bits / 8> bytes_;
 };
 
 /// An index for subnets.
@@ -418,6 +777,9 @@ private:
   caf::expected<ids>
   lookup_impl(relational_operator op, data_view x) const override;
 
+  caf::expected<value_counts>
+  distinct_impl(const ids& selection) const override;
+
   number_index num_;
   protocol_index proto_;
 };
@@ -450,4 +812,33 @@ private:
   vast::type value_type_;
 };
 
+/// An index for vectors and sets that indexes all elements in a single value
+/// index, regardless of their position in the container. Unlike
+/// ::sequence_index, a membership query translates into one lookup, and the
+/// index has no limit on the number of elements per container.
+class element_set_index : public value_index {
+public:
+  /// Constructs an element set index of a given type.
+  /// @param t The sequence type.
+  /// @param opts Runtime options for element type construction.
+  explicit element_set_index(vast::type t, caf::settings opts = {});
+
+  caf::error serialize(caf::serializer& sink) const override;
+
+  caf::error deserialize(caf::deserializer& source) override;
+
+private:
+  bool append_impl(data_view x, id pos) override;
+
+  caf::expected<ids>
+  lookup_impl(relational_operator op, data_view x) const override;
+
+  /// Maps element positions to the rows that contain them.
+  ids to_rows(const ids& hits) const;
+
+  value_index_ptr elements_; ///< The index over all elements.
+  ewah_bitmap ends_;         ///< Marks the last element of each row.
+  ewah_bitmap rows_;         ///< The rows with at least one element.
+};
+
 } // namespace vast
@@ -29,6 +29,13 @@ struct factory_traits<value_index> {
   static void initialize();
 
   static key_type key(const type& x);
+
+  /// Constructs a value index from a chunk. The beginning of the chunk must
+  /// hold the type and options of the index, as written by `inspect` for a
+  /// `value_index_ptr`. This function reads them, constructs a new value
+  /// index, and then calls `value_index::load` on the remaining chunk.
+  /// @returns a value index loaded from *chunk* or `nullptr` on failure.
+  static result_type make(chunk_ptr chunk);
 };
 
 } // namespace vast
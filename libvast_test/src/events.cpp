@@ -23,6 +23,7 @@
 #include "vast/table_slice_factory.hpp"
 #include "vast/to_events.hpp"
 #include "vast/type.hpp"
+#include "vast/value_index_factory.hpp"
 
 #include "vast/concept/printable/to_string.hpp"
 #include "vast/concept/printable/vast/data.hpp"
@@ -209,6 +210,7 @@ events::events() {
     return;
   factory<table_slice>::initialize();
   factory<table_slice_builder>::initialize();
+  factory<value_index>::initialize();
   initialized = true;
   MESSAGE("inhaling unit test suite events");
   zeek_conn_log = inhale<format::zeek::reader>(